@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <sys/types.h>
 
 #if defined(__linux__) && defined(HAVE_LINUX_IF_ALG_H)
 # define USE_FILEEQ_CRYPTOAPI 1
@@ -18,6 +19,9 @@
  * compare by memcmp() */
 #define UL_FILEEQ_INTROSIZ	32
 
+/* Max size of the digest returned by ul_fileeq_get_digest() */
+#define UL_FILEEQ_DIGSIZ_MAX	32
+
 struct ul_fileeq_data {
 	unsigned char intro[UL_FILEEQ_INTROSIZ];
 	unsigned char *blocks;
@@ -41,6 +45,10 @@ struct ul_fileeq {
 	unsigned char *buf_a;
 	unsigned char *buf_b;
 	unsigned char *buf_last;
+
+	/* userspace hash (UL_FILEEQ_XXH3) */
+	void *hash_state;
+	unsigned char *buf_hash;
 };
 
 extern int ul_fileeq_init(struct ul_fileeq *eq, const char *method);
@@ -59,4 +67,12 @@ extern bool ul_fileeq_set_size(struct ul_fileeq *eq, int64_t st_size,
 extern int ul_fileeq(struct ul_fileeq *eq,
               struct ul_fileeq_data *a, struct ul_fileeq_data *b);
 
+extern size_t ul_fileeq_digest_size(struct ul_fileeq *eq);
+extern ssize_t ul_fileeq_get_intro(struct ul_fileeq *eq,
+			struct ul_fileeq_data *data, unsigned char **intro);
+extern ssize_t ul_fileeq_get_digest(struct ul_fileeq *eq,
+			struct ul_fileeq_data *data, unsigned char *digest);
+extern int ul_fileeq_confirm(struct ul_fileeq *eq,
+			struct ul_fileeq_data *a, struct ul_fileeq_data *b);
+
 #endif /* UTIL_LINUX_FILEEQ */
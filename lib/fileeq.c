@@ -24,6 +24,15 @@
  *  sent to the kernel hash functions (sha1, ...), and only hash digest is read
  *  and cached in userspace. Fast for large set of (large) files.
  *
+ *  * xxh3: data blocks are read to userspace and hashed by XXH3 (128-bit),
+ *  no syscall per digest. The digest is not collision resistant, so the
+ *  matching files are finally compared byte by byte.
+ *
+ * The digests of the blocks depend on the sizes set by ul_fileeq_set_size(),
+ * so they are usable only within one comparison set. The whole-file digest
+ * from ul_fileeq_get_digest() does not depend on the sizes and it may be
+ * stored by applications and reused later (e.g. hardlink --digest-cache).
+ *
  *
  * No copyright is claimed.  This code is in the public domain; do with
  * it what you wish.
@@ -50,6 +59,10 @@
 #include "fileeq.h"
 #include "debug.h"
 
+#define UL_XXH3
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
 static UL_DEBUG_DEFINE_MASK(ulfileeq);
 UL_DEBUG_DEFINE_MASKNAMES(ulfileeq) = UL_DEBUG_EMPTY_MASKNAMES;
 
@@ -58,6 +71,12 @@ UL_DEBUG_DEFINE_MASKNAMES(ulfileeq) = UL_DEBUG_EMPTY_MASKNAMES;
 #define ULFILEEQ_DEBUG_DATA	(1 << 3)
 #define ULFILEEQ_DEBUG_EQ	(1 << 4)
 
+/* block size used to calculate the whole-file digest */
+#define ULFILEEQ_DIGEST_BLOCKSIZ	(1024 * 1024)
+
+/* buffer size for userspace hash and for the final byte-by-byte check */
+#define ULFILEEQ_HASH_BUFSIZ		(256 * 1024)
+
 #define DBG(m, x)		__UL_DBG(ulfileeq, ULFILEEQ_DEBUG_, m, x)
 #define DBG_OBJ(m, h, x)	__UL_DBG_OBJ(ulfileeq, ULFILEEQ_DEBUG_, m, h, x)
 #define ON_DBG(m, x)		__UL_DBG_CALL(ulfileeq, ULFILEEQ_DEBUG_, m, x)
@@ -73,7 +92,8 @@ enum {
 	UL_FILEEQ_MEMCMP,
 	UL_FILEEQ_SHA1,
 	UL_FILEEQ_SHA256,
-	UL_FILEEQ_CRC32
+	UL_FILEEQ_CRC32,
+	UL_FILEEQ_XXH3
 };
 
 struct ul_fileeq_method {
@@ -81,6 +101,7 @@ struct ul_fileeq_method {
 	const char *kname;	/* name used by kernel crypto */
 	int id;
 	short digsiz;
+	bool confirm;		/* compare equal files byte by byte */
 };
 
 static const struct ul_fileeq_method ul_eq_methods[] = {
@@ -100,8 +121,12 @@ static const struct ul_fileeq_method ul_eq_methods[] = {
 	[UL_FILEEQ_CRC32] = {
 		.id = UL_FILEEQ_CRC32, .name = "crc32",
 		.digsiz = 4, .kname = "crc32c"
-	}
+	},
 #endif
+	[UL_FILEEQ_XXH3] = {
+		.id = UL_FILEEQ_XXH3, .name = "xxh3",
+		.digsiz = sizeof(XXH128_canonical_t), .confirm = 1
+	}
 };
 
 #ifdef USE_FILEEQ_CRYPTOAPI
@@ -165,7 +190,7 @@ int ul_fileeq_init(struct ul_fileeq *eq, const char *method)
 	for (i = 0; i < ARRAY_SIZE(ul_eq_methods); i++) {
 		const struct ul_fileeq_method *m = &ul_eq_methods[i];
 
-		if (strcmp(m->name, method) == 0) {
+		if (m->name && strcmp(m->name, method) == 0) {
 			eq->method = m;
 			break;
 		}
@@ -174,10 +199,15 @@ int ul_fileeq_init(struct ul_fileeq *eq, const char *method)
 	if (!eq->method)
 		return -1;
 #ifdef USE_FILEEQ_CRYPTOAPI
-	if (eq->method->id != UL_FILEEQ_MEMCMP
+	if (eq->method->kname
 	    && init_crypto_api(eq) != 0)
 		return -1;
 #endif
+	if (eq->method->id == UL_FILEEQ_XXH3) {
+		eq->hash_state = XXH3_createState();
+		if (!eq->hash_state)
+			return -1;
+	}
 	return 0;
 }
 
@@ -198,6 +228,11 @@ void ul_fileeq_deinit(struct ul_fileeq *eq)
 	deinit_crypto_api(eq);
 #endif
 	reset_fileeq_bufs(eq);
+
+	XXH3_freeState(eq->hash_state);
+	free(eq->buf_hash);
+	eq->hash_state = NULL;
+	eq->buf_hash = NULL;
 }
 
 void ul_fileeq_data_close_file(struct ul_fileeq_data *data)
@@ -411,7 +446,41 @@ static ssize_t read_block(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 	return rsz;
 }
 
-#ifdef USE_FILEEQ_CRYPTOAPI
+/*
+ * Hashes up to @max bytes from the current position of @fd by XXH3. Returns
+ * 0 or negative errno, the number of the hashed bytes is returned in @hashed.
+ */
+static int hash_data(struct ul_fileeq *eq, int fd, uint64_t max,
+		     unsigned char *digest, uint64_t *hashed)
+{
+	XXH3_state_t *st = eq->hash_state;
+	uint64_t total = 0;
+
+	if (!eq->buf_hash) {
+		eq->buf_hash = malloc(ULFILEEQ_HASH_BUFSIZ);
+		if (!eq->buf_hash)
+			return -ENOMEM;
+	}
+
+	XXH3_128bits_reset(st);
+	while (total < max) {
+		size_t want = min(max - total, (uint64_t) ULFILEEQ_HASH_BUFSIZ);
+		ssize_t rsz = ul_read_all(fd, (char *) eq->buf_hash, want);
+
+		if (rsz < 0)
+			return -errno;
+		XXH3_128bits_update(st, eq->buf_hash, rsz);
+		total += rsz;
+		if ((size_t) rsz < want)
+			break;
+	}
+
+	XXH128_canonicalFromHash((XXH128_canonical_t *) digest,
+				 XXH3_128bits_digest(st));
+	*hashed = total;
+	return 0;
+}
+
 static ssize_t get_digest(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 				uint64_t n, unsigned char **block)
 {
@@ -452,17 +521,32 @@ static ssize_t get_digest(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 			return -ENOMEM;
 	}
 
-	rsz = sendfile(eq->fd_cip, data->fd, NULL, eq->readsiz);
-	DBG_OBJ(DATA, data, ul_debug("  sent %zd [%zu wanted] to cipher", rsz, eq->readsiz));
+	/* get block digest (note 1st block is data->intro) */
+	*block = data->blocks + (n * eq->method->digsiz);
+
+	if (eq->method->id == UL_FILEEQ_XXH3) {
+		uint64_t hashed;
+		int rc = hash_data(eq, data->fd, eq->readsiz, *block, &hashed);
 
-	if (rsz < 0)
-		return rsz;
+		DBG_OBJ(DATA, data, ul_debug("  hashed %" PRIu64 " [%zu wanted]", hashed, eq->readsiz));
+		if (rc)
+			return rc;
+		off += hashed;
+		rsz = sz;
+	} else {
+#ifdef USE_FILEEQ_CRYPTOAPI
+		rsz = sendfile(eq->fd_cip, data->fd, NULL, eq->readsiz);
+		DBG_OBJ(DATA, data, ul_debug("  sent %zd [%zu wanted] to cipher", rsz, eq->readsiz));
 
-	off += rsz;
+		if (rsz < 0)
+			return rsz;
 
-	/* get block digest (note 1st block is data->intro) */
-	*block = data->blocks + (n * eq->method->digsiz);
-	rsz = ul_read_all(eq->fd_cip, (char *) *block, sz);
+		off += rsz;
+		rsz = ul_read_all(eq->fd_cip, (char *) *block, sz);
+#else
+		return -EINVAL;
+#endif
+	}
 
 	if (rsz > 0)
 		data->nblocks++;
@@ -473,7 +557,6 @@ static ssize_t get_digest(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 	DBG_OBJ(DATA, data, ul_debug("  get %zdB digest", rsz));
 	return rsz;
 }
-#endif
 
 static ssize_t get_intro(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 				unsigned char **block)
@@ -510,11 +593,177 @@ static ssize_t get_cmp_data(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 	default:
 		break;
 	}
-#ifdef USE_FILEEQ_CRYPTOAPI
 	return get_digest(eq, data, blockno, block);
-#else
-	return -1;
+}
+
+/*
+ * Returns the size of the digest returned by ul_fileeq_get_digest(), or 0 if
+ * the method does not use digests (memcmp).
+ */
+size_t ul_fileeq_digest_size(struct ul_fileeq *eq)
+{
+	return eq->method->digsiz;
+}
+
+/*
+ * Returns the intro (UL_FILEEQ_INTROSIZ bytes from the beginning of the file,
+ * padded by zeros) in @intro. The intro is cached in @data.
+ */
+ssize_t ul_fileeq_get_intro(struct ul_fileeq *eq, struct ul_fileeq_data *data,
+			    unsigned char **intro)
+{
+	return get_intro(eq, data, intro);
+}
+
+#ifdef USE_FILEEQ_CRYPTOAPI
+static int send_digests(struct ul_fileeq *eq, unsigned char *digs, size_t sz)
+{
+	size_t off = 0;
+
+	/* MSG_MORE keeps the hash open for the next chunk */
+	do {
+		size_t chunk = min(sz - off, (size_t) ULFILEEQ_DIGEST_BLOCKSIZ);
+		ssize_t rc = send(eq->fd_cip, digs + off, chunk,
+				  off + chunk < sz ? MSG_MORE : 0);
+		if (rc < 0)
+			return -errno;
+		off += rc;
+	} while (off < sz);
+
+	return 0;
+}
+
+/*
+ * The file is hashed by ULFILEEQ_DIGEST_BLOCKSIZ blocks and the result is the
+ * digest of the block digests, so the file is never copied to userspace.
+ */
+static int crypto_file_digest(struct ul_fileeq *eq, int fd, unsigned char *digest)
+{
+	unsigned char *digs = NULL;
+	size_t sz = eq->method->digsiz, n = 0, nalloc = 0;
+	int rc = -1;
+
+	do {
+		ssize_t rsz;
+
+		if (n == nalloc) {
+			unsigned char *tmp;
+
+			nalloc = nalloc ? nalloc * 2 : 64;
+			tmp = reallocarray(digs, nalloc, sz);
+			if (!tmp) {
+				rc = -ENOMEM;
+				goto done;
+			}
+			digs = tmp;
+		}
+
+		rsz = sendfile(eq->fd_cip, fd, NULL, ULFILEEQ_DIGEST_BLOCKSIZ);
+		if (rsz < 0) {
+			rc = -errno;
+			goto done;
+		}
+		if (rsz == 0)
+			break;
+		if (ul_read_all(eq->fd_cip, (char *) digs + n * sz, sz) != (ssize_t) sz)
+			goto done;
+		n++;
+	} while (1);
+
+	if (send_digests(eq, digs, n * sz) != 0
+	    || ul_read_all(eq->fd_cip, (char *) digest, sz) != (ssize_t) sz)
+		goto done;
+
+	DBG_OBJ(CRYPTO, eq, ul_debug(" %zu blocks hashed", n));
+	rc = 0;
+done:
+	free(digs);
+	return rc;
+}
+#endif
+
+/*
+ * Calculates digest of the whole file to @digest (ul_fileeq_digest_size()
+ * bytes). The file is opened and closed by this function, @data are not
+ * modified.
+ *
+ * Returns the digest size or <0 on error.
+ */
+ssize_t ul_fileeq_get_digest(struct ul_fileeq *eq, struct ul_fileeq_data *data,
+			     unsigned char *digest)
+{
+	uint64_t hashed;
+	int fd, rc = -EINVAL;
+
+	if (eq->method->id == UL_FILEEQ_MEMCMP)
+		return -EINVAL;
+
+	DBG_OBJ(DATA, data, ul_debug("whole-file digest: %s", data->name));
+
+	fd = open(data->name, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+#if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
+	ignore_result( posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL) );
 #endif
+	if (eq->method->id == UL_FILEEQ_XXH3)
+		rc = hash_data(eq, fd, UINT64_MAX, digest, &hashed);
+#ifdef USE_FILEEQ_CRYPTOAPI
+	else
+		rc = crypto_file_digest(eq, fd, digest);
+#endif
+	close(fd);
+
+	return rc ? rc : eq->method->digsiz;
+}
+
+/*
+ * Compares the files byte by byte if the method digests are not collision
+ * resistant. It's called for the files with the same digests only.
+ *
+ * Returns 1 if the files are equal (or the check is not necessary), 0 if not.
+ */
+int ul_fileeq_confirm(struct ul_fileeq *eq,
+		      struct ul_fileeq_data *a, struct ul_fileeq_data *b)
+{
+	unsigned char *buf = NULL;
+	int fa = -1, fb = -1, rc = 0;
+
+	if (!eq->method->confirm)
+		return 1;
+
+	DBG_OBJ(EQ, eq, ul_debug("confirm %s %s", a->name, b->name));
+
+	buf = malloc(2 * ULFILEEQ_HASH_BUFSIZ);
+	if (!buf)
+		goto done;
+	fa = open(a->name, O_RDONLY | O_CLOEXEC);
+	fb = open(b->name, O_RDONLY | O_CLOEXEC);
+	if (fa < 0 || fb < 0)
+		goto done;
+#if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
+	ignore_result( posix_fadvise(fa, 0, 0, POSIX_FADV_SEQUENTIAL) );
+	ignore_result( posix_fadvise(fb, 0, 0, POSIX_FADV_SEQUENTIAL) );
+#endif
+	do {
+		ssize_t ra = ul_read_all(fa, (char *) buf, ULFILEEQ_HASH_BUFSIZ);
+		ssize_t rb = ul_read_all(fb, (char *) buf + ULFILEEQ_HASH_BUFSIZ,
+					 ULFILEEQ_HASH_BUFSIZ);
+
+		if (ra < 0 || ra != rb
+		    || memcmp(buf, buf + ULFILEEQ_HASH_BUFSIZ, ra) != 0)
+			goto done;
+		if (ra == 0)
+			rc = 1;
+	} while (!rc);
+done:
+	if (fa >= 0)
+		close(fa);
+	if (fb >= 0)
+		close(fb);
+	free(buf);
+	DBG_OBJ(EQ, eq, ul_debug(" confirm: %s", rc ? "equal" : "collision"));
+	return rc;
 }
 
 #define CMP(a, b) ((a) > (b) ? 1 : ((a) < (b) ? -1 : 0))
@@ -557,6 +806,8 @@ int ul_fileeq(struct ul_fileeq *eq,
 	if (cmp == 0) {
 		if (!a->is_eof || !b->is_eof)
 			goto done; /* filesize changed? */
+		if (!ul_fileeq_confirm(eq, a, b))
+			goto done;
 
 		DBG_OBJ(EQ, eq, ul_debug("<-- MATCH"));
 		return 1;
@@ -591,7 +842,7 @@ int main(int argc, char *argv[])
 			break;
 		case 'h':
 			printf("usage: %s [options] <file> <file>\n"
-				" -m, --method <memcmp|sha1|crc32>    compare method\n",
+				" -m, --method <memcmp|sha1|crc32|xxh3>    compare method\n",
 				program_invocation_short_name);
 			return EXIT_FAILURE;
 		}
@@ -0,0 +1,594 @@
+/*
+ * bincache.c - binary index of the cache file
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The binary cache is written next to the text cache file (blkid.tab.bin) by
+ * blkid_flush_cache(). It contains the same devices as the text file, but it
+ * does not need to be parsed; it's mmap-ed and the devices are searched by
+ * NAME=value hash. The text file is still the primary cache and the binary
+ * file is ignored if it does not match the text file.
+ *
+ * The file is host specific (native byte-order and types). Layout:
+ *
+ *	header
+ *	devices		struct bincache_dev[ndevs]
+ *	tags		struct bincache_tag[ntags]
+ *	hash buckets	uint32_t[nbuckets] (tag index + 1, or 0)
+ *	strings		NUL-terminated strings, referenced by offset
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#include "fileutils.h"
+#include "all-io.h"
+#include "sysfs.h"
+#include "xxhash.h"
+
+#include "blkidP.h"
+
+#define BINCACHE_SUFFIX		".bin"
+#define BINCACHE_MAGIC		"BLKIDBC"
+#define BINCACHE_VERSION	1
+#define BINCACHE_BYTEORDER	0x01020304
+
+struct bincache_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	byteorder;
+
+	/* the text cache file the binary cache has been created for */
+	uint64_t	src_ino;
+	int64_t		src_size;
+	int64_t		src_mtime;
+	int64_t		src_mtime_nsec;
+
+	uint32_t	ndevs;
+	uint32_t	ntags;
+	uint32_t	nbuckets;	/* power of 2 */
+	uint32_t	strsz;
+
+	uint64_t	devs_off;
+	uint64_t	tags_off;
+	uint64_t	buckets_off;
+	uint64_t	strs_off;
+};
+
+struct bincache_dev {
+	uint64_t	devno;
+	int64_t		time;
+	int64_t		utime;
+	int32_t		pri;
+	uint32_t	name;		/* string offset */
+	uint32_t	tags;		/* index of the first tag */
+	uint32_t	ntags;
+};
+
+struct bincache_tag {
+	uint32_t	name;		/* string offset */
+	uint32_t	value;		/* string offset */
+	uint32_t	dev;		/* device index */
+	uint32_t	hash;
+	uint32_t	next;		/* next tag in the hash bucket + 1, or 0 */
+};
+
+struct bincache {
+	void				*map;
+	size_t				mapsz;
+
+	const struct bincache_header	*hdr;
+	const struct bincache_dev	*devs;
+	const struct bincache_tag	*tags;
+	const uint32_t			*buckets;
+	const char			*strs;
+};
+
+static uint32_t tag_hash(const char *name, const char *value)
+{
+	return XXH32(value, strlen(value), XXH32(name, strlen(name), 0));
+}
+
+static char *bincache_filename(const char *filename)
+{
+	char *res = NULL;
+
+	if (asprintf(&res, "%s" BINCACHE_SUFFIX, filename) < 0)
+		return NULL;
+	return res;
+}
+
+static int src_stat(const char *filename, struct stat *st)
+{
+	if (stat(filename, st) != 0)
+		return -errno;
+	if (!S_ISREG(st->st_mode))
+		return -EINVAL;
+	return 0;
+}
+
+static inline uint64_t align8(uint64_t x)
+{
+	return (x + 7) & ~((uint64_t) 7);
+}
+
+/*
+ * Growing string table.
+ */
+struct strtab {
+	char	*data;
+	size_t	sz;
+	size_t	alloc;
+};
+
+static int strtab_add(struct strtab *tb, const char *str, uint32_t *off)
+{
+	size_t len = strlen(str) + 1;
+
+	if (tb->sz + len > UINT32_MAX)
+		return -E2BIG;
+	if (tb->sz + len > tb->alloc) {
+		size_t sz = tb->alloc ? tb->alloc * 2 : 4096;
+		char *tmp;
+
+		while (sz < tb->sz + len)
+			sz *= 2;
+		tmp = realloc(tb->data, sz);
+		if (!tmp)
+			return -ENOMEM;
+		tb->data = tmp;
+		tb->alloc = sz;
+	}
+	memcpy(tb->data + tb->sz, str, len);
+	*off = (uint32_t) tb->sz;
+	tb->sz += len;
+	return 0;
+}
+
+/* the same devices as written to the text file by blkid_flush_cache() */
+static inline int is_saved_dev(blkid_dev dev)
+{
+	return dev->bid_name[0] == '/' && dev->bid_type
+		&& !(dev->bid_flags & BLKID_BID_FL_REMOVABLE);
+}
+
+static int bincache_write(int fd, blkid_cache cache, const struct stat *src)
+{
+	struct bincache_header hdr = { .magic = BINCACHE_MAGIC };
+	struct bincache_dev *devs = NULL;
+	struct bincache_tag *tags = NULL;
+	uint32_t *buckets = NULL, *last = NULL;
+	struct strtab strs = { .data = NULL };
+	struct list_head *p, *t;
+	size_t ndevs = 0, ntags = 0, nbuckets = 16, i;
+	int rc = 0;
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+
+		if (!is_saved_dev(dev))
+			continue;
+		ndevs++;
+		list_for_each(t, &dev->bid_tags)
+			ntags++;
+	}
+	if (ndevs > UINT32_MAX / 2 || ntags > UINT32_MAX / 2)
+		return -E2BIG;
+
+	while (nbuckets < ntags * 2)
+		nbuckets <<= 1;
+
+	devs = calloc(ndevs ? ndevs : 1, sizeof(*devs));
+	tags = calloc(ntags ? ntags : 1, sizeof(*tags));
+	buckets = calloc(nbuckets, sizeof(*buckets));
+	last = calloc(nbuckets, sizeof(*last));
+	if (!devs || !tags || !buckets || !last) {
+		rc = -ENOMEM;
+		goto done;
+	}
+
+	ndevs = ntags = 0;
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+		struct bincache_dev *bd;
+
+		if (!is_saved_dev(dev))
+			continue;
+
+		bd = &devs[ndevs];
+		bd->devno = dev->bid_devno;
+		bd->time = dev->bid_time;
+		bd->utime = dev->bid_utime;
+		bd->pri = dev->bid_pri;
+		bd->tags = ntags;
+		if ((rc = strtab_add(&strs, dev->bid_name, &bd->name)))
+			goto done;
+
+		list_for_each(t, &dev->bid_tags) {
+			blkid_tag tag = list_entry(t, struct blkid_struct_tag, bit_tags);
+			struct bincache_tag *bt = &tags[ntags];
+			size_t b;
+
+			if ((rc = strtab_add(&strs, tag->bit_name, &bt->name)) ||
+			    (rc = strtab_add(&strs, tag->bit_val, &bt->value)))
+				goto done;
+			bt->dev = ndevs;
+			bt->hash = tag_hash(tag->bit_name, tag->bit_val);
+
+			/* append to keep the bucket in the cache order */
+			b = bt->hash & (nbuckets - 1);
+			if (last[b])
+				tags[last[b] - 1].next = ntags + 1;
+			else
+				buckets[b] = ntags + 1;
+			last[b] = ntags + 1;
+
+			ntags++;
+			bd->ntags++;
+		}
+		ndevs++;
+	}
+
+	/* empty string table is invalid */
+	if (!strs.sz) {
+		uint32_t off;
+
+		if ((rc = strtab_add(&strs, "", &off)))
+			goto done;
+	}
+
+	hdr.version = BINCACHE_VERSION;
+	hdr.byteorder = BINCACHE_BYTEORDER;
+	hdr.src_ino = src->st_ino;
+	hdr.src_size = src->st_size;
+	hdr.src_mtime = src->st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	hdr.src_mtime_nsec = src->st_mtim.tv_nsec;
+#endif
+	hdr.ndevs = ndevs;
+	hdr.ntags = ntags;
+	hdr.nbuckets = nbuckets;
+	hdr.strsz = strs.sz;
+
+	hdr.devs_off = align8(sizeof(hdr));
+	hdr.tags_off = align8(hdr.devs_off + ndevs * sizeof(*devs));
+	hdr.buckets_off = align8(hdr.tags_off + ntags * sizeof(*tags));
+	hdr.strs_off = align8(hdr.buckets_off + nbuckets * sizeof(*buckets));
+
+	{
+		const struct {
+			uint64_t off;
+			const void *data;
+			size_t sz;
+		} parts[] = {
+			{ 0, &hdr, sizeof(hdr) },
+			{ hdr.devs_off, devs, ndevs * sizeof(*devs) },
+			{ hdr.tags_off, tags, ntags * sizeof(*tags) },
+			{ hdr.buckets_off, buckets, nbuckets * sizeof(*buckets) },
+			{ hdr.strs_off, strs.data, strs.sz }
+		};
+		static const char zeros[8];
+		uint64_t off = 0;
+
+		for (i = 0; i < ARRAY_SIZE(parts); i++) {
+			if (parts[i].off > off
+			    && ul_write_all(fd, zeros, parts[i].off - off) != 0) {
+				rc = -errno;
+				goto done;
+			}
+			if (ul_write_all(fd, parts[i].data, parts[i].sz) != 0) {
+				rc = -errno;
+				goto done;
+			}
+			off = parts[i].off + parts[i].sz;
+		}
+	}
+
+	DBG(SAVE, ul_debug("binary cache: %zu devices, %zu tags, %zu buckets",
+				ndevs, ntags, nbuckets));
+done:
+	free(devs);
+	free(tags);
+	free(buckets);
+	free(last);
+	free(strs.data);
+	return rc;
+}
+
+/*
+ * Writes binary version of the @cache for text cache file @filename. The
+ * function is called after the text file has been successfully written.
+ */
+int blkid_bincache_save(blkid_cache cache, const char *filename)
+{
+	char *binname = NULL, *tmp = NULL;
+	struct stat st;
+	int fd = -1, rc;
+
+	/* only regular text cache files; ignore /dev/null, etc. */
+	if ((rc = src_stat(filename, &st)) != 0)
+		return rc;
+
+	binname = bincache_filename(filename);
+	if (!binname || asprintf(&tmp, "%s-XXXXXX", binname) < 0) {
+		rc = -ENOMEM;
+		goto done;
+	}
+
+	fd = mkstemp_cloexec(tmp);
+	if (fd < 0 || fchmod(fd, 0644) != 0) {
+		rc = -errno;
+		goto done;
+	}
+
+	rc = bincache_write(fd, cache, &st);
+	if (close(fd) != 0 && !rc)
+		rc = -errno;
+	fd = -1;
+
+	if (!rc && rename(tmp, binname) != 0)
+		rc = -errno;
+	if (!rc)
+		DBG(SAVE, ul_debug("wrote binary cache %s", binname));
+done:
+	if (fd >= 0)
+		close(fd);
+	if (rc) {
+		DBG(SAVE, ul_debug("failed to write binary cache [rc=%d]", rc));
+		if (tmp)
+			unlink(tmp);
+		/* don't keep out of date file */
+		if (binname)
+			unlink(binname);
+	}
+	free(tmp);
+	free(binname);
+	return rc;
+}
+
+static int bincache_verify(struct bincache *bc, const struct stat *src)
+{
+	const struct bincache_header *hdr = bc->hdr;
+
+	if (bc->mapsz < sizeof(*hdr)
+	    || memcmp(hdr->magic, BINCACHE_MAGIC, sizeof(hdr->magic)) != 0
+	    || hdr->version != BINCACHE_VERSION
+	    || hdr->byteorder != BINCACHE_BYTEORDER)
+		return -EINVAL;
+
+	/* out of date? */
+	if (hdr->src_ino != (uint64_t) src->st_ino
+	    || hdr->src_size != (int64_t) src->st_size
+	    || hdr->src_mtime != (int64_t) src->st_mtime
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	    || hdr->src_mtime_nsec != (int64_t) src->st_mtim.tv_nsec
+#endif
+	    )
+		return -ESTALE;
+
+	if (hdr->nbuckets == 0 || (hdr->nbuckets & (hdr->nbuckets - 1))
+	    || hdr->strsz == 0
+	    || hdr->devs_off + (uint64_t) hdr->ndevs * sizeof(struct bincache_dev) > bc->mapsz
+	    || hdr->tags_off + (uint64_t) hdr->ntags * sizeof(struct bincache_tag) > bc->mapsz
+	    || hdr->buckets_off + (uint64_t) hdr->nbuckets * sizeof(uint32_t) > bc->mapsz
+	    || hdr->strs_off + (uint64_t) hdr->strsz > bc->mapsz
+	    || (hdr->devs_off | hdr->tags_off | hdr->buckets_off) % 8)
+		return -EINVAL;
+
+	bc->devs = (const struct bincache_dev *) ((const char *) bc->map + hdr->devs_off);
+	bc->tags = (const struct bincache_tag *) ((const char *) bc->map + hdr->tags_off);
+	bc->buckets = (const uint32_t *) ((const char *) bc->map + hdr->buckets_off);
+	bc->strs = (const char *) bc->map + hdr->strs_off;
+
+	/* all strings are terminated */
+	if (bc->strs[hdr->strsz - 1] != '\0')
+		return -EINVAL;
+	return 0;
+}
+
+static int bincache_open(struct bincache *bc, const char *filename)
+{
+	char *binname;
+	struct stat src, st;
+	int fd, rc;
+
+	memset(bc, 0, sizeof(*bc));
+
+	if ((rc = src_stat(filename, &src)) != 0)
+		return rc;
+
+	binname = bincache_filename(filename);
+	if (!binname)
+		return -ENOMEM;
+
+	fd = open(binname, O_RDONLY|O_CLOEXEC);
+	free(binname);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	bc->mapsz = st.st_size;
+	bc->map = mmap(NULL, bc->mapsz, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (bc->map == MAP_FAILED) {
+		bc->map = NULL;
+		return -errno;
+	}
+	bc->hdr = bc->map;
+
+	rc = bincache_verify(bc, &src);
+	if (rc) {
+		munmap(bc->map, bc->mapsz);
+		bc->map = NULL;
+	}
+	return rc;
+}
+
+static inline const char *bincache_str(struct bincache *bc, uint32_t off)
+{
+	return off < bc->hdr->strsz ? bc->strs + off : NULL;
+}
+
+/*
+ * Returns device with the highest priority and with NAME=value tag, the same
+ * device as selected by blkid_find_dev_with_tag() from the text cache.
+ */
+static const struct bincache_dev *bincache_find(struct bincache *bc,
+				const char *type, const char *value)
+{
+	const struct bincache_dev *dev = NULL;
+	uint32_t hash = tag_hash(type, value);
+	uint32_t idx, n = 0;
+	int pri = -1;
+
+	idx = bc->buckets[hash & (bc->hdr->nbuckets - 1)];
+
+	while (idx && idx <= bc->hdr->ntags && n++ < bc->hdr->ntags) {
+		const struct bincache_tag *tag = &bc->tags[idx - 1];
+		const struct bincache_dev *tmp;
+		const char *name, *val, *devname;
+
+		idx = tag->next;
+		if (tag->hash != hash || tag->dev >= bc->hdr->ndevs)
+			continue;
+
+		name = bincache_str(bc, tag->name);
+		val = bincache_str(bc, tag->value);
+		if (!name || !val || strcmp(name, type) != 0 || strcmp(val, value) != 0)
+			continue;
+
+		tmp = &bc->devs[tag->dev];
+		devname = bincache_str(bc, tmp->name);
+		if (devname && tmp->pri > pri && !access(devname, F_OK)) {
+			dev = tmp;
+			pri = tmp->pri;
+		}
+	}
+
+	return dev;
+}
+
+/*
+ * Verifies the device from the binary cache in the same way as blkid_verify()
+ * does for the text cache. Returns 0 if the device still has NAME=value.
+ */
+static int bincache_verify_dev(blkid_cache cache, struct bincache *bc,
+			const struct bincache_dev *bd,
+			const char *type, const char *value)
+{
+	struct blkid_struct_dev tmp = { .bid_name = NULL };
+	blkid_dev dev = NULL;
+	blkid_tag tag;
+	struct stat st;
+	int rc;
+
+	tmp.bid_name = (char *) bincache_str(bc, bd->name);
+	tmp.bid_time = bd->time;
+	tmp.bid_utime = bd->utime;
+
+	rc = blkid__verify_needed(&tmp, &st);
+	if (rc == 0)
+		return 0;
+	if (rc < 0 || sysfs_devno_is_dm_private(st.st_rdev, NULL, NULL))
+		return -EINVAL;
+
+	if (!cache->probe) {
+		cache->probe = blkid_new_probe();
+		if (!cache->probe)
+			return -ENOMEM;
+	}
+
+	rc = blkid__probe_dev(cache->probe, tmp.bid_name, &dev);
+	if (rc == 0) {
+		tag = blkid_find_tag_dev(dev, type);
+		rc = tag && strcmp(tag->bit_val, value) == 0 ? 0 : 1;
+	}
+	blkid_free_dev(dev);
+	return rc;
+}
+
+/*
+ * Returns device name for NAME=value from the binary cache or NULL if the
+ * binary cache is not available or the device has not been found. The
+ * caller is expected to use the text cache in this case.
+ */
+char *blkid_bincache_get_devname(blkid_cache cache, const char *type,
+				 const char *value)
+{
+	struct bincache bc;
+	const struct bincache_dev *dev;
+	char *res = NULL;
+	int rc;
+
+	if (!cache->bic_filename)
+		return NULL;
+
+	rc = bincache_open(&bc, cache->bic_filename);
+	if (rc) {
+		DBG(CACHE, ul_debug("binary cache not available [rc=%d]", rc));
+		return NULL;
+	}
+
+	dev = bincache_find(&bc, type, value);
+	if (dev && bincache_verify_dev(cache, &bc, dev, type, value) == 0)
+		res = strdup(bincache_str(&bc, dev->name));
+
+	DBG(CACHE, ul_debug("binary cache: %s=%s %s %s", type, value,
+				res ? "found" : "not found", res ? res : ""));
+
+	munmap(bc.map, bc.mapsz);
+	return res;
+}
+
+#ifdef TEST_PROGRAM
+int main(int argc, char **argv)
+{
+	blkid_cache cache = NULL;
+	char *res;
+	int rc;
+
+	blkid_init_debug(UL_DEBUG_ALL);
+	if (argc != 3 && argc != 4) {
+		fprintf(stderr, "Usage:\t%s <cachefile> --save\n"
+				"\t%s <cachefile> NAME value\n"
+				"Write binary cache or search in the binary cache\n",
+				argv[0], argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	if ((rc = blkid_get_cache(&cache, argv[1])) != 0) {
+		fprintf(stderr, "error creating cache (%d)\n", rc);
+		exit(EXIT_FAILURE);
+	}
+
+	if (argc == 3) {
+		blkid_read_cache(cache);
+		rc = blkid_bincache_save(cache, argv[1]);
+		if (rc)
+			fprintf(stderr, "failed to save binary cache (%d)\n", rc);
+	} else {
+		res = blkid_bincache_get_devname(cache, argv[2], argv[3]);
+		printf("%s\n", res ? res : "not found");
+		rc = res ? 0 : 1;
+		free(res);
+	}
+
+	blkid_put_cache(cache);
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+#endif
@@ -75,9 +75,11 @@ struct blkid_struct_tag
 {
 	struct list_head	bit_tags;	/* All tags for this device */
 	struct list_head	bit_names;	/* All tags with given NAME */
+	struct list_head	bit_hash;	/* Tags with the same NAME=value hash */
 	char			*bit_name;	/* NAME of tag (shared) */
 	char			*bit_val;	/* value of tag */
 	blkid_dev		bit_dev;	/* pointer to device */
+	unsigned long		bit_seq;	/* position in bit_names (creation order) */
 };
 typedef struct blkid_struct_tag *blkid_tag;
 
@@ -187,6 +189,7 @@ struct blkid_bufinfo {
 	unsigned char		*data;
 	uint64_t		off;
 	uint64_t		len;
+	uint64_t		used;	/* LRU clock stamp */
 	struct list_head	bufs;	/* list of buffers */
 };
 
@@ -224,6 +227,12 @@ struct blkid_struct_probe
 
 	struct list_head	buffers;	/* list of buffers */
 	struct list_head	prunable_buffers;	/* list of prunable buffers */
+	struct blkid_bufinfo	**bufidx;	/* buffers sorted by offset */
+	size_t			nbufs;		/* number of buffers in bufidx */
+	size_t			bufidx_size;	/* allocated size of bufidx */
+	uint64_t		bufs_size;	/* size of all cached buffers */
+	uint64_t		bufs_limit;	/* max bufs_size or 0 */
+	uint64_t		bufs_clock;	/* LRU clock */
 	struct list_head	hints;
 
 	struct blkid_chain	chains[BLKID_NCHAINS];	/* array of chains */
@@ -245,6 +254,8 @@ struct blkid_struct_probe
 #define BLKID_FL_MODIF_BUFF	(1 << 5)	/* cached buffers has been modified */
 #define BLKID_FL_OPAL_LOCKED	(1 << 6)	/* OPAL device is locked (I/O errors) */
 #define BLKID_FL_OPAL_CHECKED	(1 << 7)	/* OPAL lock checked */
+#define BLKID_FL_PREFETCH	(1 << 8)	/* read well-known areas by one batch */
+#define BLKID_FL_PREFETCHED	(1 << 9)	/* well-known areas already in memory */
 
 /* private per-probing flags */
 #define BLKID_PROBE_FL_IGNORE_PT (1 << 1)	/* ignore partition table */
@@ -306,10 +317,29 @@ struct blkid_struct_cache
 	unsigned int		bic_flags;	/* Status flags of the cache */
 	char			*bic_filename;	/* filename of cache */
 	blkid_probe		probe;		/* low-level probing stuff */
+
+	struct list_head	*bic_hash;	/* NAME=value index of device tags */
+	size_t			bic_hashsz;	/* number of buckets (power of 2) */
+	size_t			bic_nhashed;	/* number of tags in the index */
+	unsigned long		bic_tagseq;	/* last tag bit_seq */
+
+	struct blkid_preprobed	*bic_preprobed;	/* results from parallel probing (sorted by devno) */
+	size_t			bic_npreprobed;
+};
+
+/*
+ * Result of probing done in advance by blkid_probe_all_parallel() workers,
+ * consumed by blkid_verify().
+ */
+struct blkid_preprobed {
+	dev_t		devno;
+	int		rc;		/* blkid_do_safeprobe() result */
+	blkid_dev	dev;		/* detached device with tags (if rc == 0) */
 };
 
 #define BLKID_BIC_FL_PROBED	0x0002	/* We probed /proc/partition devices */
 #define BLKID_BIC_FL_CHANGED	0x0004	/* Cache has changed from disk */
+#define BLKID_BIC_FL_UNREAD	0x0008	/* Cache file has not been read yet */
 
 /* config file */
 #define BLKID_CONFIG_FILE	"/etc/blkid.conf"
@@ -380,6 +410,14 @@ extern void blkid_read_cache(blkid_cache cache)
 extern int blkid_flush_cache(blkid_cache cache)
 			__attribute__((nonnull));
 
+/* bincache.c */
+extern int blkid_bincache_save(blkid_cache cache, const char *filename)
+			__attribute__((nonnull));
+extern char *blkid_bincache_get_devname(blkid_cache cache, const char *type,
+				 const char *value)
+			__attribute__((nonnull))
+			__attribute__((warn_unused_result));
+
 /* cache */
 extern char *blkid_safe_getenv(const char *arg)
 			__attribute__((nonnull))
@@ -387,6 +425,15 @@ extern char *blkid_safe_getenv(const char *arg)
 
 extern char *blkid_get_cache_filename(struct blkid_config *conf)
 			__attribute__((warn_unused_result));
+extern int blkid__new_cache(blkid_cache *ret_cache, const char *filename);
+/*
+ * Functions to (re)probe cached devices: verify.c
+ */
+extern int blkid__probe_dev(blkid_probe pr, const char *devname, blkid_dev *res)
+			__attribute__((nonnull));
+extern int blkid__verify_needed(blkid_dev dev, struct stat *st)
+			__attribute__((nonnull(1)));
+
 /*
  * Functions to create and find a specific tag type: tag.c
  */
@@ -443,8 +490,25 @@ extern int blkid_probe_get_idmag(blkid_probe pr, const struct blkid_idinfo *id,
 			uint64_t *offset, const struct blkid_idmag **res)
 			__attribute__((nonnull(1)));
 
+extern int blkid_probe_get_idmag_location(blkid_probe pr, const struct blkid_idmag *mag,
+			uint64_t *offset)
+			__attribute__((nonnull));
+
 extern void blkid_probe_prune_buffers(blkid_probe pr);
 
+extern struct blkid_bufinfo *blkid_probe_alloc_buffer(uint64_t real_off, uint64_t len)
+			__attribute__((warn_unused_result));
+extern void blkid_probe_free_buffer(struct blkid_bufinfo *bf)
+			__attribute__((nonnull));
+extern int blkid_probe_has_buffer(blkid_probe pr, uint64_t off, uint64_t len)
+			__attribute__((nonnull));
+extern void blkid_probe_add_buffer(blkid_probe pr, struct blkid_bufinfo *bf)
+			__attribute__((nonnull));
+
+/* prefetch.c */
+extern void blkid_probe_prefetch(blkid_probe pr)
+			__attribute__((nonnull));
+
 /* returns superblock according to 'struct blkid_idmag' */
 extern const unsigned char *blkid_probe_get_sb_buffer(blkid_probe pr, const struct blkid_idmag *mag, size_t size);
 #define blkid_probe_get_sb(_pr, _mag, type) \
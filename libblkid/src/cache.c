@@ -48,6 +48,11 @@
  * they are accessed the first time, so it is critical that there is some way to
  * locate these devices without enumerating only visible devices, so the use of
  * the cache file is required in this situation.
+ *
+ * Since version 2.43 the library also writes a binary index of the cache file
+ * (blkid.tab.bin) and uses it to resolve NAME=value tags by blkid_get_devname()
+ * without parsing the whole cache file. The binary file is ignored if it does
+ * not match the text cache file.
  */
 static const char *get_default_cache_filename(void)
 {
@@ -82,16 +87,12 @@ char *blkid_get_cache_filename(struct blkid_config *conf)
 	return filename;
 }
 
-/**
- * blkid_get_cache:
- * @cache: pointer to return cache handler
- * @filename: path to the cache file or NULL for the default path
- *
- * Allocates and initializes library cache handler.
- *
- * Returns: 0 on success or number less than zero in case of error.
+/*
+ * Allocates and initializes library cache handler, but the cache file is not
+ * read. The file is read on demand by blkid_find_dev_with_tag(); this is used
+ * when the result may be found in the binary cache.
  */
-int blkid_get_cache(blkid_cache *ret_cache, const char *filename)
+int blkid__new_cache(blkid_cache *ret_cache, const char *filename)
 {
 	blkid_cache cache;
 
@@ -112,11 +113,29 @@ int blkid_get_cache(blkid_cache *ret_cache, const char *filename)
 	else
 		cache->bic_filename = blkid_get_cache_filename(NULL);
 
-	blkid_read_cache(cache);
+	cache->bic_flags |= BLKID_BIC_FL_UNREAD;
 	*ret_cache = cache;
 	return 0;
 }
 
+/**
+ * blkid_get_cache:
+ * @cache: pointer to return cache handler
+ * @filename: path to the cache file or NULL for the default path
+ *
+ * Allocates and initializes library cache handler.
+ *
+ * Returns: 0 on success or number less than zero in case of error.
+ */
+int blkid_get_cache(blkid_cache *ret_cache, const char *filename)
+{
+	int rc = blkid__new_cache(ret_cache, filename);
+
+	if (rc == 0)
+		blkid_read_cache(*ret_cache);
+	return rc;
+}
+
 /**
  * blkid_put_cache:
  * @cache: cache handler
@@ -161,6 +180,7 @@ void blkid_put_cache(blkid_cache cache)
 
 	blkid_free_probe(cache->probe);
 
+	free(cache->bic_hash);
 	free(cache->bic_filename);
 	free(cache);
 }
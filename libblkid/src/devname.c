@@ -33,6 +33,9 @@
 #include <errno.h>
 #endif
 #include <time.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "blkidP.h"
 
@@ -403,12 +406,122 @@ ubi_probe_all(blkid_cache cache, int only_if_new)
 	}
 }
 
+/*
+ * Devices collected for blkid_probe_all_parallel(). The devices are grouped by
+ * whole-disks; one disk (and all its partitions) is always probed by the same
+ * worker to keep the I/O on the disk sequential.
+ */
+struct preprobe_item {
+	char		*devname;
+	dev_t		devno;
+	int		rc;
+	blkid_dev	dev;		/* probing result */
+	unsigned int	done : 1;	/* probed by worker */
+};
+
+struct preprobe_list {
+	struct preprobe_item	*items;
+	size_t			nitems;
+
+	size_t			*disks;		/* index of the first item for each disk */
+	size_t			ndisks;
+
+	size_t			next;		/* next disk to probe */
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t		lock;
+#endif
+};
+
+static void preprobe_add_item(blkid_cache cache, struct preprobe_list *pl,
+			      const char *ptname, dev_t devno, int only_if_new)
+{
+	struct list_head *p;
+	struct preprobe_item *item;
+	struct stat st;
+	char *devname, *x;
+
+	/* skip devices blkid_verify() is not going to probe */
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev tmp = list_entry(p, struct blkid_struct_dev, bid_devs);
+
+		if (tmp->bid_devno != devno)
+			continue;
+		if (only_if_new && !access(tmp->bid_name, F_OK))
+			return;
+		if (!blkid__verify_needed(tmp, NULL))
+			return;
+	}
+
+	if (sysfs_devno_is_dm_private(devno, NULL, NULL))
+		return;
+
+	/* sysfs uses '!' for '/' in names (e.g. cciss!c0d0) */
+	if (asprintf(&devname, "/dev/%s", ptname) < 0)
+		return;
+	for (x = devname; *x; x++) {
+		if (*x == '!')
+			*x = '/';
+	}
+
+	/* devices with unusual names are probed later in the usual way */
+	if (stat(devname, &st) != 0 || !S_ISBLK(st.st_mode) || st.st_rdev != devno)
+		goto fail;
+
+	if (pl->nitems % 32 == 0) {
+		item = realloc(pl->items, (pl->nitems + 32) * sizeof(*item));
+		if (!item)
+			goto fail;
+		pl->items = item;
+	}
+
+	item = &pl->items[pl->nitems++];
+	memset(item, 0, sizeof(*item));
+	item->devname = devname;
+	item->devno = devno;
+
+	DBG(DEVNAME, ul_debug(" collect %s, devno 0x%04X", devname, (unsigned int) devno));
+	return;
+fail:
+	free(devname);
+}
+
+static void preprobe_add_disk(struct preprobe_list *pl, size_t first)
+{
+	size_t *disks;
+
+	if (first == pl->nitems)
+		return;		/* nothing collected */
+
+	disks = realloc(pl->disks, (pl->ndisks + 2) * sizeof(*disks));
+	if (!disks)
+		return;
+	pl->disks = disks;
+	pl->disks[pl->ndisks++] = first;
+	pl->disks[pl->ndisks] = pl->nitems;
+}
+
+/*
+ * Probes the device or collects it for parallel probing if @pl specified.
+ */
+static void sysfs_probe_one(blkid_cache cache, struct preprobe_list *pl,
+			    const char *ptname, dev_t devno, int only_if_new)
+{
+	if (pl)
+		preprobe_add_item(cache, pl, ptname, devno, only_if_new);
+	else
+		probe_one(cache, ptname, devno, 0, only_if_new, 0);
+}
+
 /*
  * This function uses /sys to read all block devices in way compatible with
  * /proc/partitions (like the original libblkid implementation)
+ *
+ * If @pl is specified then the devices are only collected to the list rather
+ * than probed and the cache is not modified.
  */
 static int
-sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
+sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable,
+		struct preprobe_list *pl)
 {
 	DIR *sysfs;
 	struct dirent *dev;
@@ -428,6 +541,7 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 		struct dirent *part;
 		struct path_cxt *pc = NULL;
 		uint64_t size = 0;
+		size_t first = pl ? pl->nitems : 0;
 
 		DBG(DEVNAME, ul_debug("checking %s", dev->d_name));
 
@@ -486,15 +600,15 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 			DBG(DEVNAME, ul_debug(" Probe partition dev %s, devno 0x%04X",
                                    part->d_name, (unsigned int) partno));
 			nparts++;
-			probe_one(cache, part->d_name, partno, 0, only_if_new, 0);
+			sysfs_probe_one(cache, pl, part->d_name, partno, only_if_new);
 		}
 
 		if (!nparts) {
 			/* add non-partitioned whole disk to cache */
 			DBG(DEVNAME, ul_debug(" Probe whole dev %s, devno 0x%04X",
 				   dev->d_name, (unsigned int) devno));
-			probe_one(cache, dev->d_name, devno, 0, only_if_new, 0);
-		} else {
+			sysfs_probe_one(cache, pl, dev->d_name, devno, only_if_new);
+		} else if (!pl) {
 			/* remove partitioned whole-disk from cache */
 			struct list_head *p, *pnext;
 
@@ -510,6 +624,8 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 			}
 		}
 	next:
+		if (pl)
+			preprobe_add_disk(pl, first);
 		if (dir)
 			closedir(dir);
 		if (pc)
@@ -542,7 +658,7 @@ static int probe_all(blkid_cache cache, int only_if_new, int update_interval)
 #endif
 	ubi_probe_all(cache, only_if_new);
 
-	rc = sysfs_probe_all(cache, only_if_new, 0);
+	rc = sysfs_probe_all(cache, only_if_new, 0, NULL);
 
 	/* Don't mark the change as "probed" if /sys not available */
 	if (update_interval && rc == 0) {
@@ -572,6 +688,178 @@ int blkid_probe_all(blkid_cache cache)
 	return ret;
 }
 
+static void *preprobe_worker(void *data)
+{
+	struct preprobe_list *pl = (struct preprobe_list *) data;
+	blkid_probe pr;
+
+	pr = blkid_new_probe();
+	if (!pr)
+		return NULL;
+
+	do {
+		size_t i, disk;
+
+#ifdef HAVE_LIBPTHREAD
+		pthread_mutex_lock(&pl->lock);
+#endif
+		disk = pl->next++;
+#ifdef HAVE_LIBPTHREAD
+		pthread_mutex_unlock(&pl->lock);
+#endif
+		if (disk >= pl->ndisks)
+			break;
+
+		for (i = pl->disks[disk]; i < pl->disks[disk + 1]; i++) {
+			struct preprobe_item *item = &pl->items[i];
+
+			item->rc = blkid__probe_dev(pr, item->devname, &item->dev);
+			item->done = 1;
+		}
+	} while (1);
+
+	blkid_free_probe(pr);
+	return NULL;
+}
+
+static void preprobe_run(struct preprobe_list *pl, int nworkers)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_t *threads;
+	int i, n = 0;
+
+	pthread_mutex_init(&pl->lock, NULL);
+
+	if (nworkers <= 0) {
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nworkers = ncpus > 0 ? (int) ncpus : 1;
+	}
+	if ((size_t) nworkers > pl->ndisks)
+		nworkers = (int) pl->ndisks;
+
+	DBG(DEVNAME, ul_debug("parallel probing: %zu devices, %zu disks, %d workers",
+				pl->nitems, pl->ndisks, nworkers));
+
+	threads = nworkers > 1 ? calloc(nworkers, sizeof(pthread_t)) : NULL;
+	for (i = 0; threads && i < nworkers; i++) {
+		if (pthread_create(&threads[n], NULL, preprobe_worker, pl) == 0)
+			n++;
+	}
+	/* the current thread is worker too (and the only one on errors) */
+	preprobe_worker(pl);
+
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	pthread_mutex_destroy(&pl->lock);
+#else
+	(void) nworkers;
+	preprobe_worker(pl);
+#endif
+}
+
+static int cmp_preprobed(const void *a, const void *b)
+{
+	const struct blkid_preprobed *x = a, *y = b;
+
+	return x->devno < y->devno ? -1 : x->devno > y->devno ? 1 : 0;
+}
+
+/* move probing results to the cache, blkid_verify() will use them */
+static void preprobe_to_cache(blkid_cache cache, struct preprobe_list *pl)
+{
+	size_t i, n = 0;
+
+	cache->bic_preprobed = calloc(pl->nitems ? pl->nitems : 1,
+				      sizeof(struct blkid_preprobed));
+	if (!cache->bic_preprobed)
+		return;
+
+	for (i = 0; i < pl->nitems; i++) {
+		struct preprobe_item *item = &pl->items[i];
+
+		/* errors are handled later by usual probing */
+		if (!item->done || item->rc < 0)
+			continue;
+
+		cache->bic_preprobed[n].devno = item->devno;
+		cache->bic_preprobed[n].rc = item->rc;
+		cache->bic_preprobed[n].dev = item->dev;
+		item->dev = NULL;
+		n++;
+	}
+
+	qsort(cache->bic_preprobed, n, sizeof(struct blkid_preprobed), cmp_preprobed);
+	cache->bic_npreprobed = n;
+}
+
+static void free_preprobed(blkid_cache cache, struct preprobe_list *pl)
+{
+	size_t i;
+
+	for (i = 0; i < cache->bic_npreprobed; i++)
+		blkid_free_dev(cache->bic_preprobed[i].dev);
+	free(cache->bic_preprobed);
+	cache->bic_preprobed = NULL;
+	cache->bic_npreprobed = 0;
+
+	for (i = 0; i < pl->nitems; i++) {
+		blkid_free_dev(pl->items[i].dev);
+		free(pl->items[i].devname);
+	}
+	free(pl->items);
+	free(pl->disks);
+}
+
+/**
+ * blkid_probe_all_parallel:
+ * @cache: cache handler
+ * @nworkers: max number of threads or <= 0 for number of online CPUs
+ *
+ * The same as blkid_probe_all(), but the devices are probed by @nworkers
+ * threads. Partitions on the same whole-disk are probed by the same thread,
+ * so the speedup depends on number of disks and on their latency (it's
+ * significant for example for many network or slow USB devices).
+ *
+ * The cache is updated in the same order as by blkid_probe_all(). If the
+ * library is compiled without threads support then the function is the same
+ * as blkid_probe_all().
+ *
+ * Returns: 0 on success, or number less than zero in case of error.
+ *
+ * Since: 2.44
+ */
+int blkid_probe_all_parallel(blkid_cache cache, int nworkers)
+{
+	struct preprobe_list pl = { .items = NULL };
+	int ret;
+
+	if (!cache)
+		return -BLKID_ERR_PARAM;
+
+	DBG(PROBE, ul_debug("Begin blkid_probe_all_parallel()"));
+
+	/* don't waste time if probe_all() is going to do nothing */
+	if (!(cache->bic_flags & BLKID_BIC_FL_PROBED) ||
+	    time(NULL) - cache->bic_time >= BLKID_PROBE_INTERVAL) {
+
+		/* initialize debug stuff before we start threads */
+		blkid_init_debug(0);
+		blkid_read_cache(cache);
+
+		if (sysfs_probe_all(cache, 0, 0, &pl) == 0 && pl.ndisks) {
+			preprobe_run(&pl, nworkers);
+			preprobe_to_cache(cache, &pl);
+		}
+	}
+
+	ret = probe_all(cache, 0, 1);
+	free_preprobed(cache, &pl);
+
+	DBG(PROBE, ul_debug("End blkid_probe_all_parallel() [rc=%d]", ret));
+	return ret;
+}
+
 /**
  * blkid_probe_all_new:
  * @cache: cache handler
@@ -613,7 +901,7 @@ int blkid_probe_all_removable(blkid_cache cache)
 	int ret;
 
 	DBG(PROBE, ul_debug("Begin blkid_probe_all_removable()"));
-	ret = sysfs_probe_all(cache, 0, 1);
+	ret = sysfs_probe_all(cache, 0, 1, NULL);
 	DBG(PROBE, ul_debug("End blkid_probe_all_removable() [rc=%d]", ret));
 	return ret;
 }
@@ -194,8 +194,10 @@ static char *evaluate_by_scan(const char *token, const char *value,
 	DBG(EVALUATE, ul_debug("evaluating by blkid scan %s=%s", token, value));
 
 	if (!c) {
+		/* the cache file is not read if the result is in the binary
+		 * cache, see blkid_get_devname() */
 		char *cachefile = blkid_get_cache_filename(conf);
-		int rc = blkid_get_cache(&c, cachefile);
+		int rc = blkid__new_cache(&c, cachefile);
 		free(cachefile);
 		if (rc < 0)
 			return NULL;
@@ -205,6 +207,13 @@ static char *evaluate_by_scan(const char *token, const char *value,
 
 	res = blkid_get_devname(c, token, value);
 
+	if (cache && (c->bic_flags & BLKID_BIC_FL_UNREAD)) {
+		/* don't return unread cache, the caller may use it for
+		 * anything else */
+		blkid_put_cache(c);
+		c = NULL;
+	}
+
 	if (cache)
 		*cache = c;
 	else
@@ -0,0 +1,406 @@
+/*
+ * prefetch.c - read well-known on-disk areas by one batch
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The probing functions read the device by many small synchronous requests
+ * (magic strings at the begin and at the end of the device, RAID and volume
+ * manager metadata, ...). The prefetch collects locations of all magic
+ * strings of the enabled chains and submits all the reads at once, so the
+ * device latency is paid only once. The result is stored in the probe buffers
+ * and the probing functions later use the buffers as usually.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+
+#include "blkidP.h"
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(SYS_io_uring_setup) \
+    && defined(SYS_io_uring_enter)
+# define USE_PREFETCH_IO_URING 1
+#endif
+
+#define PREFETCH_ALIGN		4096	/* minimal size of the prefetched area */
+#define PREFETCH_MAX		128	/* max number of the areas */
+
+struct prefetch_area {
+	uint64_t		off;	/* offset within probing area */
+	uint64_t		len;
+	struct blkid_bufinfo	*bf;
+	int			done;	/* successfully read */
+};
+
+struct prefetch_list {
+	struct prefetch_area	*areas;
+	size_t			nareas;
+};
+
+/**
+ * blkid_probe_enable_prefetch:
+ * @pr: probe
+ * @enable: TRUE/FALSE
+ *
+ * Enables prefetching of well-known on-disk areas. If enabled, the probing
+ * functions (blkid_do_probe(), blkid_do_safeprobe(), ...) collect locations
+ * of the magic strings of all enabled chains and read all the areas by one
+ * batch (by io_uring if available) before the probing starts. This is usable
+ * for devices with high I/O latency (SAN, NVMe-oF, ...).
+ *
+ * The prefetch is not used if custom I/O operations are defined by
+ * blkid_probe_set_vfs() or if the device is locked by OPAL.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: 2.44
+ */
+int blkid_probe_enable_prefetch(blkid_probe pr, int enable)
+{
+	if (enable)
+		pr->flags |= BLKID_FL_PREFETCH;
+	else
+		pr->flags &= ~BLKID_FL_PREFETCH;
+	return 0;
+}
+
+static int cmp_prefetch_areas(const void *a, const void *b)
+{
+	const struct prefetch_area *aa = a, *ab = b;
+
+	if (aa->off != ab->off)
+		return aa->off < ab->off ? -1 : 1;
+	return 0;
+}
+
+static int add_area(blkid_probe pr, struct prefetch_list *ls,
+		    uint64_t off, uint64_t len)
+{
+	struct prefetch_area *ar;
+	uint64_t end;
+
+	if (len == 0 || off >= pr->size || pr->size - off < len)
+		return 0;	/* out of the probing area */
+
+	end = off + len;
+	off -= off % PREFETCH_ALIGN;
+	if (end % PREFETCH_ALIGN)
+		end += PREFETCH_ALIGN - (end % PREFETCH_ALIGN);
+	if (end > pr->size)
+		end = pr->size;
+
+	if (blkid_probe_has_buffer(pr, off, end - off))
+		return 0;
+
+	if (!(ls->nareas % 16)) {
+		ar = reallocarray(ls->areas, ls->nareas + 16, sizeof(*ar));
+		if (!ar)
+			return -ENOMEM;
+		ls->areas = ar;
+	}
+
+	ar = &ls->areas[ls->nareas++];
+	memset(ar, 0, sizeof(*ar));
+	ar->off = off;
+	ar->len = end - off;
+	return 0;
+}
+
+/* collects locations of the magic strings of all enabled chains */
+static int collect_areas(blkid_probe pr, struct prefetch_list *ls)
+{
+	size_t i, n;
+
+	for (i = 0; i < BLKID_NCHAINS; i++) {
+		struct blkid_chain *chn = &pr->chains[i];
+		const struct blkid_chaindrv *drv = chn->driver;
+
+		if (!chn->enabled)
+			continue;
+
+		for (n = 0; n < drv->nidinfos; n++) {
+			const struct blkid_idinfo *id = drv->idinfos[n];
+			const struct blkid_idmag *mag;
+
+			if (chn->fltr && blkid_bmp_get_item(chn->fltr, n))
+				continue;
+			if (id->minsz && (unsigned) id->minsz > pr->size)
+				continue;
+
+			for (mag = &id->magics[0]; mag->magic; mag++) {
+				uint64_t off;
+				int rc;
+
+				if (blkid_probe_get_idmag_location(pr, mag, &off) != 0)
+					continue;
+				rc = add_area(pr, ls, off, mag->len);
+				if (rc)
+					return rc;
+			}
+		}
+	}
+
+	if (!ls->nareas)
+		return 0;
+
+	/* merge overlapping and adjacent areas */
+	qsort(ls->areas, ls->nareas, sizeof(struct prefetch_area), cmp_prefetch_areas);
+
+	for (i = 0, n = 1; n < ls->nareas; n++) {
+		struct prefetch_area *cur = &ls->areas[i];
+		struct prefetch_area *ar = &ls->areas[n];
+
+		if (ar->off <= cur->off + cur->len) {
+			if (ar->off + ar->len > cur->off + cur->len)
+				cur->len = ar->off + ar->len - cur->off;
+		} else
+			ls->areas[++i] = *ar;
+	}
+	ls->nareas = i + 1;
+
+	if (ls->nareas > PREFETCH_MAX)
+		ls->nareas = PREFETCH_MAX;	/* the rest is read on demand */
+	return 0;
+}
+
+#ifdef USE_PREFETCH_IO_URING
+/*
+ * Returns <0 if io_uring is unusable, the buffers are untouched in this case.
+ */
+static int prefetch_io_uring(blkid_probe pr, struct prefetch_list *ls)
+{
+	struct io_uring_params params;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	struct iovec *iov = NULL;
+	unsigned *sq_tail, *sq_mask, *sq_array, *cq_head, *cq_tail, *cq_mask;
+	unsigned tail, head;
+	size_t sq_sz, cq_sz, sqes_sz, i, ncomp = 0, nsubmitted = 0;
+	void *sq_ptr = MAP_FAILED, *cq_ptr = MAP_FAILED, *sqes_ptr = MAP_FAILED;
+	int fd, rc = -ENOMEM;
+
+	memset(&params, 0, sizeof(params));
+	fd = syscall(SYS_io_uring_setup, ls->nareas, &params);
+	if (fd < 0) {
+		rc = -errno;
+		DBG(LOWPROBE, ul_debug("prefetch: io_uring_setup failed: %m"));
+		return rc;
+	}
+
+	sq_sz = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cq_sz = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	sqes_sz = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (cq_sz > sq_sz)
+			sq_sz = cq_sz;
+		cq_sz = sq_sz;
+	}
+
+	sq_ptr = mmap(NULL, sq_sz, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq_ptr == MAP_FAILED)
+		goto done;
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		cq_ptr = sq_ptr;
+	else {
+		cq_ptr = mmap(NULL, cq_sz, PROT_READ | PROT_WRITE,
+			      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq_ptr == MAP_FAILED)
+			goto done;
+	}
+
+	sqes_ptr = mmap(NULL, sqes_sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqes_ptr == MAP_FAILED)
+		goto done;
+
+	iov = calloc(ls->nareas, sizeof(struct iovec));
+	if (!iov)
+		goto done;
+
+	sq_tail  = (unsigned *) ((char *) sq_ptr + params.sq_off.tail);
+	sq_mask  = (unsigned *) ((char *) sq_ptr + params.sq_off.ring_mask);
+	sq_array = (unsigned *) ((char *) sq_ptr + params.sq_off.array);
+	cq_head  = (unsigned *) ((char *) cq_ptr + params.cq_off.head);
+	cq_tail  = (unsigned *) ((char *) cq_ptr + params.cq_off.tail);
+	cq_mask  = (unsigned *) ((char *) cq_ptr + params.cq_off.ring_mask);
+	cqes     = (struct io_uring_cqe *) ((char *) cq_ptr + params.cq_off.cqes);
+	sqes     = sqes_ptr;
+
+	/* all requests by one batch */
+	tail = *sq_tail;
+	for (i = 0; i < ls->nareas; i++) {
+		struct prefetch_area *ar = &ls->areas[i];
+		unsigned idx = tail & *sq_mask;
+		struct io_uring_sqe *sqe = &sqes[idx];
+
+		iov[i].iov_base = ar->bf->data;
+		iov[i].iov_len = ar->len;
+
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READV;
+		sqe->fd = pr->fd;
+		sqe->addr = (uintptr_t) &iov[i];
+		sqe->len = 1;
+		sqe->off = pr->off + ar->off;
+		sqe->user_data = i;
+
+		sq_array[idx] = idx;
+		tail++;
+	}
+	__atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+	/* the requests are in the ring, don't fallback to pread() */
+	rc = 0;
+
+	while (ncomp < ls->nareas) {
+		/* the kernel does not wait for completions after a partial
+		 * submit, it returns the number of submitted requests */
+		int ret = syscall(SYS_io_uring_enter, fd,
+				  ls->nareas - nsubmitted,
+				  ls->nareas - ncomp,
+				  IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EBUSY) {
+				DBG(LOWPROBE, ul_debug("prefetch: io_uring_enter failed: %m"));
+				/* unfinished reads are never used */
+				for (i = 0; i < ls->nareas; i++)
+					ls->areas[i].done = 0;
+				goto done;
+			}
+			ret = 0;	/* try again after reaping completions */
+		}
+		nsubmitted += ret;
+
+		head = *cq_head;
+		while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+			const struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+
+			if (cqe->user_data < ls->nareas) {
+				struct prefetch_area *ar = &ls->areas[cqe->user_data];
+
+				ar->done = cqe->res >= 0
+					   && (uint64_t) cqe->res == ar->len;
+			}
+			head++;
+			ncomp++;
+		}
+		__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+		if (ret == 0 && ncomp == nsubmitted && nsubmitted < ls->nareas) {
+			/* nothing in flight and nothing submitted, the rest of
+			 * the areas is read on demand */
+			DBG(LOWPROBE, ul_debug("prefetch: %zu areas not submitted",
+						ls->nareas - nsubmitted));
+			break;
+		}
+	}
+done:
+	free(iov);
+	if (sqes_ptr != MAP_FAILED)
+		munmap(sqes_ptr, sqes_sz);
+	if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+		munmap(cq_ptr, cq_sz);
+	if (sq_ptr != MAP_FAILED)
+		munmap(sq_ptr, sq_sz);
+	close(fd);
+	return rc;
+}
+#endif /* USE_PREFETCH_IO_URING */
+
+/*
+ * Fallback, let kernel to start all the reads asynchronously and
+ * then read the data from the page cache.
+ */
+static int prefetch_pread(blkid_probe pr, struct prefetch_list *ls)
+{
+	size_t i;
+
+#ifdef HAVE_POSIX_FADVISE
+	for (i = 0; i < ls->nareas; i++)
+		ignore_result( posix_fadvise(pr->fd, pr->off + ls->areas[i].off,
+				ls->areas[i].len, POSIX_FADV_WILLNEED) );
+#endif
+	for (i = 0; i < ls->nareas; i++) {
+		struct prefetch_area *ar = &ls->areas[i];
+		ssize_t ret;
+
+		if (ar->done)
+			continue;
+		ret = pread(pr->fd, ar->bf->data, ar->len, pr->off + ar->off);
+		ar->done = ret >= 0 && (uint64_t) ret == ar->len;
+	}
+	return 0;
+}
+
+void blkid_probe_prefetch(blkid_probe pr)
+{
+	struct prefetch_list ls = { .nareas = 0 };
+	size_t i, ndone = 0;
+	int rc = -1;
+
+	pr->flags |= BLKID_FL_PREFETCHED;
+
+	if (pr->vfs || pr->parent || pr->fd < 0 || pr->size == 0
+	    || !(S_ISBLK(pr->mode) || S_ISREG(pr->mode))
+	    || blkdid_probe_is_opal_locked(pr))
+		return;
+
+	if (collect_areas(pr, &ls) != 0 || !ls.nareas)
+		goto done;
+
+	for (i = 0; i < ls.nareas; i++) {
+		struct prefetch_area *ar = &ls.areas[i];
+
+		ar->bf = blkid_probe_alloc_buffer(pr->off + ar->off, ar->len);
+		if (!ar->bf)
+			goto done;
+	}
+
+	DBG(LOWPROBE, ul_debug("prefetch: reading %zu areas", ls.nareas));
+
+#ifdef USE_PREFETCH_IO_URING
+	rc = prefetch_io_uring(pr, &ls);
+#endif
+	if (rc != 0)
+		prefetch_pread(pr, &ls);
+
+	/* failed reads are ignored, the probing functions will try again */
+	for (i = 0; i < ls.nareas; i++) {
+		struct prefetch_area *ar = &ls.areas[i];
+
+		if (!ar->done)
+			continue;
+
+		DBG(LOWPROBE, ul_debug("\tprefetched: off=%"PRIu64" len=%"PRIu64,
+					ar->bf->off, ar->bf->len));
+		blkid_probe_add_buffer(pr, ar->bf);
+		ar->bf = NULL;
+		ndone++;
+	}
+	DBG(LOWPROBE, ul_debug("prefetch: %zu/%zu areas done", ndone, ls.nareas));
+done:
+	for (i = 0; i < ls.nareas; i++) {
+		if (ls.areas[i].bf)
+			blkid_probe_free_buffer(ls.areas[i].bf);
+	}
+	free(ls.areas);
+	errno = 0;
+}
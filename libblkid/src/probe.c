@@ -314,6 +314,7 @@ void blkid_free_probe(blkid_probe pr)
 	blkid_free_probe(pr->disk_probe);
 
 	DBG(LOWPROBE, ul_debug("free probe"));
+	free(pr->bufidx);
 	free(pr->vfs);
 	free(pr);
 }
@@ -604,15 +605,12 @@ static void remove_buffer(struct blkid_bufinfo *bf)
 	free(bf);
 }
 
-static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint64_t len)
+/*
+ * Allocates a new buffer (not added to the list of buffers).
+ */
+struct blkid_bufinfo *blkid_probe_alloc_buffer(uint64_t real_off, uint64_t len)
 {
-	ssize_t ret;
-	struct blkid_bufinfo *bf = NULL;
-
-	if (ul_vfs_lseek(pr->vfs, pr->fd, real_off, SEEK_SET) == (off_t) -1) {
-		errno = 0;
-		return NULL;
-	}
+	struct blkid_bufinfo *bf;
 
 	/* someone trying to overflow some buffers? */
 	if (len > ULONG_MAX - sizeof(struct blkid_bufinfo)) {
@@ -639,26 +637,179 @@ static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint
 	bf->off = real_off;
 	INIT_LIST_HEAD(&bf->bufs);
 
+	return bf;
+}
+
+void blkid_probe_free_buffer(struct blkid_bufinfo *bf)
+{
+	remove_buffer(bf);
+}
+
+/*
+ * Reads @len bytes from the device to @buf. Returns 0 on success or -1 on
+ * error, errno is zero if the error is not fatal for probing.
+ */
+static int read_device(blkid_probe pr, unsigned char *buf, uint64_t real_off, uint64_t len)
+{
+	ssize_t ret;
+
+	if (ul_vfs_lseek(pr->vfs, pr->fd, real_off, SEEK_SET) == (off_t) -1) {
+		errno = 0;
+		return -1;
+	}
+
 	DBG(LOWPROBE, ul_debug("\tread: off=%"PRIu64" len=%"PRIu64"",
 	                       real_off, len));
 
-	ret = ul_vfs_read(pr->vfs, pr->fd, bf->data, len);
+	ret = ul_vfs_read(pr->vfs, pr->fd, buf, len);
 	if (ret != (ssize_t) len) {
 		DBG(LOWPROBE, ul_debug("\tread failed: %m"));
-		remove_buffer(bf);
 
 		/* I/O errors on CDROMs are non-fatal to work with hybrid
 		 * audio+data disks */
 		if (ret >= 0 || blkid_probe_is_cdrom(pr) || blkdid_probe_is_opal_locked(pr))
 			errno = 0;
+		return -1;
+	}
+	return 0;
+}
+
+static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint64_t len)
+{
+	struct blkid_bufinfo *bf;
 
+	bf = blkid_probe_alloc_buffer(real_off, len);
+	if (!bf)
 		return NULL;
+
+	if (read_device(pr, bf->data, real_off, len) != 0) {
+		int errsv = errno;
+
+		remove_buffer(bf);
+		errno = errsv;
+		return NULL;
+	}
+
+	return bf;
+}
+
+/*
+ * Buffers cache
+ *
+ * The buffers in pr->buffers never overlap and they are indexed by offset in
+ * pr->bufidx[], so the lookup is a binary search. A read request overlapping
+ * or adjacent to the cached buffers is merged with the buffers -- only the
+ * missing parts are read from the device. The replaced buffers are moved to
+ * pr->prunable_buffers, because the current prober may still use them; they
+ * are deallocated by blkid_probe_prune_buffers() after the prober.
+ *
+ * The cache size may be limited by blkid_probe_set_buffers_limit(), the least
+ * recently used buffers are pruned in this case.
+ */
+#define BLKID_BUFMERGE_MAX	(64 * 1024)	/* max size of the merged buffer */
+
+/* returns index of the last buffer with offset <= @real_off, or -1 */
+static ssize_t bufidx_lookup(blkid_probe pr, uint64_t real_off)
+{
+	size_t lo = 0, hi = pr->nbufs;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (pr->bufidx[mid]->off <= real_off)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
+	return (ssize_t) lo - 1;
+}
+
+static int bufidx_insert(blkid_probe pr, struct blkid_bufinfo *bf)
+{
+	size_t i;
+
+	if (pr->nbufs == pr->bufidx_size) {
+		size_t sz = pr->bufidx_size ? pr->bufidx_size * 2 : 16;
+		struct blkid_bufinfo **tmp;
+
+		tmp = reallocarray(pr->bufidx, sz, sizeof(struct blkid_bufinfo *));
+		if (!tmp)
+			return -ENOMEM;
+		pr->bufidx = tmp;
+		pr->bufidx_size = sz;
+	}
+
+	i = bufidx_lookup(pr, bf->off) + 1;
+	memmove(&pr->bufidx[i + 1], &pr->bufidx[i],
+			(pr->nbufs - i) * sizeof(struct blkid_bufinfo *));
+	pr->bufidx[i] = bf;
+	pr->nbufs++;
+	return 0;
+}
+
+/* removes pr->bufidx[@i] from the cache, the buffer is deallocated later */
+static void unuse_buffer(blkid_probe pr, size_t i)
+{
+	struct blkid_bufinfo *bf = pr->bufidx[i];
+
+	memmove(&pr->bufidx[i], &pr->bufidx[i + 1],
+			(pr->nbufs - i - 1) * sizeof(struct blkid_bufinfo *));
+	pr->nbufs--;
+	pr->bufs_size -= bf->len;
 
-	if (mprotect(bf->data, len, PROT_READ))
+	list_del(&bf->bufs);
+	list_add(&bf->bufs, &pr->prunable_buffers);
+}
+
+/* prunes the least recently used buffers (except @bf) to fit to the limit */
+static void shrink_buffers(blkid_probe pr, const struct blkid_bufinfo *bf)
+{
+	while (pr->bufs_limit && pr->bufs_size > pr->bufs_limit && pr->nbufs > 1) {
+		size_t i, lru = pr->nbufs;
+
+		for (i = 0; i < pr->nbufs; i++) {
+			if (pr->bufidx[i] == bf)
+				continue;
+			if (lru == pr->nbufs || pr->bufidx[i]->used < pr->bufidx[lru]->used)
+				lru = i;
+		}
+		DBG(BUFFER, ul_debug("\tevict: off=%"PRIu64" len=%"PRIu64,
+					pr->bufidx[lru]->off, pr->bufidx[lru]->len));
+		unuse_buffer(pr, lru);
+	}
+}
+
+/* adds a new buffer to the cache, overlapping buffers are replaced */
+static void use_buffer(blkid_probe pr, struct blkid_bufinfo *bf)
+{
+	ssize_t i;
+
+	if (mprotect(bf->data, bf->len, PROT_READ))
 		DBG(LOWPROBE, ul_debug("\tmprotect failed: %m"));
 
-	return bf;
+	i = bufidx_lookup(pr, bf->off);
+	if (i < 0)
+		i = 0;
+	while ((size_t) i < pr->nbufs && pr->bufidx[i]->off < bf->off + bf->len) {
+		const struct blkid_bufinfo *x = pr->bufidx[i];
+
+		if (x->off + x->len > bf->off)
+			unuse_buffer(pr, i);
+		else
+			i++;
+	}
+
+	if (bufidx_insert(pr, bf) != 0) {
+		/* not cached, but still usable for the current prober */
+		list_add(&bf->bufs, &pr->prunable_buffers);
+		return;
+	}
+
+	list_add_tail(&bf->bufs, &pr->buffers);
+	pr->bufs_size += bf->len;
+	bf->used = ++pr->bufs_clock;
+
+	shrink_buffers(pr, bf);
 }
 
 /*
@@ -667,37 +818,180 @@ static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint
 static struct blkid_bufinfo *get_cached_buffer(blkid_probe pr, uint64_t off, uint64_t len)
 {
 	uint64_t real_off = pr->off + off;
-	struct list_head *p;
+	struct blkid_bufinfo *x;
+	ssize_t i;
 
-	list_for_each(p, &pr->buffers) {
-		struct blkid_bufinfo *x =
-				list_entry(p, struct blkid_bufinfo, bufs);
+	i = bufidx_lookup(pr, real_off);
+	if (i < 0)
+		return NULL;
 
-		if (real_off >= x->off && real_off + len <= x->off + x->len) {
-			DBG(BUFFER, ul_debug("\treuse: off=%"PRIu64" len=%"PRIu64" (for off=%"PRIu64" len=%"PRIu64")",
-						x->off, x->len, real_off, len));
-			return x;
-		}
+	x = pr->bufidx[i];
+	if (real_off + len > x->off + x->len)
+		return NULL;
+
+	DBG(BUFFER, ul_debug("\treuse: off=%"PRIu64" len=%"PRIu64" (for off=%"PRIu64" len=%"PRIu64")",
+				x->off, x->len, real_off, len));
+	x->used = ++pr->bufs_clock;
+	return x;
+}
+
+/*
+ * Fills @bf by data from the cached buffers pr->bufidx[@first..@last), the
+ * gaps between them are read from the device.
+ */
+static int fill_buffer(blkid_probe pr, struct blkid_bufinfo *bf, size_t first, size_t last)
+{
+	uint64_t pos = bf->off, end = bf->off + bf->len;
+
+	for (; first < last; first++) {
+		const struct blkid_bufinfo *x = pr->bufidx[first];
+		uint64_t xstart = max(x->off, bf->off);
+		uint64_t xend = min(x->off + x->len, end);
+
+		if (xstart >= xend)
+			continue;
+		if (xstart > pos &&
+		    read_device(pr, bf->data + (pos - bf->off), pos, xstart - pos) != 0)
+			return -1;
+
+		memcpy(bf->data + (xstart - bf->off), x->data + (xstart - x->off),
+				xend - xstart);
+		pos = xend;
 	}
-	return NULL;
+	if (pos < end && read_device(pr, bf->data + (pos - bf->off), pos, end - pos) != 0)
+		return -1;
+	return 0;
 }
 
 /*
- * Mark smaller buffers that can be satisfied by bf as prunable
+ * Reads the area, already cached overlapping or adjacent buffers are merged
+ * to the new buffer and only the missing parts are read from the device. The
+ * new buffer is added to the cache.
+ *
+ * If the merged buffer would be too large, the request is not merged. The
+ * overlapping cached buffers are still valid and they are kept in the cache;
+ * the missing parts are read to a buffer which is not cached and it is
+ * deallocated after the current prober.
  */
-static void mark_prunable_buffers(blkid_probe pr, const struct blkid_bufinfo *bf)
+static struct blkid_bufinfo *read_merged_buffer(blkid_probe pr, uint64_t real_off, uint64_t len)
 {
-	struct list_head *p, *next;
+	struct blkid_bufinfo *bf;
+	uint64_t start = real_off, end = real_off + len;
+	ssize_t i;
+	size_t first, last;
 
-	list_for_each_safe(p, next, &pr->buffers) {
-		struct blkid_bufinfo *x =
-				list_entry(p, struct blkid_bufinfo, bufs);
+	i = bufidx_lookup(pr, real_off);
+	if (i < 0 || pr->bufidx[i]->off + pr->bufidx[i]->len < real_off)
+		i++;
+	first = last = i;
+	while (last < pr->nbufs && pr->bufidx[last]->off <= end)
+		last++;
+
+	if (first < last) {
+		const struct blkid_bufinfo *x = pr->bufidx[last - 1];
 
-		if (bf->off <= x->off && bf->off + bf->len >= x->off + x->len) {
-			list_del(&x->bufs);
-			list_add(&x->bufs, &pr->prunable_buffers);
+		start = min(start, pr->bufidx[first]->off);
+		end = max(end, x->off + x->len);
+	}
+
+	if (first < last && end - start > BLKID_BUFMERGE_MAX) {
+		size_t ovl_first = first, ovl_last = last;
+
+		/* ignore adjacent buffers, only the overlapping buffers matter */
+		if (pr->bufidx[ovl_first]->off + pr->bufidx[ovl_first]->len <= real_off)
+			ovl_first++;
+		if (ovl_last > ovl_first && pr->bufidx[ovl_last - 1]->off >= real_off + len)
+			ovl_last--;
+
+		if (ovl_first == ovl_last) {
+			/* nothing overlaps, cache the area next to the buffers */
+			first = last;
+			start = real_off;
+			end = real_off + len;
+		} else {
+			bf = blkid_probe_alloc_buffer(real_off, len);
+			if (!bf)
+				return NULL;
+
+			DBG(BUFFER, ul_debug("\tunmerged: off=%"PRIu64" len=%"PRIu64,
+						real_off, len));
+			if (fill_buffer(pr, bf, ovl_first, ovl_last) != 0)
+				goto failed;
+
+			if (mprotect(bf->data, bf->len, PROT_READ))
+				DBG(LOWPROBE, ul_debug("\tmprotect failed: %m"));
+			list_add(&bf->bufs, &pr->prunable_buffers);
+			return bf;
 		}
 	}
+
+	if (first == last) {
+		bf = read_buffer(pr, real_off, len);
+		if (bf)
+			use_buffer(pr, bf);
+		return bf;
+	}
+
+	bf = blkid_probe_alloc_buffer(start, end - start);
+	if (!bf)
+		return NULL;
+
+	DBG(BUFFER, ul_debug("\tmerge: off=%"PRIu64" len=%"PRIu64" (for off=%"PRIu64" len=%"PRIu64")",
+				start, end - start, real_off, len));
+
+	if (fill_buffer(pr, bf, first, last) != 0)
+		goto failed;
+
+	use_buffer(pr, bf);
+	return bf;
+failed:
+	{
+		int errsv = errno;
+
+		remove_buffer(bf);
+		errno = errsv;
+	}
+	return NULL;
+}
+
+/*
+ * Returns 1 if the area is already in memory.
+ */
+int blkid_probe_has_buffer(blkid_probe pr, uint64_t off, uint64_t len)
+{
+	return get_cached_buffer(pr, off, len) ? 1 : 0;
+}
+
+/*
+ * Adds already read buffer to the cache.
+ */
+void blkid_probe_add_buffer(blkid_probe pr, struct blkid_bufinfo *bf)
+{
+	use_buffer(pr, bf);
+}
+
+/**
+ * blkid_probe_set_buffers_limit:
+ * @pr: probe
+ * @limit: max size of all cached buffers in bytes, or 0 for unlimited
+ *
+ * libblkid keeps in memory all data read from the device during probing
+ * (until blkid_probe_reset_buffers() or blkid_probe_set_device()). This
+ * function limits the memory, the least recently used buffers are
+ * deallocated if the limit is reached. The buffer used by the current
+ * probing function is never deallocated, so the limit may be temporarily
+ * exceeded. The default is unlimited.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: 2.44
+ */
+int blkid_probe_set_buffers_limit(blkid_probe pr, uint64_t limit)
+{
+	pr->bufs_limit = limit;
+	shrink_buffers(pr, NULL);
+	blkid_probe_prune_buffers(pr);
+	return 0;
 }
 
 /*
@@ -824,12 +1118,9 @@ const unsigned char *blkid_probe_get_buffer(blkid_probe pr, uint64_t off, uint64
 	/* try buffers we already have in memory or read from device */
 	bf = get_cached_buffer(pr, off, len);
 	if (!bf) {
-		bf = read_buffer(pr, real_off, len);
+		bf = read_merged_buffer(pr, real_off, len);
 		if (!bf)
 			return NULL;
-
-		mark_prunable_buffers(pr, bf);
-		list_add_tail(&bf->bufs, &pr->buffers);
 	}
 
 	assert(bf->off <= real_off);
@@ -885,7 +1176,7 @@ int blkid_probe_reset_buffers(blkid_probe pr)
 {
 	uint64_t ct = 0, len = 0;
 
-	pr->flags &= ~BLKID_FL_MODIF_BUFF;
+	pr->flags &= ~(BLKID_FL_MODIF_BUFF | BLKID_FL_PREFETCHED);
 
 	blkid_probe_prune_buffers(pr);
 
@@ -907,6 +1198,8 @@ int blkid_probe_reset_buffers(blkid_probe pr)
 			len, ct));
 
 	INIT_LIST_HEAD(&pr->buffers);
+	pr->nbufs = 0;
+	pr->bufs_size = 0;
 
 	return 0;
 }
@@ -1348,6 +1641,35 @@ uint64_t blkid_probe_get_idmag_off(blkid_probe pr, const struct blkid_idmag *mag
 		return pr->size - (-mag->kboff << 10);
 }
 
+/*
+ * Returns offset of the magic string within probing area, or -1 if the magic
+ * string is irrelevant for the device (zoned magic on non-zoned device).
+ */
+int blkid_probe_get_idmag_location(blkid_probe pr, const struct blkid_idmag *mag,
+			uint64_t *offset)
+{
+	long kboff;
+	uint64_t hint_offset;
+
+	if (!mag->hoff || blkid_probe_get_hint(pr, mag->hoff, &hint_offset) < 0)
+		hint_offset = 0;
+
+	/* If the magic is for zoned device, skip non-zoned device */
+	if (mag->is_zoned && !pr->zone_size)
+		return -1;
+
+	if (!mag->is_zoned)
+		kboff = mag->kboff;
+	else
+		kboff = ((mag->zonenum * pr->zone_size) >> 10) + mag->kboff_inzone;
+
+	if (kboff >= 0)
+		*offset = hint_offset + (kboff << 10) + mag->sboff;
+	else
+		*offset = pr->size - (-kboff << 10) + mag->sboff;
+	return 0;
+}
+
 /*
  * Check for matching magic value.
  * Returns BLKID_PROBE_OK if found, BLKID_PROBE_NONE if not found
@@ -1367,35 +1689,19 @@ int blkid_probe_get_idmag(blkid_probe pr, const struct blkid_idinfo *id,
 	/* try to detect by magic string */
 	while(mag && mag->magic) {
 		const unsigned char *buf;
-		long kboff;
-		uint64_t hint_offset;
-
-		if (!mag->hoff || blkid_probe_get_hint(pr, mag->hoff, &hint_offset) < 0)
-			hint_offset = 0;
 
-		/* If the magic is for zoned device, skip non-zoned device */
-		if (mag->is_zoned && !pr->zone_size) {
+		if (blkid_probe_get_idmag_location(pr, mag, &off) != 0) {
 			mag++;
 			continue;
 		}
-
-		if (!mag->is_zoned)
-			kboff = mag->kboff;
-		else
-			kboff = ((mag->zonenum * pr->zone_size) >> 10) + mag->kboff_inzone;
-
-		if (kboff >= 0)
-			off = hint_offset + (kboff << 10) + mag->sboff;
-		else
-			off = pr->size - (-kboff << 10) + mag->sboff;
 		buf = blkid_probe_get_buffer(pr, off, mag->len);
 
 		if (!buf && errno)
 			return -errno;
 
 		if (buf && !memcmp(mag->magic, buf, mag->len)) {
-			DBG(LOWPROBE, ul_debug("\tmagic sboff=%u, kboff=%ld",
-				mag->sboff, kboff));
+			DBG(LOWPROBE, ul_debug("\tmagic sboff=%u, off=%"PRIu64,
+				mag->sboff, off));
 			if (offset)
 				*offset = off;
 			if (res)
@@ -1418,6 +1724,9 @@ static inline void blkid_probe_start(blkid_probe pr)
 	pr->cur_chain = NULL;
 	pr->prob_flags = 0;
 	blkid_probe_set_wiper(pr, 0, 0);
+
+	if ((pr->flags & BLKID_FL_PREFETCH) && !(pr->flags & BLKID_FL_PREFETCHED))
+		blkid_probe_prefetch(pr);
 }
 
 static inline void blkid_probe_end(blkid_probe pr)
@@ -380,6 +380,8 @@ void blkid_read_cache(blkid_cache cache)
 	int fd, lineno = 0;
 	struct stat st;
 
+	cache->bic_flags &= ~BLKID_BIC_FL_UNREAD;
+
 	/*
 	 * If the file doesn't exist, then we just return an empty
 	 * struct so that the cache can be populated.
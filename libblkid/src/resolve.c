@@ -65,7 +65,7 @@ char *blkid_get_devname(blkid_cache cache, const char *token,
 
 	if (!token)
 		return NULL;
-	if (!cache && blkid_get_cache(&c, NULL) < 0)
+	if (!cache && blkid__new_cache(&c, NULL) < 0)
 		return NULL;
 
 	DBG(TAG, ul_debug("looking for %s%s%s %s", token, value ? "=" : "",
@@ -82,6 +82,14 @@ char *blkid_get_devname(blkid_cache cache, const char *token,
 		value = v;
 	}
 
+	/* try the binary cache if the text cache has not been read yet; the text
+	 * cache is read by blkid_find_dev_with_tag() if necessary */
+	if (c->bic_flags & BLKID_BIC_FL_UNREAD) {
+		ret = blkid_bincache_get_devname(c, token, value);
+		if (ret)
+			goto out;
+	}
+
 	dev = blkid_find_dev_with_tag(c, token, value);
 	if (!dev)
 		goto out;
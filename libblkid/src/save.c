@@ -203,6 +203,10 @@ int blkid_flush_cache(blkid_cache cache)
 		}
 	}
 
+	/* binary index for fast lookups, see bincache.c */
+	if (ret == 1)
+		blkid_bincache_save(cache, filename);
+
 done:
 	free(tmp);
 	if (filename != cache->bic_filename)
@@ -19,6 +19,9 @@
 #include <errno.h>
 #include <stdint.h>
 #include <stdarg.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "superblocks.h"
 
@@ -87,6 +90,7 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn);
 static int superblocks_safeprobe(blkid_probe pr, struct blkid_chain *chn);
 
 static int blkid_probe_set_usage(blkid_probe pr, int usage);
+static void superblocks_free_data(blkid_probe pr, void *data);
 
 
 /*
@@ -197,8 +201,228 @@ const struct blkid_chaindrv superblocks_drv = {
 	.has_fltr     = TRUE,
 	.probe        = superblocks_probe,
 	.safeprobe    = superblocks_safeprobe,
+	.free_data    = superblocks_free_data
 };
 
+/*
+ * Magic strings index
+ *
+ * The probing loop asks every prober for its magic strings, it means many
+ * small lookups to the same device areas. The index groups all static magic
+ * strings (without hint offset and not zoned) by location on the device.
+ * Every area is read and compared only once (when the first prober needs it)
+ * and the loop dispatches only to probers with a matching magic string.
+ *
+ * The index is built only once and shared by all probes. The per-probe state
+ * (already read areas and matching probers) is private superblocks chain data.
+ */
+#define SB_MAGIC_MAX		512	/* max number of indexed magic strings */
+#define SB_MAGIC_AREA_MAX	4096	/* max size of merged area */
+
+struct sb_magic_ref {
+	size_t				idx;	/* idinfos[] index */
+	int				from_end; /* offset is relative to end of device */
+	int64_t				pos;	/* offset of the magic string (negative from end) */
+	const struct blkid_idmag	*mag;
+};
+
+struct sb_magic_area {
+	int		from_end;	/* offset is relative to end of device */
+	int64_t		pos;		/* begin of the area (negative from end) */
+	uint64_t	len;		/* size of the area */
+	size_t		first;		/* first item in sb_magic_refs[] */
+	size_t		nrefs;		/* number of the items */
+};
+
+static struct sb_magic_ref sb_magic_refs[SB_MAGIC_MAX];
+static struct sb_magic_area sb_magic_areas[SB_MAGIC_MAX];
+static size_t sb_magic_nareas;
+
+/* areas used by the prober, idinfos[N] uses sb_magic_idareas[idfirst[N] .. idfirst[N + 1]] */
+static size_t sb_magic_idareas[SB_MAGIC_MAX];
+static size_t sb_magic_idfirst[ARRAY_SIZE(idinfos) + 1];
+
+/* probers not covered by the index (hint offset, zoned or without magic) */
+static unsigned long sb_magic_unindexed[blkid_bmp_nwords(ARRAY_SIZE(idinfos))];
+static int sb_magic_ready;
+
+enum {
+	SB_AREA_UNREAD = 0,
+	SB_AREA_READ,
+	SB_AREA_FAILED
+};
+
+struct sb_magic_state {
+	unsigned char	areas[SB_MAGIC_MAX];	/* SB_AREA_* */
+	unsigned long	matched[blkid_bmp_nwords(ARRAY_SIZE(idinfos))];
+};
+
+static int cmp_magic_refs(const void *a, const void *b)
+{
+	const struct sb_magic_ref *ra = a, *rb = b;
+
+	if (ra->from_end != rb->from_end)
+		return ra->from_end - rb->from_end;
+	if (ra->pos != rb->pos)
+		return ra->pos < rb->pos ? -1 : 1;
+	return ra->idx < rb->idx ? -1 : ra->idx > rb->idx;
+}
+
+static void sb_magic_index_build(void)
+{
+	struct sb_magic_area *ar = NULL;
+	size_t i, a, r, nrefs = 0, nidareas = 0;
+
+	memset(sb_magic_unindexed, 0, sizeof(sb_magic_unindexed));
+
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++) {
+		const struct blkid_idinfo *id = idinfos[i];
+		const struct blkid_idmag *mag;
+		size_t n = 0;
+
+		for (mag = &id->magics[0]; mag->magic; mag++) {
+			if (mag->hoff || mag->is_zoned)
+				break;
+			n++;
+		}
+		if (n == 0 || mag->magic || nrefs + n > SB_MAGIC_MAX) {
+			blkid_bmp_set_item(sb_magic_unindexed, i);
+			continue;
+		}
+		for (mag = &id->magics[0]; mag->magic; mag++) {
+			struct sb_magic_ref *ref = &sb_magic_refs[nrefs++];
+
+			ref->idx = i;
+			ref->mag = mag;
+			ref->from_end = mag->kboff < 0;
+			ref->pos = ((int64_t) mag->kboff * 1024) + mag->sboff;
+		}
+	}
+
+	qsort(sb_magic_refs, nrefs, sizeof(struct sb_magic_ref), cmp_magic_refs);
+
+	/* merge nearby magic strings to areas */
+	for (r = 0; r < nrefs; r++) {
+		struct sb_magic_ref *ref = &sb_magic_refs[r];
+		int64_t end = ref->pos + ref->mag->len;
+
+		if (!ar || ar->from_end != ref->from_end
+		    || end - ar->pos > SB_MAGIC_AREA_MAX) {
+			ar = &sb_magic_areas[sb_magic_nareas++];
+			ar->from_end = ref->from_end;
+			ar->pos = ref->pos;
+			ar->len = 0;
+			ar->first = r;
+			ar->nrefs = 0;
+		}
+		if ((uint64_t) (end - ar->pos) > ar->len)
+			ar->len = end - ar->pos;
+		ar->nrefs++;
+	}
+
+	/* prober to areas mapping */
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++) {
+		sb_magic_idfirst[i] = nidareas;
+
+		for (a = 0; a < sb_magic_nareas; a++) {
+			ar = &sb_magic_areas[a];
+
+			for (r = ar->first; r < ar->first + ar->nrefs; r++) {
+				if (sb_magic_refs[r].idx == i) {
+					sb_magic_idareas[nidareas++] = a;
+					break;
+				}
+			}
+		}
+	}
+	sb_magic_idfirst[i] = nidareas;
+
+	DBG(LOWPROBE, ul_debug("magic index: %zu magics in %zu areas",
+				nrefs, sb_magic_nareas));
+	sb_magic_ready = 1;
+}
+
+static void sb_magic_index_init(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+	pthread_once(&once, sb_magic_index_build);
+#else
+	if (!sb_magic_ready)
+		sb_magic_index_build();
+#endif
+}
+
+static void superblocks_free_data(blkid_probe pr __attribute__((__unused__)),
+				  void *data)
+{
+	free(data);
+}
+
+/* returns per-probe index state reset for a new probing loop, or NULL */
+static struct sb_magic_state *sb_magic_reset_state(struct blkid_chain *chn)
+{
+	sb_magic_index_init();
+	if (!sb_magic_ready)
+		return NULL;
+
+	if (!chn->data)
+		chn->data = malloc(sizeof(struct sb_magic_state));
+	if (chn->data)
+		memset(chn->data, 0, sizeof(struct sb_magic_state));
+	return chn->data;
+}
+
+static void sb_magic_read_area(blkid_probe pr, struct sb_magic_state *st, size_t a)
+{
+	const struct sb_magic_area *ar = &sb_magic_areas[a];
+	const unsigned char *buf;
+	uint64_t off;
+	size_t r;
+
+	off = ar->from_end ? pr->size + ar->pos : (uint64_t) ar->pos;
+	buf = blkid_probe_get_buffer(pr, off, ar->len);
+	if (!buf) {
+		/* let the probers to read their magic strings on their own */
+		st->areas[a] = SB_AREA_FAILED;
+		errno = 0;
+		return;
+	}
+	st->areas[a] = SB_AREA_READ;
+
+	for (r = ar->first; r < ar->first + ar->nrefs; r++) {
+		const struct sb_magic_ref *ref = &sb_magic_refs[r];
+
+		if (!memcmp(ref->mag->magic, buf + (ref->pos - ar->pos), ref->mag->len))
+			blkid_bmp_set_item(st->matched, ref->idx);
+	}
+}
+
+/*
+ * Returns 0 if the prober @idx has no matching magic string, or 1 if the
+ * prober has to be called.
+ */
+static int sb_magic_probe_needed(blkid_probe pr, struct sb_magic_state *st, size_t idx)
+{
+	size_t i;
+	int failed = 0;
+
+	if (!st || blkid_bmp_get_item(sb_magic_unindexed, idx))
+		return 1;
+
+	for (i = sb_magic_idfirst[idx]; i < sb_magic_idfirst[idx + 1]; i++) {
+		size_t a = sb_magic_idareas[i];
+
+		if (st->areas[a] == SB_AREA_UNREAD)
+			sb_magic_read_area(pr, st, a);
+		if (st->areas[a] == SB_AREA_FAILED)
+			failed = 1;
+	}
+
+	return failed || blkid_bmp_get_item(st->matched, idx) ? 1 : 0;
+}
+
 /**
  * blkid_probe_enable_superblocks:
  * @pr: probe
@@ -353,6 +577,7 @@ int blkid_superblocks_get_name(size_t idx, const char **name, int *usage)
  */
 static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 {
+	struct sb_magic_state *st;
 	size_t i;
 	int rc = BLKID_PROBE_NONE;
 
@@ -378,6 +603,7 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 		chn->idx));
 
 	i = chn->idx < 0 ? 0 : chn->idx + 1U;
+	st = sb_magic_reset_state(chn);
 
 	for ( ; i < ARRAY_SIZE(idinfos); i++) {
 		const struct blkid_idinfo *id;
@@ -411,6 +637,11 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 			continue;
 		}
 
+		if (!sb_magic_probe_needed(pr, st, i)) {
+			rc = BLKID_PROBE_NONE;
+			continue;
+		}
+
 		DBG(LOWPROBE, ul_debug("[%zu] %s:", i, id->name));
 
 		rc = blkid_probe_get_idmag(pr, id, &off, &mag);
@@ -16,6 +16,7 @@
 #include <stdio.h>
 
 #include "blkidP.h"
+#include "xxhash.h"
 
 static blkid_tag blkid_new_tag(void)
 {
@@ -27,10 +28,91 @@ static blkid_tag blkid_new_tag(void)
 	DBG_OBJ(TAG, tag, ul_debug("alloc"));
 	INIT_LIST_HEAD(&tag->bit_tags);
 	INIT_LIST_HEAD(&tag->bit_names);
+	INIT_LIST_HEAD(&tag->bit_hash);
 
 	return tag;
 }
 
+/*
+ * The cache keeps all device tags in NAME=value hash index to make
+ * blkid_find_dev_with_tag() independent on number of devices. The buckets
+ * are sorted by bit_seq, so the tags are found in the same order as by
+ * bit_names list, also after a value update.
+ */
+static struct list_head *tag_hash_bucket(blkid_cache cache,
+				const char *name, const char *value)
+{
+	uint32_t h;
+
+	if (!cache->bic_hash)
+		return NULL;
+
+	h = XXH32(value, strlen(value), XXH32(name, strlen(name), 0));
+	return &cache->bic_hash[h & (cache->bic_hashsz - 1)];
+}
+
+static void tag_hash_resize(blkid_cache cache, size_t sz)
+{
+	struct list_head *old = cache->bic_hash;
+	size_t i, oldsz = cache->bic_hashsz;
+
+	cache->bic_hash = malloc(sz * sizeof(struct list_head));
+	if (!cache->bic_hash) {
+		cache->bic_hash = old;	/* keep the old index */
+		return;
+	}
+	cache->bic_hashsz = sz;
+	for (i = 0; i < sz; i++)
+		INIT_LIST_HEAD(&cache->bic_hash[i]);
+
+	/* move tags to the new buckets, the order is preserved */
+	for (i = 0; i < oldsz; i++) {
+		while (!list_empty(&old[i])) {
+			blkid_tag t = list_entry(old[i].next,
+					struct blkid_struct_tag, bit_hash);
+
+			list_del(&t->bit_hash);
+			list_add_tail(&t->bit_hash,
+				tag_hash_bucket(cache, t->bit_name, t->bit_val));
+		}
+	}
+
+	DBG(TAG, ul_debug("tags index resized to %zu buckets", sz));
+	free(old);
+}
+
+static int tag_hash_add(blkid_cache cache, blkid_tag t)
+{
+	struct list_head *bucket, *p;
+
+	if (cache->bic_nhashed >= cache->bic_hashsz)
+		tag_hash_resize(cache, cache->bic_hashsz ? cache->bic_hashsz * 2 : 64);
+	if (!cache->bic_hash)
+		return -BLKID_ERR_MEM;
+
+	/* new tags go to the tail, updated tags to their original position */
+	bucket = tag_hash_bucket(cache, t->bit_name, t->bit_val);
+	list_for_each_backwardly(p, bucket) {
+		blkid_tag x = list_entry(p, struct blkid_struct_tag, bit_hash);
+
+		if (x->bit_seq < t->bit_seq)
+			break;
+	}
+	list_add(&t->bit_hash, p);
+	cache->bic_nhashed++;
+	return 0;
+}
+
+static void tag_hash_remove(blkid_tag t)
+{
+	if (list_empty(&t->bit_hash))
+		return;
+
+	list_del_init(&t->bit_hash);
+	if (t->bit_dev && t->bit_dev->bid_cache)
+		t->bit_dev->bid_cache->bic_nhashed--;
+}
+
 void blkid_free_tag(blkid_tag tag)
 {
 	if (!tag)
@@ -38,6 +120,7 @@ void blkid_free_tag(blkid_tag tag)
 
 	DBG_OBJ(TAG, tag, ul_debug("freeing tag %s (%s)", tag->bit_name, tag->bit_val));
 
+	tag_hash_remove(tag);		/* NAME=value index */
 	list_del(&tag->bit_tags);	/* list of tags for this device */
 	list_del(&tag->bit_names);	/* list of tags with this type */
 
@@ -141,6 +224,12 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 		DBG_OBJ(TAG, t, ul_debug("update (%s) '%s' -> '%s'", t->bit_name, t->bit_val, val));
 		free(t->bit_val);
 		t->bit_val = val;
+
+		/* re-hash; can't fail as the index already exists */
+		if (!list_empty(&t->bit_hash)) {
+			tag_hash_remove(t);
+			tag_hash_add(dev->bid_cache, t);
+		}
 	} else {
 		/* Existing tag not present, add to device */
 		if (!(t = blkid_new_tag()))
@@ -148,6 +237,8 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 		t->bit_name = strdup(name);
 		t->bit_val = val;
 		t->bit_dev = dev;
+		if (!t->bit_name)
+			goto errout;
 
 		DBG_OBJ(TAG, t, ul_debug("setting (%s) '%s'", t->bit_name, t->bit_val));
 		list_add_tail(&t->bit_tags, &dev->bid_tags);
@@ -168,6 +259,12 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 					      &dev->bid_cache->bic_tags);
 			}
 			list_add_tail(&t->bit_names, &head->bit_names);
+			t->bit_seq = ++dev->bid_cache->bic_tagseq;
+
+			if (tag_hash_add(dev->bid_cache, t) != 0) {
+				head = NULL;	/* used by other tags */
+				goto errout;
+			}
 		}
 	}
 
@@ -324,10 +421,9 @@ blkid_dev blkid_find_dev_with_tag(blkid_cache cache,
 					 const char *type,
 					 const char *value)
 {
-	blkid_tag	head;
 	blkid_dev	dev;
 	int		pri;
-	struct list_head *p;
+	struct list_head *p, *bucket;
 	int		probe_new = 0, probe_all = 0;
 
 	if (!cache || !type || !value)
@@ -340,14 +436,15 @@ blkid_dev blkid_find_dev_with_tag(blkid_cache cache,
 try_again:
 	pri = -1;
 	dev = NULL;
-	head = blkid_find_head_cache(cache, type);
+	bucket = tag_hash_bucket(cache, type, value);
 
-	if (head) {
-		list_for_each(p, &head->bit_names) {
+	if (bucket) {
+		list_for_each(p, bucket) {
 			blkid_tag tmp = list_entry(p, struct blkid_struct_tag,
-						   bit_names);
+						   bit_hash);
 
-			if (!strcmp(tmp->bit_val, value) &&
+			if (!strcmp(tmp->bit_name, type) &&
+			    !strcmp(tmp->bit_val, value) &&
 			    (tmp->bit_dev->bid_pri > pri) &&
 			    !access(tmp->bit_dev->bid_name, F_OK)) {
 				dev = tmp->bit_dev;
@@ -50,6 +50,116 @@ static void blkid_probe_to_tags(blkid_probe pr, blkid_dev dev)
 	}
 }
 
+/*
+ * Probes the device opened by @pr and copies the result to @dev tags. Returns
+ * 0 on success, 1 if nothing found or <0 on error.
+ */
+static int probe_to_dev(blkid_probe pr, blkid_dev dev)
+{
+	int rc;
+
+	/* enable superblocks probing */
+	blkid_probe_enable_superblocks(pr, TRUE);
+	blkid_probe_set_superblocks_flags(pr,
+		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
+
+	/* enable partitions probing */
+	blkid_probe_enable_partitions(pr, TRUE);
+	blkid_probe_set_partitions_flags(pr, BLKID_PARTS_ENTRY_DETAILS);
+
+	/* probe */
+	rc = blkid_do_safeprobe(pr);
+	if (rc == 0)
+		blkid_probe_to_tags(pr, dev);
+	return rc;
+}
+
+/*
+ * Probes @devname by @pr and returns the result as a new (not cached) device
+ * in @res. This is used to probe devices in advance by
+ * blkid_probe_all_parallel() worker threads, so it does not touch the cache.
+ *
+ * Returns 0 on success, 1 if nothing found or <0 on error.
+ */
+int blkid__probe_dev(blkid_probe pr, const char *devname, blkid_dev *res)
+{
+	blkid_dev dev;
+	int rc;
+
+	*res = NULL;
+
+	if (blkid_probe_open_device(pr, devname, 0))
+		return -errno;
+
+	dev = blkid_new_dev();
+	if (!dev)
+		rc = -ENOMEM;
+	else
+		rc = probe_to_dev(pr, dev);
+
+	blkid_probe_reset_superblocks_filter(pr);
+	blkid_probe_set_device(pr, -1, 0, 0);
+
+	if (rc == 0)
+		*res = dev;
+	else
+		blkid_free_dev(dev);
+	return rc;
+}
+
+/* returns result from blkid_probe_all_parallel() or NULL */
+static struct blkid_preprobed *get_preprobed(blkid_cache cache, dev_t devno)
+{
+	size_t lo = 0, hi = cache->bic_npreprobed;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		struct blkid_preprobed *pp = &cache->bic_preprobed[mid];
+
+		if (pp->devno == devno)
+			return pp;
+		if (pp->devno < devno)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return NULL;
+}
+
+/*
+ * Returns 1 if blkid_verify() would probe the device, 0 if the cached data
+ * are recent enough, or <0 if the device cannot be stat()ed. The device
+ * stat data are returned in @st if not NULL.
+ */
+int blkid__verify_needed(blkid_dev dev, struct stat *st)
+{
+	struct stat sb;
+	time_t diff, now;
+
+	if (!st)
+		st = &sb;
+
+	now = time(NULL);
+	diff = (uintmax_t)now - dev->bid_time;
+
+	if (stat(dev->bid_name, st) < 0)
+		return -errno;
+
+	if (now >= dev->bid_time &&
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	    (st->st_mtime < dev->bid_time ||
+	        (st->st_mtime == dev->bid_time &&
+		 (suseconds_t) (st->st_mtim.tv_nsec / NSEC_PER_USEC) <= dev->bid_utime)) &&
+#else
+	    st->st_mtime <= dev->bid_time &&
+#endif
+	    diff >= 0 && diff < BLKID_PROBE_MIN)
+		return 0;
+
+	return 1;
+}
+
 /*
  * Verify that the data in dev is consistent with what is on the actual
  * block device (using the devname field only).  Normally this will be
@@ -63,31 +173,23 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 {
 	blkid_tag_iterate iter;
 	const char *type, *value;
+	struct blkid_preprobed *pp;
 	struct stat st;
-	time_t diff, now;
+	int rc;
 
 	if (!dev || !cache)
 		return NULL;
 
-	now = time(NULL);
-	diff = (uintmax_t)now - dev->bid_time;
-
-	if (stat(dev->bid_name, &st) < 0) {
+	rc = blkid__verify_needed(dev, &st);
+	if (rc < 0) {
+		errno = -rc;
 		DBG(PROBE, ul_debug("blkid_verify: error %m (%d) while "
 			   "trying to stat %s", errno,
 			   dev->bid_name));
 		goto dev_err;
 	}
 
-	if (now >= dev->bid_time &&
-#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
-	    (st.st_mtime < dev->bid_time ||
-	        (st.st_mtime == dev->bid_time &&
-		 (suseconds_t) (st.st_mtim.tv_nsec / NSEC_PER_USEC) <= dev->bid_utime)) &&
-#else
-	    st.st_mtime <= dev->bid_time &&
-#endif
-	    diff >= 0 && diff < BLKID_PROBE_MIN) {
+	if (rc == 0) {
 		dev->bid_flags |= BLKID_BID_FL_VERIFIED;
 		return dev;
 	}
@@ -96,25 +198,30 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 	DBG(PROBE, ul_debug("need to revalidate %s (cache time %lld, stat time %lld,\t"
 		   "time since last check %lld)",
 		   dev->bid_name, (long long)dev->bid_time,
-		   (long long)st.st_mtime, (long long)diff));
+		   (long long)st.st_mtime,
+		   (long long)(time(NULL) - dev->bid_time)));
 #else
 	DBG(PROBE, ul_debug("need to revalidate %s (cache time %lld.%lld, stat time %lld.%lld,\t"
 		   "time since last check %lld)",
 		   dev->bid_name,
 		   (long long)dev->bid_time, (long long)dev->bid_utime,
 		   (long long)st.st_mtime, (long long) (st.st_mtim.tv_nsec / NSEC_PER_USEC),
-		   (long long)diff));
+		   (long long)(time(NULL) - dev->bid_time)));
 #endif
 
 	if (sysfs_devno_is_dm_private(st.st_rdev, NULL, NULL))
 		goto dev_free;
-	if (!cache->probe) {
+
+	/* already probed by blkid_probe_all_parallel() */
+	pp = get_preprobed(cache, st.st_rdev);
+
+	if (!pp && !cache->probe) {
 		cache->probe = blkid_new_probe();
 		if (!cache->probe)
 			goto dev_free;
 	}
 
-	if (blkid_probe_open_device(cache->probe, dev->bid_name, 0)) {
+	if (!pp && blkid_probe_open_device(cache->probe, dev->bid_name, 0)) {
 		DBG(PROBE, ul_debug("blkid_verify: error %m (%d) while "
 					"opening %s", errno,
 					dev->bid_name));
@@ -127,18 +234,19 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		blkid_set_tag(dev, type, NULL, 0);
 	blkid_tag_iterate_end(iter);
 
-	/* enable superblocks probing */
-	blkid_probe_enable_superblocks(cache->probe, TRUE);
-	blkid_probe_set_superblocks_flags(cache->probe,
-		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
-		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
-
-	/* enable partitions probing */
-	blkid_probe_enable_partitions(cache->probe, TRUE);
-	blkid_probe_set_partitions_flags(cache->probe, BLKID_PARTS_ENTRY_DETAILS);
+	if (pp) {
+		DBG(PROBE, ul_debug("%s: using pre-probed result", dev->bid_name));
+		rc = pp->rc;
+		if (rc == 0) {
+			iter = blkid_tag_iterate_begin(pp->dev);
+			while (blkid_tag_next(iter, &type, &value) == 0)
+				blkid_set_tag(dev, type, value, strlen(value));
+			blkid_tag_iterate_end(iter);
+		}
+	} else
+		rc = probe_to_dev(cache->probe, dev);
 
-	/* probe */
-	if (blkid_do_safeprobe(cache->probe)) {
+	if (rc) {
 		/* found nothing or error */
 		blkid_free_dev(dev);
 		dev = NULL;
@@ -158,15 +266,15 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		dev->bid_flags |= BLKID_BID_FL_VERIFIED;
 		cache->bic_flags |= BLKID_BIC_FL_CHANGED;
 
-		blkid_probe_to_tags(cache->probe, dev);
-
 		DBG(PROBE, ul_debug("%s: devno 0x%04llx, type %s",
 			   dev->bid_name, (long long)st.st_rdev, dev->bid_type));
 	}
 
 	/* reset prober */
-	blkid_probe_reset_superblocks_filter(cache->probe);
-	blkid_probe_set_device(cache->probe, -1, 0, 0);
+	if (!pp) {
+		blkid_probe_reset_superblocks_filter(cache->probe);
+		blkid_probe_set_device(cache->probe, -1, 0, 0);
+	}
 
 	return dev;
 
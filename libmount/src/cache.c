@@ -45,6 +45,7 @@
  * Canonicalized (resolved) paths & tags cache
  */
 #define MNT_CACHE_CHUNKSZ	128
+#define MNT_CACHE_ARENASZ	4096	/* default size of the keys arena chunk */
 
 #define MNT_CACHE_ISTAG		(1 << 1) /* entry is TAG */
 #define MNT_CACHE_ISPATH	(1 << 2) /* entry is path */
@@ -55,12 +56,32 @@ struct mnt_cache_entry {
 	char			*key;	/* search key (e.g. uncanonicalized path) */
 	char			*value;	/* value (e.g. canonicalized path) */
 	int			flag;
+
+	size_t			knext;	/* next entry in keys index (idx + 1) */
+	size_t			vnext;	/* next entry in devices index (idx + 1) */
+};
+
+/* memory for the keys; never reallocated, so the keys are stable */
+struct mnt_cache_chunk {
+	struct mnt_cache_chunk	*next;
+	size_t			size;
+	size_t			used;
+	char			data[];
 };
 
 struct libmnt_cache {
 	struct mnt_cache_entry	*ents;
 	size_t			nents;
 	size_t			nallocs;
+
+	/* Hash indexes, buckets contain entry index + 1 (or 0). The keys
+	 * index is for paths and NAME=value tags, the devices index is for
+	 * tag values (device names). */
+	size_t			*kidx;
+	size_t			*vidx;
+	size_t			nbuckets;	/* power of 2 */
+
+	struct mnt_cache_chunk	*arena;		/* keys */
 	int			refcount;
 	int			probe_sb_extra;	/* extra BLKID_SUBLKS_* flags */
 	bool			noprobe;	/* disable libblkid device probing */
@@ -131,13 +152,19 @@ void mnt_free_cache(struct libmnt_cache *cache)
 
 	DBG_OBJ(CACHE, cache, ul_debug("free [refcount=%d]", cache->refcount));
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
-		if (e->value != e->key)
-			free(e->value);
-		free(e->key);
-	}
+	/* keys are in the arena or the same as values */
+	for (i = 0; i < cache->nents; i++)
+		free(cache->ents[i].value);
 	free(cache->ents);
+	free(cache->kidx);
+	free(cache->vidx);
+
+	while (cache->arena) {
+		struct mnt_cache_chunk *ch = cache->arena;
+
+		cache->arena = ch->next;
+		free(ch);
+	}
 	if (cache->bc)
 		blkid_put_cache(cache->bc);
 	free(cache);
@@ -244,6 +271,114 @@ int mnt_cache_refer_vfs(struct libmnt_cache *cache, const struct ul_vfs_ops *vfs
 	return 0;
 }
 
+/* allocates memory for a key; the memory is deallocated by mnt_free_cache() */
+static char *cache_alloc_key(struct libmnt_cache *cache, size_t sz)
+{
+	struct mnt_cache_chunk *ch = cache->arena;
+	char *res;
+
+	if (!ch || ch->size - ch->used < sz) {
+		size_t chsz = max(sz, (size_t) MNT_CACHE_ARENASZ);
+
+		ch = malloc(sizeof(*ch) + chsz);
+		if (!ch)
+			return NULL;
+		ch->size = chsz;
+		ch->used = 0;
+		ch->next = cache->arena;
+		cache->arena = ch;
+	}
+
+	res = ch->data + ch->used;
+	ch->used += sz;
+	return res;
+}
+
+static char *cache_strdup_key(struct libmnt_cache *cache, const char *str)
+{
+	size_t sz = strlen(str) + 1;
+	char *key = cache_alloc_key(cache, sz);
+
+	if (key)
+		memcpy(key, str, sz);
+	return key;
+}
+
+#define MNT_CACHE_HASH_INIT	2166136261U	/* FNV-1a */
+
+static inline uint32_t hash_str(uint32_t h, const char *str)
+{
+	for (; *str; str++)
+		h = (h ^ (unsigned char) *str) * 16777619U;
+	return h;
+}
+
+static uint32_t hash_tag(const char *token, const char *value)
+{
+	uint32_t h = hash_str(MNT_CACHE_HASH_INIT, token);
+
+	h = (h ^ '=') * 16777619U;
+	return hash_str(h, value);
+}
+
+static inline size_t *bucket_of(size_t *idx, size_t nbuckets, uint32_t hash)
+{
+	return &idx[hash & (nbuckets - 1)];
+}
+
+static void cache_index_entry(struct libmnt_cache *cache, size_t i)
+{
+	struct mnt_cache_entry *e = &cache->ents[i];
+	uint32_t hash;
+	size_t *b;
+
+	if (e->flag & MNT_CACHE_ISTAG)
+		hash = hash_tag(e->key, e->key + strlen(e->key) + 1);
+	else
+		hash = mnt_hash_path(e->key);
+
+	b = bucket_of(cache->kidx, cache->nbuckets, hash);
+	e->knext = *b;
+	*b = i + 1;
+
+	if (e->flag & MNT_CACHE_ISTAG) {
+		b = bucket_of(cache->vidx, cache->nbuckets, hash_str(MNT_CACHE_HASH_INIT, e->value));
+		e->vnext = *b;
+		*b = i + 1;
+	} else
+		e->vnext = 0;
+}
+
+/* make sure the indexes are large enough for one more entry */
+static int cache_grow_index(struct libmnt_cache *cache)
+{
+	size_t *kidx, *vidx, sz, i;
+
+	if (cache->nents < cache->nbuckets)
+		return 0;
+
+	sz = cache->nbuckets ? cache->nbuckets * 2 : MNT_CACHE_CHUNKSZ;
+	kidx = calloc(sz, sizeof(size_t));
+	vidx = calloc(sz, sizeof(size_t));
+	if (!kidx || !vidx) {
+		free(kidx);
+		free(vidx);
+		return -ENOMEM;
+	}
+
+	free(cache->kidx);
+	free(cache->vidx);
+	cache->kidx = kidx;
+	cache->vidx = vidx;
+	cache->nbuckets = sz;
+
+	for (i = 0; i < cache->nents; i++)
+		cache_index_entry(cache, i);
+
+	DBG_OBJ(CACHE, cache, ul_debug("index resized to %zu buckets", sz));
+	return 0;
+}
+
 /* note that the @key could be the same pointer as @value */
 static int cache_add_entry(struct libmnt_cache *cache, char *key,
 					char *value, int flag)
@@ -263,11 +398,14 @@ static int cache_add_entry(struct libmnt_cache *cache, char *key,
 		cache->ents = e;
 		cache->nallocs = sz;
 	}
+	if (cache_grow_index(cache))
+		return -ENOMEM;
 
 	e = &cache->ents[cache->nents];
 	e->key = key;
 	e->value = value;
 	e->flag = flag;
+	cache_index_entry(cache, cache->nents);
 	cache->nents++;
 
 	DBG_OBJ(CACHE, cache, ul_debug("add entry [%2zu] (%s): %s: %s",
@@ -283,7 +421,6 @@ static int cache_add_tag(struct libmnt_cache *cache, const char *tagname,
 {
 	size_t tksz, vlsz;
 	char *key;
-	int rc;
 
 	assert(cache);
 	assert(devname);
@@ -297,19 +434,14 @@ static int cache_add_tag(struct libmnt_cache *cache, const char *tagname,
 	tksz = strlen(tagname);
 	vlsz = strlen(tagval);
 
-	key = malloc(tksz + vlsz + 2);
+	key = cache_alloc_key(cache, tksz + vlsz + 2);
 	if (!key)
 		return -ENOMEM;
 
 	memcpy(key, tagname, tksz + 1);	   /* include '\0' */
 	memcpy(key + tksz + 1, tagval, vlsz + 1);
 
-	rc = cache_add_entry(cache, key, devname, flag | MNT_CACHE_ISTAG);
-	if (!rc)
-		return 0;
-
-	free(key);
-	return rc;
+	return cache_add_entry(cache, key, devname, flag | MNT_CACHE_ISTAG);
 }
 
 
@@ -318,19 +450,22 @@ static int cache_add_tag(struct libmnt_cache *cache, const char *tagname,
  */
 static const char *cache_find_path(struct libmnt_cache *cache, const char *path)
 {
+	struct mnt_cache_entry *res = NULL;
 	size_t i;
 
-	if (!cache || !path)
+	if (!cache || !path || !cache->nents)
 		return NULL;
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	/* the buckets are in reverse order, the first added entry wins */
+	i = *bucket_of(cache->kidx, cache->nbuckets, mnt_hash_path(path));
+	for (; i; i = cache->ents[i - 1].knext) {
+		struct mnt_cache_entry *e = &cache->ents[i - 1];
 		if (!(e->flag & MNT_CACHE_ISPATH))
 			continue;
 		if (streq_paths(path, e->key))
-			return e->value;
+			res = e;
 	}
-	return NULL;
+	return res ? res->value : NULL;
 }
 
 /*
@@ -339,52 +474,61 @@ static const char *cache_find_path(struct libmnt_cache *cache, const char *path)
 static const char *cache_find_tag(struct libmnt_cache *cache,
 			const char *token, const char *value)
 {
+	struct mnt_cache_entry *res = NULL;
 	size_t i;
 	size_t tksz;
 
-	if (!cache || !token || !value)
+	if (!cache || !token || !value || !cache->nents)
 		return NULL;
 
 	tksz = strlen(token);
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	i = *bucket_of(cache->kidx, cache->nbuckets, hash_tag(token, value));
+	for (; i; i = cache->ents[i - 1].knext) {
+		struct mnt_cache_entry *e = &cache->ents[i - 1];
 		if (!(e->flag & MNT_CACHE_ISTAG))
 			continue;
 		if (strcmp(token, e->key) == 0 &&
 		    strcmp(value, e->key + tksz + 1) == 0)
-			return e->value;
+			res = e;
 	}
-	return NULL;
+	return res ? res->value : NULL;
 }
 
 static char *cache_find_tag_value(struct libmnt_cache *cache,
 			const char *devname, const char *token)
 {
+	struct mnt_cache_entry *res = NULL;
 	size_t i;
 
 	assert(cache);
 	assert(devname);
 	assert(token);
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
-		if (!(e->flag & MNT_CACHE_ISTAG))
-			continue;
+	if (!cache->nents)
+		return NULL;
+
+	i = *bucket_of(cache->vidx, cache->nbuckets, hash_str(MNT_CACHE_HASH_INIT, devname));
+	for (; i; i = cache->ents[i - 1].vnext) {
+		struct mnt_cache_entry *e = &cache->ents[i - 1];
 		if (strcmp(e->value, devname) == 0 &&	/* dev name */
 		    strcmp(token, e->key) == 0)	/* tag name */
-			return e->key + strlen(token) + 1;	/* tag value */
+			res = e;
 	}
 
-	return NULL;
+	return res ? res->key + strlen(token) + 1 : NULL;	/* tag value */
 }
 
 static bool is_device_cached(struct libmnt_cache *cache, const char *devname)
 {
 	size_t i;
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	if (!cache->nents)
+		return 0;
+
+	i = *bucket_of(cache->vidx, cache->nbuckets, hash_str(MNT_CACHE_HASH_INIT, devname));
+	for (; i; i = cache->ents[i - 1].vnext) {
+		struct mnt_cache_entry *e = &cache->ents[i - 1];
 		if (!(e->flag & MNT_CACHE_TAGREAD))
 			continue;
 		if (strcmp(e->value, devname) == 0)
@@ -675,28 +819,20 @@ static char *canonicalize_path_and_cache(const char *path,
 {
 	char *p;
 	char *key;
-	char *value;
 
 	DBG_OBJ(CACHE, cache, ul_debug("canonicalize path %s", path));
 	p = ul_canonicalize_path(path);
 
 	if (p && cache) {
-		value = p;
-		key = strcmp(path, p) == 0 ? value : strdup(path);
-
-		if (!key || !value)
-			goto error;
+		key = strcmp(path, p) == 0 ? p : cache_strdup_key(cache, path);
 
-		if (cache_add_entry(cache, key, value,
-				MNT_CACHE_ISPATH))
+		if (!key || cache_add_entry(cache, key, p, MNT_CACHE_ISPATH))
 			goto error;
 	}
 
 	return p;
 error:
-	if (value != key)
-		free(value);
-	free(key);
+	free(p);
 	return NULL;
 }
 
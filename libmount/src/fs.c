@@ -64,6 +64,52 @@ void mnt_free_fs(struct libmnt_fs *fs)
 	free(fs);
 }
 
+/*
+ * The mountinfo parser reads the whole file to one buffer (arena), unmangles
+ * the strings in place and all the parsed entries point to the buffer. The
+ * arena is reference counted and deallocated together with the last entry.
+ *
+ * The strings in the arena are read-only; use mnt_fs_unshare_str() to get
+ * a private copy before the string is modified or deallocated.
+ */
+void mnt_ref_arena(struct libmnt_arena *ar)
+{
+	if (ar)
+		ar->refcount++;
+}
+
+void mnt_unref_arena(struct libmnt_arena *ar)
+{
+	if (ar) {
+		ar->refcount--;
+		if (ar->refcount <= 0)
+			free(ar);
+	}
+}
+
+/*
+ * Replaces *@str with a private copy if the string is stored in the @fs
+ * arena. Returns 0 or -ENOMEM.
+ */
+int mnt_fs_unshare_str(struct libmnt_fs *fs, char **str)
+{
+	char *p;
+
+	if (!fs->arena || !mnt_arena_has_str(fs->arena, *str))
+		return 0;
+	p = strdup(*str);
+	if (!p)
+		return -ENOMEM;
+	*str = p;
+	return 0;
+}
+
+static void free_fs_str(struct libmnt_fs *fs, char *str)
+{
+	if (!mnt_arena_has_str(fs->arena, str))
+		free(str);
+}
+
 /**
  * mnt_reset_fs:
  * @fs: fs pointer
@@ -79,23 +125,27 @@ void mnt_reset_fs(struct libmnt_fs *fs)
 
 	ref = fs->refcount;
 
+	mnt_table_invalidate_index(fs->tab);
 	list_del(&fs->ents);
-	free(fs->source);
+	free_fs_str(fs, fs->source);
 	free(fs->bindsrc);
 	free(fs->tagname);
 	free(fs->tagval);
-	free(fs->root);
+	free_fs_str(fs, fs->root);
 	free(fs->swaptype);
-	free(fs->target);
-	free(fs->fstype);
+	free_fs_str(fs, fs->target);
+	free_fs_str(fs, fs->fstype);
 	free(fs->optstr);
-	free(fs->vfs_optstr);
-	free(fs->fs_optstr);
+	free_fs_str(fs, fs->vfs_optstr);
+	free_fs_str(fs, fs->fs_optstr);
 	free(fs->user_optstr);
 	free(fs->attrs);
-	free(fs->opt_fields);
+	free_fs_str(fs, fs->opt_fields);
 	free(fs->comment);
 
+	mnt_unref_arena(fs->arena);
+	fs->arena = NULL;
+
 	mnt_unref_optlist(fs->optlist);
 	fs->optlist = NULL;
 
@@ -197,12 +247,16 @@ static inline int sync_opts_from_optlist(struct libmnt_fs *fs, struct libmnt_opt
 		/* FS options */
 		if (!rc)
 			rc = mnt_optlist_get_optstr(ol, &p, NULL, MNT_OL_FLTR_UNKNOWN);
+		if (!rc)
+			rc = mnt_fs_unshare_str(fs, &fs->fs_optstr);
 		if (!rc)
 			rc = strdup_to_struct_member(fs, fs_optstr, p);
 
 		/* VFS options */
 		if (!rc)
 			rc = mnt_optlist_get_optstr(ol, &p, mnt_get_builtin_optmap(MNT_LINUX_MAP), 0);
+		if (!rc)
+			rc = mnt_fs_unshare_str(fs, &fs->vfs_optstr);
 		if (!rc)
 			rc = strdup_to_struct_member(fs, vfs_optstr, p);
 
@@ -272,6 +326,8 @@ struct libmnt_fs *mnt_copy_fs(struct libmnt_fs *dest,
 		dest->tab	 = NULL;
 	}
 
+	mnt_table_invalidate_index(dest->tab);
+
 	dest->id         = src->id;
 	dest->parent     = src->parent;
 	dest->devno      = src->devno;
@@ -468,7 +524,7 @@ int __mnt_fs_set_source_ptr(struct libmnt_fs *fs, char *source)
 	}
 
 	if (fs->source != source)
-		free(fs->source);
+		free_fs_str(fs, fs->source);
 
 	free(fs->tagname);
 	free(fs->tagval);
@@ -476,6 +532,7 @@ int __mnt_fs_set_source_ptr(struct libmnt_fs *fs, char *source)
 	fs->source = source;
 	fs->tagname = t;
 	fs->tagval = v;
+	mnt_table_invalidate_index(fs->tab);
 	return 0;
 }
 
@@ -642,15 +699,27 @@ const char *mnt_fs_get_target(struct libmnt_fs *fs)
  */
 int mnt_fs_set_target(struct libmnt_fs *fs, const char *tgt)
 {
-	return strdup_to_struct_member(fs, target, tgt);
+	int rc;
+
+	if (!fs)
+		return -EINVAL;
+
+	rc = mnt_fs_unshare_str(fs, &fs->target);
+	if (!rc)
+		rc = strdup_to_struct_member(fs, target, tgt);
+
+	if (!rc)
+		mnt_table_invalidate_index(fs->tab);
+	return rc;
 }
 
 int __mnt_fs_set_target_ptr(struct libmnt_fs *fs, char *tgt)
 {
 	assert(fs);
 
-	free(fs->target);
+	free_fs_str(fs, fs->target);
 	fs->target = tgt;
+	mnt_table_invalidate_index(fs->tab);
 	return 0;
 }
 
@@ -832,7 +901,7 @@ int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
 	assert(fs);
 
 	if (fstype != fs->fstype)
-		free(fs->fstype);
+		free_fs_str(fs, fs->fstype);
 
 	fs->fstype = fstype;
 	fs->flags &= ~MNT_FS_PSEUDO;
@@ -1031,8 +1100,8 @@ int mnt_fs_set_options(struct libmnt_fs *fs, const char *optstr)
 		}
 	}
 
-	free(fs->fs_optstr);
-	free(fs->vfs_optstr);
+	free_fs_str(fs, fs->fs_optstr);
+	free_fs_str(fs, fs->vfs_optstr);
 	free(fs->user_optstr);
 	free(fs->optstr);
 
@@ -1074,6 +1143,10 @@ int mnt_fs_append_options(struct libmnt_fs *fs, const char *optstr)
 	if (rc)
 		return rc;
 
+	rc = mnt_fs_unshare_str(fs, &fs->vfs_optstr);
+	if (!rc)
+		rc = mnt_fs_unshare_str(fs, &fs->fs_optstr);
+
 	if (!rc && v)
 		rc = mnt_optstr_append_option(&fs->vfs_optstr, v, NULL);
 	if (!rc && f)
@@ -1121,6 +1194,10 @@ int mnt_fs_prepend_options(struct libmnt_fs *fs, const char *optstr)
 	if (rc)
 		return rc;
 
+	rc = mnt_fs_unshare_str(fs, &fs->vfs_optstr);
+	if (!rc)
+		rc = mnt_fs_unshare_str(fs, &fs->fs_optstr);
+
 	if (!rc && v)
 		rc = mnt_optstr_prepend_option(&fs->vfs_optstr, v, NULL);
 	if (!rc && f)
@@ -1372,7 +1449,15 @@ const char *mnt_fs_get_root(struct libmnt_fs *fs)
  */
 int mnt_fs_set_root(struct libmnt_fs *fs, const char *path)
 {
-	return strdup_to_struct_member(fs, root, path);
+	int rc;
+
+	if (!fs)
+		return -EINVAL;
+
+	rc = mnt_fs_unshare_str(fs, &fs->root);
+	if (!rc)
+		rc = strdup_to_struct_member(fs, root, path);
+	return rc;
 }
 
 /**
@@ -1530,6 +1615,7 @@ int mnt_fs_set_uniq_id(struct libmnt_fs *fs, uint64_t id)
 	if (!fs)
 		return -EINVAL;
 	fs->uniq_id = id;
+	mnt_table_invalidate_index(fs->tab);
 	return 0;
 }
 
@@ -1557,6 +1643,7 @@ int mnt_fs_fetch_ids(struct libmnt_fs *fs, int fd)
 
 	if (rc == 0 && uniq_id > 0) {
 		fs->uniq_id = uniq_id;
+		mnt_table_invalidate_index(fs->tab);
 		return 0;
 	}
 
@@ -1566,8 +1653,10 @@ int mnt_fs_fetch_ids(struct libmnt_fs *fs, int fd)
 	else
 		rc = mnt_id_from_path(mnt_fs_get_target(fs), NULL, &id);
 
-	if (rc == 0)
+	if (rc == 0) {
 		fs->id = id;
+		mnt_table_invalidate_index(fs->tab);
+	}
 
 	return rc;
 }
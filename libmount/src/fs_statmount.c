@@ -219,7 +219,8 @@ static int apply_vfs_optstr(struct libmnt_fs *fs, struct ul_statmount *sm)
 		return rc;
 	}
 
-	free(fs->vfs_optstr);
+	if (!mnt_arena_has_str(fs->arena, fs->vfs_optstr))
+		free(fs->vfs_optstr);
 	fs->vfs_optstr = str;
 	return 0;
 }
@@ -284,7 +285,8 @@ static int apply_fs_optstr(struct libmnt_fs *fs, struct ul_statmount *sm)
 		return rc;
 	}
 
-	free(fs->fs_optstr);
+	if (!mnt_arena_has_str(fs->arena, fs->fs_optstr))
+		free(fs->fs_optstr);
 	fs->fs_optstr = str;
 	return 0;
 }
@@ -332,6 +334,10 @@ static int apply_statmount(struct libmnt_fs *fs, struct ul_statmount *sm)
 	if (!rc && (sm->mask & STATMOUNT_SB_BASIC) && !fs->devno)
 		fs->devno = makedev(sm->sb_dev_major, sm->sb_dev_minor);
 
+	/* IDs and devno are used as keys in the table lookup index */
+	if (!rc && (sm->mask & (STATMOUNT_MNT_BASIC | STATMOUNT_SB_BASIC)))
+		mnt_table_invalidate_index(fs->tab);
+
 	if (!rc && (sm->mask & (STATMOUNT_SB_BASIC | STATMOUNT_MNT_OPTS))
 	    && !fs->fs_optstr) {
 		rc = apply_fs_optstr(fs, sm);
@@ -410,6 +416,7 @@ int mnt_fs_fetch_statmount(struct libmnt_fs *fs, uint64_t mask)
 		if (rc)
 			goto done;
 		DBG_OBJ(FS, fs, ul_debug(" uniq-ID=%" PRIu64, fs->uniq_id));
+		mnt_table_invalidate_index(fs->tab);
 	}
 
 	/* fetch all missing information by default */
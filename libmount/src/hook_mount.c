@@ -331,6 +331,7 @@ static int hook_create_mount(struct libmnt_context *cxt,
 			if (fs) {
 				fs->id = cxt->fs->id;
 				fs->uniq_id = cxt->fs->uniq_id;
+				mnt_table_invalidate_index(fs->tab);
 			}
 		}
 	}
@@ -112,6 +112,7 @@ extern int mnt_is_readonly(const char *path)
 			__attribute__((nonnull));
 
 extern int mnt_parse_offset(const char *str, size_t len, uintmax_t *res);
+extern uint32_t mnt_hash_path(const char *path);
 
 extern int mnt_chdir_to_parent(const char *target, char **filename);
 
@@ -169,6 +170,37 @@ extern int mnt_table_next_lsmnt(struct libmnt_table *tb, int direction);
 extern int mnt_table_reset_listmount(struct libmnt_table *tb);
 extern int mnt_table_want_listmount(struct libmnt_table *tb);
 
+/* tab_index.c */
+enum {
+	MNT_TABIDX_TARGET = 0,
+	MNT_TABIDX_SRCPATH,
+	MNT_TABIDX_DEVNO,
+	MNT_TABIDX_ID,
+	MNT_TABIDX_UNIQ_ID,
+	MNT_TABIDX_PARENT_ID,
+
+	MNT_TABIDX_NKEYS
+};
+
+struct mnt_tabidx_ent {
+	uint64_t	key;	/* value or hash */
+	size_t		pos;	/* position in the table */
+	struct libmnt_fs *fs;
+};
+
+extern void mnt_table_invalidate_index(struct libmnt_table *tb);
+extern void mnt_table_free_index(struct libmnt_table *tb);
+extern int mnt_table_index_lookup(struct libmnt_table *tb, int type, uint64_t key,
+				  struct mnt_tabidx_ent **res, size_t *nres);
+extern int mnt_table_index_ntags(struct libmnt_table *tb);
+
+/* returns @i-th index entry in @direction order */
+static inline struct libmnt_fs *mnt_tabidx_get_fs(struct mnt_tabidx_ent *ents,
+				size_t nents, size_t i, int direction)
+{
+	return ents[direction == MNT_ITER_FORWARD ? i : nents - 1 - i].fs;
+}
+
 /*
  * Generic iterator
  */
@@ -271,9 +303,25 @@ struct libmnt_fs {
 
 	char		*comment;	/* fstab comment */
 
+	struct libmnt_arena *arena;	/* shared strings (mountinfo parser) */
+
 	void		*userdata;	/* library independent data */
 };
 
+/*
+ * Reference counted buffer for strings shared between more filesystems
+ */
+struct libmnt_arena {
+	int		refcount;
+	size_t		size;		/* size of data[] */
+	char		data[];
+};
+
+static inline int mnt_arena_has_str(const struct libmnt_arena *ar, const char *str)
+{
+	return ar && str && str >= ar->data && str < ar->data + ar->size;
+}
+
 /*
  * fs flags
  */
@@ -341,6 +389,8 @@ struct libmnt_table {
 
 	struct list_head	ents;	/* list of entries (libmnt_fs) */
 	void		*userdata;
+
+	struct libmnt_tabidx	*idx;	/* lookup indexes (see tab_index.c) */
 };
 
 extern struct libmnt_table *__mnt_new_table_from_file(const char *filename, int fmt, int empty_for_enoent);
@@ -678,6 +728,11 @@ extern int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
 extern int __mnt_fs_set_target_ptr(struct libmnt_fs *fs, char *tgt)
 			__attribute__((nonnull(1)));
 
+extern void mnt_ref_arena(struct libmnt_arena *ar);
+extern void mnt_unref_arena(struct libmnt_arena *ar);
+extern int mnt_fs_unshare_str(struct libmnt_fs *fs, char **str)
+			__attribute__((nonnull(1, 2)));
+
 /* context.c */
 extern void mnt_context_syscall_save_status(struct libmnt_context *cxt,
                                         const char *syscallname, int success);
@@ -117,6 +117,7 @@ int mnt_reset_table(struct libmnt_table *tb)
 
 	tb->nents = 0;
 	mnt_table_reset_listmount(tb);
+	mnt_table_free_index(tb);
 
 	return 0;
 }
@@ -514,6 +515,7 @@ int mnt_table_add_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 	list_add_tail(&fs->ents, &tb->ents);
 	fs->tab = tb;
 	tb->nents++;
+	mnt_table_invalidate_index(tb);
 
 	DBG_OBJ(TAB, tb, ul_debug("add entry: %s %s",
 			mnt_fs_get_source(fs), mnt_fs_get_target(fs)));
@@ -536,6 +538,7 @@ static int __table_insert_fs(
 
 	fs->tab = tb;
 	tb->nents++;
+	mnt_table_invalidate_index(tb);
 
 	if (mnt_fs_get_uniq_id(fs)) {
 		DBG_OBJ(TAB, tb, ul_debug("insert entry: %" PRIu64, mnt_fs_get_uniq_id(fs)));
@@ -615,6 +618,7 @@ int mnt_table_move_fs(struct libmnt_table *src, struct libmnt_table *dst,
 	/* remove from source */
 	list_del_init(&fs->ents);
 	src->nents--;
+	mnt_table_invalidate_index(src);
 
 	/* insert to the destination */
 	return __table_insert_fs(dst, before, pos, fs);
@@ -642,6 +646,7 @@ int mnt_table_remove_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 
 	mnt_unref_fs(fs);
 	tb->nents--;
+	mnt_table_invalidate_index(tb);
 	return 0;
 }
 
@@ -649,8 +654,13 @@ static inline struct libmnt_fs *get_parent_fs(struct libmnt_table *tb, struct li
 {
 	struct libmnt_iter itr;
 	struct libmnt_fs *x;
+	struct mnt_tabidx_ent *ents;
+	size_t n;
 	int parent_id = mnt_fs_get_parent_id(fs);
 
+	if (mnt_table_index_lookup(tb, MNT_TABIDX_ID, (uint64_t) parent_id, &ents, &n) == 0)
+		return n ? ents[0].fs : NULL;
+
 	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
 	while (mnt_table_next_fs(tb, &itr, &x) == 0) {
 		if (mnt_fs_get_id(x) == parent_id)
@@ -716,6 +726,35 @@ int mnt_table_get_root_fs(struct libmnt_table *tb, struct libmnt_fs **root)
 	return root_fs ? 0 : -EINVAL;
 }
 
+/* update @chfs if @fs is a better candidate for the next child */
+static void next_child_candidate(struct libmnt_fs *fs, int parent_id,
+			int lastchld_id, int direction,
+			struct libmnt_fs **chfs, int *chld_id)
+{
+	int id = mnt_fs_get_id(fs);
+
+	/* avoid an infinite loop. This only happens in rare cases
+	 * such as in early userspace when the rootfs is its own parent */
+	if (id == parent_id)
+		return;
+
+	if (direction == MNT_ITER_FORWARD) {
+		/* return in the order of mounting */
+		if ((!lastchld_id || id > lastchld_id) &&
+		    (!*chfs || id < *chld_id)) {
+			*chfs = fs;
+			*chld_id = id;
+		}
+	} else {
+		/* return last child first */
+		if ((!lastchld_id || id < lastchld_id) &&
+		    (!*chfs || id > *chld_id)) {
+			*chfs = fs;
+			*chld_id = id;
+		}
+	}
+}
+
 /**
  * mnt_table_next_child_fs:
  * @tb: mountinfo file (/proc/self/mountinfo)
@@ -732,6 +771,8 @@ int mnt_table_next_child_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 			struct libmnt_fs *parent, struct libmnt_fs **chld)
 {
 	struct libmnt_fs *fs, *chfs = NULL;
+	struct mnt_tabidx_ent *ents;
+	size_t i, n;
 	int parent_id, lastchld_id = 0, chld_id = 0;
 	int direction;
 
@@ -751,33 +792,19 @@ int mnt_table_next_child_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 	}
 
 	mnt_reset_iter(itr, direction);
-	while (mnt_table_next_fs(tb, itr, &fs) == 0) {
-		int id;
-
-		if (mnt_fs_get_parent_id(fs) != parent_id)
-			continue;
 
-		id = mnt_fs_get_id(fs);
-
-		/* avoid an infinite loop. This only happens in rare cases
-		 * such as in early userspace when the rootfs is its own parent */
-		if (id == parent_id)
-			continue;
-
-		if (direction == MNT_ITER_FORWARD) {
-			/* return in the order of mounting */
-			if ((!lastchld_id || id > lastchld_id) &&
-			    (!chfs || id < chld_id)) {
-				chfs = fs;
-				chld_id = id;
-			}
-		} else {
-			/* return last child first */
-			if ((!lastchld_id || id < lastchld_id) &&
-			    (!chfs || id > chld_id)) {
-				chfs = fs;
-				chld_id = id;
-			}
+	if (mnt_table_index_lookup(tb, MNT_TABIDX_PARENT_ID,
+				(uint64_t) parent_id, &ents, &n) == 0) {
+		for (i = 0; i < n; i++)
+			next_child_candidate(mnt_tabidx_get_fs(ents, n, i, direction),
+					parent_id, lastchld_id, direction,
+					&chfs, &chld_id);
+	} else {
+		while (mnt_table_next_fs(tb, itr, &fs) == 0) {
+			if (mnt_fs_get_parent_id(fs) != parent_id)
+				continue;
+			next_child_candidate(fs, parent_id, lastchld_id,
+					direction, &chfs, &chld_id);
 		}
 	}
 
@@ -822,6 +849,8 @@ int mnt_table_over_fs(struct libmnt_table *tb, struct libmnt_fs *parent,
 {
 	struct libmnt_iter itr;
 	struct libmnt_fs *fs = NULL;
+	struct mnt_tabidx_ent *ents;
+	size_t i, n;
 	int id;
 	const char *tgt;
 
@@ -835,6 +864,18 @@ int mnt_table_over_fs(struct libmnt_table *tb, struct libmnt_fs *parent,
 	id = mnt_fs_get_id(parent);
 	tgt = mnt_fs_get_target(parent);
 
+	if (mnt_table_index_lookup(tb, MNT_TABIDX_PARENT_ID,
+				(uint64_t) id, &ents, &n) == 0) {
+		for (i = 0; i < n; i++) {
+			if (mnt_fs_streq_target(ents[i].fs, tgt) == 1) {
+				if (child)
+					*child = ents[i].fs;
+				return 0;
+			}
+		}
+		return 1;
+	}
+
 	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
 		if (mnt_fs_get_parent_id(fs) == id &&
 		    mnt_fs_streq_target(fs, tgt) == 1) {
@@ -995,6 +1036,7 @@ static int mnt_table_move_parent(struct libmnt_table *tb, int oldid, int newid)
 		return 0;
 
 	DBG_OBJ(TAB, tb, ul_debug("moving parent ID from %d -> %d", oldid, newid));
+	mnt_table_invalidate_index(tb);
 	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
 
 	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
@@ -1145,6 +1187,33 @@ struct libmnt_fs *mnt_table_find_mountpoint(struct libmnt_table *tb,
 	return mnt_table_find_target(tb, "/", direction);
 }
 
+/* returns the first entry (in @direction) with unmodified target @path */
+static struct libmnt_fs *find_target_native(struct libmnt_table *tb,
+				const char *path, int direction)
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs = NULL;
+	struct mnt_tabidx_ent *ents;
+	size_t i, n;
+
+	if (mnt_table_index_lookup(tb, MNT_TABIDX_TARGET,
+				mnt_hash_path(path), &ents, &n) == 0) {
+		for (i = 0; i < n; i++) {
+			fs = mnt_tabidx_get_fs(ents, n, i, direction);
+			if (mnt_fs_streq_target(fs, path))
+				return fs;
+		}
+		return NULL;
+	}
+
+	mnt_reset_iter(&itr, direction);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		if (mnt_fs_streq_target(fs, path))
+			return fs;
+	}
+	return NULL;
+}
+
 /**
  * mnt_table_find_target:
  * @tb: tab pointer
@@ -1174,23 +1243,17 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	DBG_OBJ(TAB, tb, ul_debug("lookup TARGET: '%s'", path));
 
 	/* native @target */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_target(fs, path))
-			return fs;
-	}
+	fs = find_target_native(tb, path, direction);
+	if (fs)
+		return fs;
 
 	/* try absolute path */
 	if (ul_is_relative_path(path) && (cn = ul_absolute_path(path))) {
 		DBG_OBJ(TAB, tb, ul_debug("lookup absolute TARGET: '%s'", cn));
-		mnt_reset_iter(&itr, direction);
-		while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
-			if (mnt_fs_streq_target(fs, cn)) {
-				free(cn);
-				return fs;
-			}
-		}
+		fs = find_target_native(tb, cn, direction);
 		free(cn);
+		if (fs)
+			return fs;
 	}
 
 	if (!tb->cache || !(cn = mnt_resolve_path(path, tb->cache)))
@@ -1199,11 +1262,9 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	DBG_OBJ(TAB, tb, ul_debug("lookup canonical TARGET: '%s'", cn));
 
 	/* canonicalized paths in struct libmnt_table */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_target(fs, cn))
-			return fs;
-	}
+	fs = find_target_native(tb, cn, direction);
+	if (fs)
+		return fs;
 
 	/* non-canonical path in struct libmnt_table
 	 * -- note that mountpoint in /proc/self/mountinfo is already
@@ -1227,6 +1288,80 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	return NULL;
 }
 
+/* returns 1 if @fs is not btrfs or it is the default btrfs subvolume */
+static int is_default_subvol(struct libmnt_table *tb __attribute__((__unused__)),
+			     struct libmnt_fs *fs __attribute__((__unused__)))
+{
+#ifdef HAVE_BTRFS_SUPPORT
+	if (fs->fstype && !strcmp(fs->fstype, "btrfs")) {
+		uint64_t default_id = btrfs_get_default_subvol_id(mnt_fs_get_target(fs));
+		char *val;
+		size_t len;
+
+		if (default_id == UINT64_MAX)
+			DBG(TAB, ul_debug("not found btrfs volume setting"));
+
+		else if (mnt_fs_get_option(fs, "subvolid", &val, &len) == 0) {
+			uint64_t subvol_id;
+
+			if (mnt_parse_offset(val, len, &subvol_id)) {
+				DBG_OBJ(TAB, tb, ul_debug("failed to parse subvolid="));
+				return 0;
+			}
+			if (subvol_id != default_id)
+				return 0;
+		}
+	}
+#endif /* HAVE_BTRFS_SUPPORT */
+	return 1;
+}
+
+/*
+ * Returns the first entry (in @direction) with unmodified source @path. The
+ * btrfs entries are checked for the default subvolume if @subvol is true. If
+ * @ntags is not NULL, then it returns number of the entries with tag source
+ * (if nothing is found).
+ */
+static struct libmnt_fs *find_srcpath_native(struct libmnt_table *tb,
+				const char *path, int direction,
+				int subvol, int *ntags)
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs = NULL;
+	struct mnt_tabidx_ent *ents;
+	size_t i, n;
+	int indexed, nt = 0;
+
+	indexed = mnt_table_index_lookup(tb, MNT_TABIDX_SRCPATH,
+				mnt_hash_path(path), &ents, &n) == 0;
+	if (indexed) {
+		for (i = 0; i < n; i++) {
+			fs = mnt_tabidx_get_fs(ents, n, i, direction);
+			if (mnt_fs_streq_srcpath(fs, path)
+			    && (!subvol || is_default_subvol(tb, fs)))
+				return fs;
+		}
+		if (!ntags)
+			return NULL;
+		*ntags = mnt_table_index_ntags(tb);
+		if (*ntags >= 0)
+			return NULL;
+	}
+
+	/* not indexed (or the index is unavailable for tags count) */
+	mnt_reset_iter(&itr, direction);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		if (!indexed && mnt_fs_streq_srcpath(fs, path)
+		    && (!subvol || is_default_subvol(tb, fs)))
+			return fs;
+		if (mnt_fs_get_tag(fs, NULL, NULL) == 0)
+			nt++;
+	}
+	if (ntags)
+		*ntags = nt;
+	return NULL;
+}
+
 /**
  * mnt_table_find_srcpath:
  * @tb: tab pointer
@@ -1263,37 +1398,9 @@ struct libmnt_fs *mnt_table_find_srcpath(struct libmnt_table *tb, const char *pa
 	DBG_OBJ(TAB, tb, ul_debug("lookup SRCPATH: '%s'", path));
 
 	/* native paths */
-	mnt_reset_iter(&itr, direction);
-
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-
-		if (mnt_fs_streq_srcpath(fs, path)) {
-#ifdef HAVE_BTRFS_SUPPORT
-			if (fs->fstype && !strcmp(fs->fstype, "btrfs")) {
-				uint64_t default_id = btrfs_get_default_subvol_id(mnt_fs_get_target(fs));
-				char *val;
-				size_t len;
-
-				if (default_id == UINT64_MAX)
-					DBG(TAB, ul_debug("not found btrfs volume setting"));
-
-				else if (mnt_fs_get_option(fs, "subvolid", &val, &len) == 0) {
-					uint64_t subvol_id;
-
-					if (mnt_parse_offset(val, len, &subvol_id)) {
-						DBG_OBJ(TAB, tb, ul_debug("failed to parse subvolid="));
-						continue;
-					}
-					if (subvol_id != default_id)
-						continue;
-				}
-			}
-#endif /* HAVE_BTRFS_SUPPORT */
-			return fs;
-		}
-		if (mnt_fs_get_tag(fs, NULL, NULL) == 0)
-			ntags++;
-	}
+	fs = find_srcpath_native(tb, path, direction, 1, &ntags);
+	if (fs)
+		return fs;
 
 	if (!path || !tb->cache || !(cn = mnt_resolve_path(path, tb->cache)))
 		return NULL;
@@ -1304,11 +1411,9 @@ struct libmnt_fs *mnt_table_find_srcpath(struct libmnt_table *tb, const char *pa
 
 	/* canonicalized paths in struct libmnt_table */
 	if (ntags < nents) {
-		mnt_reset_iter(&itr, direction);
-		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-			if (mnt_fs_streq_srcpath(fs, cn))
-				return fs;
-		}
+		fs = find_srcpath_native(tb, cn, direction, 0, NULL);
+		if (fs)
+			return fs;
 	}
 
 	/* evaluated tag */
@@ -1543,6 +1648,8 @@ struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 {
 	struct libmnt_fs *fs = NULL;
 	struct libmnt_iter itr;
+	struct mnt_tabidx_ent *ents;
+	size_t n;
 
 	if (!tb)
 		return NULL;
@@ -1551,6 +1658,9 @@ struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 
 	DBG_OBJ(TAB, tb, ul_debug("lookup DEVNO: %d", (int) devno));
 
+	if (mnt_table_index_lookup(tb, MNT_TABIDX_DEVNO, devno, &ents, &n) == 0)
+		return n ? mnt_tabidx_get_fs(ents, n, 0, direction) : NULL;
+
 	mnt_reset_iter(&itr, direction);
 
 	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
@@ -1576,11 +1686,17 @@ struct libmnt_fs *mnt_table_find_id(struct libmnt_table *tb, int id)
 {
 	struct libmnt_fs *fs = NULL;
 	struct libmnt_iter itr;
+	struct mnt_tabidx_ent *ents;
+	size_t n;
 
 	if (!tb)
 		return NULL;
 
 	DBG_OBJ(TAB, tb, ul_debug("lookup ID: %d", id));
+
+	if (mnt_table_index_lookup(tb, MNT_TABIDX_ID, (uint64_t) id, &ents, &n) == 0)
+		return n ? ents[n - 1].fs : NULL;
+
 	mnt_reset_iter(&itr, MNT_ITER_BACKWARD);
 
 	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
@@ -1606,11 +1722,17 @@ struct libmnt_fs *mnt_table_find_uniq_id(struct libmnt_table *tb, uint64_t id)
 {
 	struct libmnt_fs *fs = NULL;
 	struct libmnt_iter itr;
+	struct mnt_tabidx_ent *ents;
+	size_t n;
 
 	if (!tb)
 		return NULL;
 
 	DBG_OBJ(TAB, tb, ul_debug("lookup uniq-ID: %" PRIu64, id));
+
+	if (mnt_table_index_lookup(tb, MNT_TABIDX_UNIQ_ID, id, &ents, &n) == 0)
+		return n ? ents[n - 1].fs : NULL;
+
 	mnt_reset_iter(&itr, MNT_ITER_BACKWARD);
 
 	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
@@ -16,6 +16,7 @@
  * @short_description: compare changes in the list of the mounted filesystems
  */
 #include "mountP.h"
+#include "strutils.h"
 
 struct tabdiff_entry {
 	int	oper;			/* MNT_TABDIFF_* flags; */
@@ -187,22 +188,82 @@ static int tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
 	return 0;
 }
 
-static struct tabdiff_entry *tabdiff_get_mount(struct libmnt_tabdiff *df,
-					       const char *src,
-					       int id)
+/*
+ * Newly mounted entries sorted by mount ID, used to detect moved filesystems
+ * without rescanning the list of changes for every umounted entry.
+ */
+struct tabdiff_mount {
+	int			id;
+	size_t			seq;	/* order in the list of changes */
+	struct tabdiff_entry	*de;
+};
+
+static int cmp_mounts(const void *a, const void *b)
 {
+	const struct tabdiff_mount *x = a, *y = b;
+
+	if (x->id != y->id)
+		return x->id < y->id ? -1 : 1;
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static int tabdiff_sort_mounts(struct libmnt_tabdiff *df,
+			       struct tabdiff_mount **res, size_t *nmounts)
+{
+	struct tabdiff_mount *mounts;
 	struct list_head *p;
+	size_t n = 0;
 
 	assert(df);
 
+	*res = NULL;
+	*nmounts = 0;
+	if (!df->nchanges)
+		return 0;
+
+	mounts = malloc(df->nchanges * sizeof(*mounts));
+	if (!mounts)
+		return -ENOMEM;
+
 	list_for_each(p, &df->changes) {
 		struct tabdiff_entry *de;
 
 		de = list_entry(p, struct tabdiff_entry, changes);
+		if (de->oper != MNT_TABDIFF_MOUNT || !de->new_fs)
+			continue;
+		mounts[n].id = mnt_fs_get_id(de->new_fs);
+		mounts[n].seq = n;
+		mounts[n].de = de;
+		n++;
+	}
+
+	qsort(mounts, n, sizeof(*mounts), cmp_mounts);
+	*res = mounts;
+	*nmounts = n;
+	return 0;
+}
+
+/* returns the first (in the order of changes) newly mounted entry with @id and @src */
+static struct tabdiff_entry *tabdiff_get_mount(struct tabdiff_mount *mounts,
+					       size_t nmounts,
+					       const char *src,
+					       int id)
+{
+	size_t lo = 0, hi = nmounts;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
 
-		if (de->oper == MNT_TABDIFF_MOUNT && de->new_fs &&
-		    mnt_fs_get_id(de->new_fs) == id) {
+		if (mounts[mid].id < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < nmounts && mounts[lo].id == id; lo++) {
+		struct tabdiff_entry *de = mounts[lo].de;
 
+		if (de->oper == MNT_TABDIFF_MOUNT) {
 			const char *s = mnt_fs_get_source(de->new_fs);
 
 			if (s == NULL && src == NULL)
@@ -214,6 +275,77 @@ static struct tabdiff_entry *tabdiff_get_mount(struct libmnt_tabdiff *df,
 	return NULL;
 }
 
+/*
+ * Returns 1 if mnt_fs_match_target() canonicalizes the targets of the @tb
+ * entries, it's the case for non-kernel tables with cache.
+ */
+static int need_target_scan(struct libmnt_table *tb)
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+
+	if (!tb->cache)
+		return 0;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		if (!mnt_fs_is_kernel(fs) && !mnt_fs_is_swaparea(fs))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * The same as mnt_table_find_pair(tb, src, tgt, MNT_ITER_FORWARD), but the
+ * candidates are looked up by the target index rather than by evaluating all
+ * the table entries. If the table cache is set, the entries with the
+ * canonicalized @tgt are candidates too, and the first matching entry in the
+ * table order is returned. The full scan is used if @scan is set (see
+ * need_target_scan()).
+ */
+static struct libmnt_fs *find_pair(struct libmnt_table *tb,
+				   const char *src, const char *tgt, int scan)
+{
+	struct libmnt_fs *res = NULL;
+	const char *paths[2] = { tgt, NULL };
+	size_t i, k, respos = 0;
+
+	if (!tgt || !*tgt || !src || !*src)
+		return NULL;
+	if (scan)
+		return mnt_table_find_pair(tb, src, tgt, MNT_ITER_FORWARD);
+
+	if (tb->cache) {
+		const char *cn = mnt_resolve_target(tgt, tb->cache);
+
+		if (cn && !streq_paths(cn, tgt))
+			paths[1] = cn;
+	}
+
+	for (k = 0; k < ARRAY_SIZE(paths) && paths[k]; k++) {
+		struct mnt_tabidx_ent *ents;
+		size_t n;
+
+		if (mnt_table_index_lookup(tb, MNT_TABIDX_TARGET,
+					mnt_hash_path(paths[k]), &ents, &n) != 0)
+			return mnt_table_find_pair(tb, src, tgt, MNT_ITER_FORWARD);
+
+		/* the entries are in the table order */
+		for (i = 0; i < n; i++) {
+			if (res && ents[i].pos >= respos)
+				break;
+			if (mnt_fs_match_target(ents[i].fs, tgt, tb->cache) &&
+			    mnt_fs_match_source(ents[i].fs, src, tb->cache)) {
+				res = ents[i].fs;
+				respos = ents[i].pos;
+				break;
+			}
+		}
+	}
+
+	return res;
+}
+
 /**
  * mnt_diff_tables:
  * @df: diff handler
@@ -230,7 +362,9 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 {
 	struct libmnt_fs *fs;
 	struct libmnt_iter itr;
-	int no, nn;
+	struct tabdiff_mount *mounts = NULL;
+	size_t nmounts = 0;
+	int no, nn, old_scan, new_scan;
 
 	if (!df || !old_tab || !new_tab)
 		return -EINVAL;
@@ -261,13 +395,16 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 		goto done;
 	}
 
+	old_scan = need_target_scan(old_tab);
+	new_scan = need_target_scan(new_tab);
+
 	/* search newly mounted or modified */
 	while(mnt_table_next_fs(new_tab, &itr, &fs) == 0) {
 		struct libmnt_fs *o_fs;
 		const char *src = mnt_fs_get_source(fs),
 			   *tgt = mnt_fs_get_target(fs);
 
-		o_fs = mnt_table_find_pair(old_tab, src, tgt, MNT_ITER_FORWARD);
+		o_fs = find_pair(old_tab, src, tgt, old_scan);
 		if (!o_fs)
 			/* 'fs' is not in the old table -- so newly mounted */
 			tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
@@ -284,15 +421,18 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 	}
 
 	/* search umounted or moved */
+	if (tabdiff_sort_mounts(df, &mounts, &nmounts) != 0)
+		return -ENOMEM;
+
 	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
 	while(mnt_table_next_fs(old_tab, &itr, &fs) == 0) {
 		const char *src = mnt_fs_get_source(fs),
 			   *tgt = mnt_fs_get_target(fs);
 
-		if (!mnt_table_find_pair(new_tab, src, tgt, MNT_ITER_FORWARD)) {
+		if (!find_pair(new_tab, src, tgt, new_scan)) {
 			struct tabdiff_entry *de;
 
-			de = tabdiff_get_mount(df, src,	mnt_fs_get_id(fs));
+			de = tabdiff_get_mount(mounts, nmounts, src, mnt_fs_get_id(fs));
 			if (de) {
 				mnt_ref_fs(fs);
 				mnt_unref_fs(de->old_fs);
@@ -302,38 +442,191 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 				tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
 		}
 	}
+	free(mounts);
 done:
 	DBG_OBJ(DIFF, df, ul_debug("%d changes detected", df->nchanges));
 	return df->nchanges;
 }
 
-#ifdef TEST_PROGRAM
+/* returns a new entry for mount node @id or NULL (errno set) */
+static struct libmnt_fs *fetch_fs(struct libmnt_table *tb, struct libmnt_fs *old,
+				  uint64_t id)
+{
+	struct libmnt_fs *fs = mnt_new_fs();
+	struct libmnt_fs *first = NULL;
+	int rc;
 
-static int test_diff(struct libmnt_test *ts __attribute__((unused)),
-		     int argc, char *argv[])
+	if (!fs)
+		return NULL;
+
+	mnt_fs_set_uniq_id(fs, id);
+
+	/* keep the namespace of the table */
+	if (!old)
+		mnt_table_first_fs(tb, &first);
+	if (old && old->ns_id)
+		mnt_fs_set_ns(fs, old->ns_id);
+	else if (first && first->ns_id)
+		mnt_fs_set_ns(fs, first->ns_id);
+
+	/* read everything now, the node may be gone before the next
+	 * on-demand statmount() call */
+	rc = mnt_fs_fetch_statmount(fs, 0);
+	if (rc) {
+		mnt_unref_fs(fs);
+		errno = -rc;
+		return NULL;
+	}
+	return fs;
+}
+
+/* adds @fs to @tb, the table is sorted by unique IDs (as returned by listmount) */
+static int insert_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 {
-	struct libmnt_table *tb_old, *tb_new;
-	struct libmnt_tabdiff *diff;
-	struct libmnt_iter *itr;
-	struct libmnt_fs *old, *new;
-	int rc = -1, change;
+	struct list_head *p;
 
-	if (argc != 3)
-		return -1;
+	for (p = tb->ents.prev; p != &tb->ents; p = p->prev) {
+		struct libmnt_fs *x = list_entry(p, struct libmnt_fs, ents);
 
-	tb_old = mnt_new_table_from_file(argv[1]);
-	tb_new = mnt_new_table_from_file(argv[2]);
-	diff = mnt_new_tabdiff();
-	itr = mnt_new_iter(MNT_ITER_FORWARD);
+		if (x->uniq_id < fs->uniq_id)
+			return mnt_table_insert_fs(tb, 0, x, fs);
+	}
+	return mnt_table_insert_fs(tb, 1, NULL, fs);
+}
 
-	if (!tb_old || !tb_new || !diff || !itr) {
-		warnx("failed to allocate resources");
-		goto done;
+/*
+ * Replaces @old by @new in @tb (either of them may be NULL) and records the
+ * change in @df.
+ */
+static int apply_event(struct libmnt_tabdiff *df, struct libmnt_table *tb,
+		       struct libmnt_fs *old, struct libmnt_fs *new)
+{
+	int rc = 0;
+
+	if (new && old) {
+		const char *t1 = mnt_fs_get_target(old),
+			   *t2 = mnt_fs_get_target(new),
+			   *v1 = mnt_fs_get_vfs_options(old),
+			   *v2 = mnt_fs_get_vfs_options(new),
+			   *f1 = mnt_fs_get_fs_options(old),
+			   *f2 = mnt_fs_get_fs_options(new);
+		int oper = 0;
+
+		if (t1 && t2 && !streq_paths(t1, t2))
+			oper = MNT_TABDIFF_MOVE;
+		else if ((v1 && v2 && strcmp(v1, v2) != 0) || (f1 && f2 && strcmp(f1, f2) != 0))
+			oper = MNT_TABDIFF_REMOUNT;
+
+		/* replace in place, the diff keeps the old entry */
+		mnt_ref_fs(old);
+		rc = mnt_table_insert_fs(tb, 1, old, new);
+		if (!rc)
+			rc = mnt_table_remove_fs(tb, old);
+		if (!rc && oper)
+			rc = tabdiff_add_entry(df, old, new, oper);
+		mnt_unref_fs(old);
+
+	} else if (new) {
+		rc = insert_fs(tb, new);
+		if (!rc)
+			rc = tabdiff_add_entry(df, NULL, new, MNT_TABDIFF_MOUNT);
+
+	} else if (old) {
+		/* detached, or gone before we had a chance to read it */
+		mnt_ref_fs(old);
+		rc = mnt_table_remove_fs(tb, old);
+		if (!rc)
+			rc = tabdiff_add_entry(df, old, NULL, MNT_TABDIFF_UMOUNT);
+		mnt_unref_fs(old);
 	}
 
-	rc = mnt_diff_tables(diff, tb_old, tb_new);
-	if (rc < 0)
-		goto done;
+	return rc;
+}
+
+static int diff_event(struct libmnt_tabdiff *df, struct libmnt_table *tb,
+		      struct libmnt_fs *ev)
+{
+	struct libmnt_fs *old, *new = NULL;
+	uint64_t id = mnt_fs_get_uniq_id(ev);
+	int rc;
+
+	old = mnt_table_find_uniq_id(tb, id);
+
+	if (!mnt_fs_is_detached(ev)) {
+		/* attached or moved */
+		new = fetch_fs(tb, old, id);
+		if (!new && errno != ENOENT)
+			return -errno;
+	}
+
+	rc = apply_event(df, tb, old, new);
+	mnt_unref_fs(new);
+	return rc;
+}
+
+/**
+ * mnt_diff_monitor:
+ * @df: diff handler
+ * @tb: kernel mount table
+ * @mn: monitor
+ *
+ * Applies the pending mount node events from @mn to @tb and stores the
+ * changes in @df. Only the affected entries are read by statmount(), the rest
+ * of the table is not touched. It's usable after mnt_monitor_next_change()
+ * returned MNT_MONITOR_TYPE_FANOTIFY, see mnt_monitor_event_next_fs().
+ *
+ * The entries in @tb are matched by unique mount IDs, so the table should
+ * be read by listmount() (see mnt_table_fetch_listmount()). New entries are
+ * added in the unique ID order.
+ *
+ * The events do not describe the change, so the old entry is replaced by a
+ * freshly read one for every attach or move event. The MNT_TABDIFF_MOVE and
+ * MNT_TABDIFF_REMOUNT changes are reported only if the mountpoint or the
+ * mount options differ.
+ *
+ * If the monitor returns -EOVERFLOW, the changes applied so far remain in
+ * @tb and @df, but the caller has to read the whole table again.
+ *
+ * Returns: number of changes, negative number in case of error.
+ *
+ * Since: 2.44
+ */
+int mnt_diff_monitor(struct libmnt_tabdiff *df, struct libmnt_table *tb,
+		     struct libmnt_monitor *mn)
+{
+	struct libmnt_fs *ev;
+	int rc;
+
+	if (!df || !tb || !mn)
+		return -EINVAL;
+
+	tabdiff_reset(df);
+
+	ev = mnt_new_fs();
+	if (!ev)
+		return -ENOMEM;
+
+	do {
+		mnt_reset_fs(ev);
+		rc = mnt_monitor_event_next_fs(mn, ev);
+		if (rc == 0)
+			rc = diff_event(df, tb, ev);
+	} while (rc == 0);
+
+	mnt_unref_fs(ev);
+
+	DBG_OBJ(DIFF, df, ul_debug("%d changes applied [rc=%d]", df->nchanges, rc));
+	return rc < 0 ? rc : df->nchanges;
+}
+
+#ifdef TEST_PROGRAM
+
+static void print_changes(struct libmnt_tabdiff *diff, struct libmnt_iter *itr)
+{
+	struct libmnt_fs *old, *new;
+	int change;
+
+	mnt_reset_iter(itr, MNT_ITER_FORWARD);
 
 	while(mnt_tabdiff_next_change(diff, itr, &old, &new, &change) == 0) {
 
@@ -359,12 +652,165 @@ static int test_diff(struct libmnt_test *ts __attribute__((unused)),
 			printf("unknown change!\n");
 		}
 	}
+}
+
+static int diff_files(const char *oldfile, const char *newfile, int use_cache)
+{
+	struct libmnt_table *tb_old, *tb_new;
+	struct libmnt_tabdiff *diff;
+	struct libmnt_iter *itr;
+	struct libmnt_cache *cache = NULL;
+	int rc = -1;
+
+	tb_old = mnt_new_table_from_file(oldfile);
+	tb_new = mnt_new_table_from_file(newfile);
+	diff = mnt_new_tabdiff();
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+	if (use_cache)
+		cache = mnt_new_cache();
+
+	if (!tb_old || !tb_new || !diff || !itr || (use_cache && !cache)) {
+		warnx("failed to allocate resources");
+		goto done;
+	}
+	if (cache) {
+		mnt_table_set_cache(tb_old, cache);
+		mnt_table_set_cache(tb_new, cache);
+	}
 
+	rc = mnt_diff_tables(diff, tb_old, tb_new);
+	if (rc < 0)
+		goto done;
+
+	print_changes(diff, itr);
 	rc = 0;
 done:
 	mnt_unref_table(tb_old);
 	mnt_unref_table(tb_new);
+	mnt_unref_cache(cache);
+	mnt_free_tabdiff(diff);
+	mnt_free_iter(itr);
+	return rc;
+}
+
+static int test_diff(struct libmnt_test *ts __attribute__((unused)),
+		     int argc, char *argv[])
+{
+	if (argc != 3)
+		return -1;
+	return diff_files(argv[1], argv[2], 0);
+}
+
+static int test_diff_cache(struct libmnt_test *ts __attribute__((unused)),
+			   int argc, char *argv[])
+{
+	if (argc != 3)
+		return -1;
+	return diff_files(argv[1], argv[2], 1);
+}
+
+/* mountinfo files have no unique IDs, use the old mount IDs */
+static struct libmnt_table *read_table_with_ids(const char *filename)
+{
+	struct libmnt_table *tb = mnt_new_table_from_file(filename);
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+
+	if (!tb)
+		return NULL;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0)
+		mnt_fs_set_uniq_id(fs, mnt_fs_get_id(fs));
+	return tb;
+}
+
+static int streq_opts(const char *a, const char *b)
+{
+	return strcmp(a ? a : "", b ? b : "") == 0;
+}
+
+static int is_same_fs(struct libmnt_fs *a, struct libmnt_fs *b)
+{
+	return streq_paths(mnt_fs_get_target(a), mnt_fs_get_target(b))
+	       && streq_opts(mnt_fs_get_vfs_options(a), mnt_fs_get_vfs_options(b))
+	       && streq_opts(mnt_fs_get_fs_options(a), mnt_fs_get_fs_options(b));
+}
+
+/*
+ * Converts the difference between <old> and <new> to synthetic attach, detach
+ * and move events, applies them to <old> in the mount ID order, and compares
+ * the result with <new> read again.
+ */
+static int test_diff_events(struct libmnt_test *ts __attribute__((unused)),
+			    int argc, char *argv[])
+{
+	struct libmnt_table *tb = NULL, *tb_new = NULL, *tb_re = NULL;
+	struct libmnt_tabdiff *diff = NULL, *rediff = NULL;
+	struct libmnt_iter *itr = NULL;
+	struct libmnt_fs *fs, *old;
+	int rc = -1, id, maxid = 0;
+
+	if (argc != 3)
+		return -1;
+
+	tb = read_table_with_ids(argv[1]);
+	tb_new = read_table_with_ids(argv[2]);
+	tb_re = mnt_new_table_from_file(argv[2]);
+	diff = mnt_new_tabdiff();
+	rediff = mnt_new_tabdiff();
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+
+	if (!tb || !tb_new || !tb_re || !diff || !rediff || !itr) {
+		warnx("failed to allocate resources");
+		goto done;
+	}
+
+	while (mnt_table_next_fs(tb, itr, &fs) == 0)
+		maxid = max(maxid, mnt_fs_get_id(fs));
+	mnt_reset_iter(itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb_new, itr, &fs) == 0)
+		maxid = max(maxid, mnt_fs_get_id(fs));
+
+	for (id = 0; id <= maxid; id++) {
+		struct libmnt_fs *new = mnt_table_find_uniq_id(tb_new, id);
+
+		old = mnt_table_find_uniq_id(tb, id);
+		if (!old && !new)
+			continue;
+		if (old && new && is_same_fs(old, new))
+			continue;	/* no event */
+
+		if (new) {
+			/* attached or moved; the entry as read by statmount() */
+			new = mnt_copy_fs(NULL, new);
+			if (!new)
+				goto done;
+		}
+		rc = apply_event(diff, tb, old, new);
+		mnt_unref_fs(new);
+		if (rc)
+			goto done;
+	}
+
+	print_changes(diff, itr);
+
+	rc = mnt_diff_tables(rediff, tb, tb_re);
+	if (rc < 0)
+		goto done;
+	if (rc == 0 && mnt_table_get_nents(tb) == mnt_table_get_nents(tb_re))
+		printf("table is up to date\n");
+	else {
+		printf("table differs:\n");
+		print_changes(rediff, itr);
+	}
+	rc = 0;
+done:
+	mnt_unref_table(tb);
+	mnt_unref_table(tb_new);
+	mnt_unref_table(tb_re);
 	mnt_free_tabdiff(diff);
+	mnt_free_tabdiff(rediff);
 	mnt_free_iter(itr);
 	return rc;
 }
@@ -373,6 +819,8 @@ int main(int argc, char *argv[])
 {
 	struct libmnt_test tss[] = {
 		{ "--diff", test_diff, "<old> <new> prints change" },
+		{ "--diff-cache", test_diff_cache, "<old> <new> prints change, paths canonicalized" },
+		{ "--diff-events", test_diff_events, "<old> <new> applies changes as mount events" },
 		{ NULL }
 	};
 
@@ -0,0 +1,215 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * This file is part of libmount from util-linux project.
+ *
+ * libmount is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Lookup indexes for struct libmnt_table.
+ *
+ * The mnt_table_find_*() functions are linear scans, which makes tools like
+ * findmnt --submounts or umount --recursive quadratic on systems with many
+ * mountpoints. The index is a sorted array of (key, position) pairs for each
+ * key type, built on demand by the first lookup and dropped by any table or
+ * relevant entry modification. The position keeps the table order, so
+ * callers can still return the first (or last) match as the list walk does.
+ *
+ * String keys (target, source path) are hashes only; callers have to verify
+ * the candidates by the original compare function.
+ */
+#include "mountP.h"
+
+struct libmnt_tabidx {
+	struct mnt_tabidx_ent	*ents[MNT_TABIDX_NKEYS];
+	size_t			nents[MNT_TABIDX_NKEYS];
+	int			ntags;		/* entries with LABEL=/UUID= source */
+
+	unsigned int		valid;		/* MNT_TABIDX_* bitmask */
+};
+
+void mnt_table_invalidate_index(struct libmnt_table *tb)
+{
+	if (tb && tb->idx && tb->idx->valid) {
+		DBG_OBJ(TAB, tb, ul_debug("invalidate index"));
+		tb->idx->valid = 0;
+	}
+}
+
+void mnt_table_free_index(struct libmnt_table *tb)
+{
+	size_t i;
+
+	if (!tb || !tb->idx)
+		return;
+	for (i = 0; i < MNT_TABIDX_NKEYS; i++)
+		free(tb->idx->ents[i]);
+	free(tb->idx);
+	tb->idx = NULL;
+}
+
+static int cmp_ents(const void *a, const void *b)
+{
+	const struct mnt_tabidx_ent *x = a, *y = b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+	return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+/* returns 0 and the key for @fs, or 1 if @fs is not indexed */
+static int get_key(struct libmnt_fs *fs, int type, uint64_t *key)
+{
+	const char *p;
+
+	switch (type) {
+	case MNT_TABIDX_TARGET:
+		p = mnt_fs_get_target(fs);
+		if (!p)
+			return 1;
+		*key = mnt_hash_path(p);
+		break;
+	case MNT_TABIDX_SRCPATH:
+		p = mnt_fs_get_srcpath(fs);
+		if (!p)
+			return 1;
+		*key = mnt_hash_path(p);
+		break;
+	case MNT_TABIDX_DEVNO:
+		*key = mnt_fs_get_devno(fs);
+		break;
+	case MNT_TABIDX_ID:
+		*key = (uint64_t) mnt_fs_get_id(fs);
+		break;
+	case MNT_TABIDX_UNIQ_ID:
+		*key = mnt_fs_get_uniq_id(fs);
+		break;
+	case MNT_TABIDX_PARENT_ID:
+		*key = (uint64_t) mnt_fs_get_parent_id(fs);
+		break;
+	default:
+		return 1;
+	}
+	return 0;
+}
+
+static int build_index(struct libmnt_table *tb, int type)
+{
+	struct libmnt_tabidx *idx = tb->idx;
+	struct mnt_tabidx_ent *ents = NULL;
+	struct list_head *p;
+	size_t n = 0, pos = 0;
+	int ntags = 0;
+
+	if (!idx) {
+		idx = tb->idx = calloc(1, sizeof(*idx));
+		if (!idx)
+			return -ENOMEM;
+	}
+
+	if (tb->nents > 0) {
+		ents = malloc((size_t) tb->nents * sizeof(*ents));
+		if (!ents)
+			return -ENOMEM;
+	}
+
+	list_for_each(p, &tb->ents) {
+		struct libmnt_fs *fs = list_entry(p, struct libmnt_fs, ents);
+		uint64_t key;
+
+		pos++;
+		if (type == MNT_TABIDX_SRCPATH
+		    && mnt_fs_get_tag(fs, NULL, NULL) == 0)
+			ntags++;
+		if (n == (size_t) tb->nents || get_key(fs, type, &key) != 0)
+			continue;
+		ents[n].key = key;
+		ents[n].pos = pos;
+		ents[n].fs = fs;
+		n++;
+	}
+
+	if (n)
+		qsort(ents, n, sizeof(*ents), cmp_ents);
+
+	/* drop the old arrays if invalidated; note that the getters above may
+	 * call statmount() and invalidate the index, but they also have filled
+	 * the keys, so the new array is usable */
+	if (!idx->valid) {
+		size_t i;
+
+		for (i = 0; i < MNT_TABIDX_NKEYS; i++) {
+			free(idx->ents[i]);
+			idx->ents[i] = NULL;
+			idx->nents[i] = 0;
+		}
+	}
+	free(idx->ents[type]);
+	idx->ents[type] = ents;
+	idx->nents[type] = n;
+	if (type == MNT_TABIDX_SRCPATH)
+		idx->ntags = ntags;
+	idx->valid |= (1 << type);
+
+	DBG_OBJ(TAB, tb, ul_debug("index %d: built [%zu entries]", type, n));
+	return 0;
+}
+
+/*
+ * Returns 0 and a range of the index entries (sorted in table order) with
+ * @key, or 1 if the index is not available for @tb. The entries are valid
+ * until the next table change; note that the statmount() based getters may
+ * also modify the table entries.
+ */
+int mnt_table_index_lookup(struct libmnt_table *tb, int type, uint64_t key,
+			   struct mnt_tabidx_ent **res, size_t *nres)
+{
+	struct mnt_tabidx_ent *ents;
+	size_t lo, hi, n;
+
+	if (!tb || type < 0 || type >= MNT_TABIDX_NKEYS)
+		return 1;
+#ifdef HAVE_STATMOUNT_API
+	/* entries are added on demand by mnt_table_next_fs() */
+	if (mnt_table_want_listmount(tb))
+		return 1;
+#endif
+	if (!tb->idx || !(tb->idx->valid & (1 << type))) {
+		if (build_index(tb, type) != 0)
+			return 1;
+	}
+
+	ents = tb->idx->ents[type];
+	n = tb->idx->nents[type];
+
+	/* lower bound */
+	lo = 0, hi = n;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (ents[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (hi = lo; hi < n && ents[hi].key == key; hi++);
+
+	*res = ents ? ents + lo : NULL;
+	*nres = hi - lo;
+	return 0;
+}
+
+/*
+ * Returns number of entries with tag source (LABEL=, UUID=, ...) or <0 if
+ * the index is not available.
+ */
+int mnt_table_index_ntags(struct libmnt_table *tb)
+{
+	struct mnt_tabidx_ent *ents;
+	size_t n;
+
+	if (mnt_table_index_lookup(tb, MNT_TABIDX_SRCPATH, 0, &ents, &n) != 0)
+		return -1;
+	return tb->idx->ntags;
+}
@@ -37,17 +37,48 @@ struct libmnt_parser {
 	size_t	line;		/* current line */
 	int     sysroot_rc;	/* rc from mnt_guess_system_root() */
 	char	*sysroot;	/* guess from mmnt_guess_system_root() */
+
+	struct libmnt_arena *arena;	/* the whole mountinfo file */
+	char	*next;		/* the next line in the arena */
 };
 
 static void parser_cleanup(struct libmnt_parser *pa)
 {
 	if (!pa)
 		return;
-	free(pa->buf);
+	if (!pa->arena)
+		free(pa->buf);	/* otherwise points to the arena */
+	mnt_unref_arena(pa->arena);
 	free(pa->sysroot);
 	memset(pa, 0, sizeof(*pa));
 }
 
+/*
+ * Reads the next line to pa->buf; in the arena mode pa->buf points to the
+ * line in the arena (the line is not terminated by zero).
+ */
+static int parser_getline(struct libmnt_parser *pa)
+{
+	char *p;
+
+	if (!pa->arena)
+		return getline(&pa->buf, &pa->bufsiz, pa->f) < 0 ? -1 : 0;
+
+	if (!pa->next || !*pa->next)
+		return -1;
+	pa->buf = pa->next;
+	p = strchr(pa->next, '\n');
+	pa->next = p ? p + 1 : NULL;
+	return 0;
+}
+
+static int parser_eof(struct libmnt_parser *pa)
+{
+	if (pa->arena)
+		return !pa->next || !*pa->next;
+	return feof(pa->f);
+}
+
 static const char *next_s32(const char *s, int *num, int *rc)
 {
 	char *end = NULL;
@@ -306,6 +337,111 @@ fail:
 	return rc;
 }
 
+/*
+ * Parses one mountinfo line stored in the parser arena. The fields are
+ * terminated and unmangled in place and @fs points to the arena. Anything
+ * unusual (tabs, more spaces, errors, ...) is left to the generic
+ * mnt_parse_mountinfo_line(); the line is not modified in this case.
+ */
+static int mnt_parse_mountinfo_inplace(struct libmnt_fs *fs, char *s,
+				       struct libmnt_arena *ar)
+{
+	char *f[6], *sep, *fstype, *src, *fsopts, *p = s;
+	int id, parent, rc = 0;
+	unsigned int maj, min;
+	size_t i;
+
+	if (strchr(s, '\t'))
+		goto generic;
+
+	/* (1) id, (2) parent, (3) maj:min, (4) mountroot, (5) target,
+	 * (6) vfs options */
+	for (i = 0; i < ARRAY_SIZE(f); i++) {
+		f[i] = p;
+		p = strchr(p, ' ');
+		if (!p || p == f[i])
+			goto generic;
+		p++;
+	}
+
+	/* (7) optional fields, terminated by " - " */
+	sep = strstr(p - 1, " - ");
+	if (!sep)
+		goto generic;
+
+	/* (8) FS type, (9) source -- maybe empty string, (10) fs options */
+	fstype = sep + 3;
+	src = strchr(fstype, ' ');
+	if (!src || src == fstype)
+		goto generic;
+	src++;
+	fsopts = strchr(src, ' ');
+	if (!fsopts || !*(fsopts + 1) || strchr(fsopts + 1, ' '))
+		goto generic;
+	fsopts++;
+
+	next_s32(f[0], &id, &rc);
+	if (!rc)
+		next_s32(f[1], &parent, &rc);
+	if (rc || sscanf(f[2], "%u:%u", &maj, &min) != 2)
+		goto generic;
+
+	/* the line is valid, terminate the fields */
+	for (i = 1; i < ARRAY_SIZE(f); i++)
+		*(f[i] - 1) = '\0';
+	*(p - 1) = '\0';
+	*sep = '\0';
+	*(src - 1) = '\0';
+	*(fsopts - 1) = '\0';
+
+	fs->flags |= MNT_FS_KERNEL;
+	mnt_fs_mark_attached(fs);
+
+	fs->id = id;
+	fs->parent = parent;
+	fs->devno = makedev(maj, min);
+
+	/* from now @fs points to the arena */
+	mnt_ref_arena(ar);
+	fs->arena = ar;
+
+	for (i = 3; i < ARRAY_SIZE(f); i++)
+		unmangle_string(f[i]);
+	fs->root = f[3];
+	fs->target = f[4];
+	fs->vfs_optstr = f[5];
+
+	if (sep > p - 1)
+		fs->opt_fields = p;
+
+	unmangle_string(fstype);
+	rc = __mnt_fs_set_fstype_ptr(fs, fstype);
+	if (rc)
+		goto fail;
+
+	unmangle_string(src);
+	rc = __mnt_fs_set_source_ptr(fs, src);
+	if (rc)
+		goto fail;
+
+	unmangle_string(fsopts);
+	fs->fs_optstr = fsopts;
+
+	/* merge VFS and FS options to one string */
+	fs->optstr = mnt_fs_strdup_options(fs);
+	if (!fs->optstr) {
+		rc = -ENOMEM;
+		goto fail;
+	}
+
+	return 0;
+fail:
+	DBG(TAB, ul_debug("tab parse error on: '%s' [rc=%d]", s, rc));
+	return rc;
+generic:
+	return mnt_parse_mountinfo_line(fs, s);
+}
+
 /*
  * Parses one line from utab file
  */
@@ -566,7 +702,7 @@ static int mnt_table_parse_next(struct libmnt_parser *pa,
 	/* read the next non-blank non-comment line */
 next_line:
 	do {
-		if (getline(&pa->buf, &pa->bufsiz, pa->f) < 0)
+		if (parser_getline(pa) < 0)
 			return -EINVAL;
 		pa->line++;
 		s = strchr(pa->buf, '\n');
@@ -576,7 +712,9 @@ next_line:
 
 			/* Missing final newline?  Otherwise an extremely */
 			/* long line - assume file was corrupted */
-			if (feof(pa->f))
+			if (pa->arena)
+				s = strchr(pa->buf, '\0');
+			else if (feof(pa->f))
 				s = memchr(pa->buf, '\0', pa->bufsiz);
 
 		/* comments parser */
@@ -615,7 +753,10 @@ next_line:
 		rc = mnt_parse_table_line(fs, s);
 		break;
 	case MNT_FMT_MOUNTINFO:
-		rc = mnt_parse_mountinfo_line(fs, s);
+		if (pa->arena)
+			rc = mnt_parse_mountinfo_inplace(fs, s, pa->arena);
+		else
+			rc = mnt_parse_mountinfo_line(fs, s);
 		break;
 	case MNT_FMT_UTAB:
 		rc = mnt_parse_utab_line(fs, s);
@@ -727,6 +868,77 @@ static int kernel_fs_postparse(struct libmnt_parser *pa,
 	return rc;
 }
 
+/*
+ * Reads the whole mountinfo file to the parser arena, the entries will
+ * point to the arena rather than to separately allocated strings.
+ *
+ * Returns 0 on success, 1 if the arena is not used (not mountinfo, comments
+ * are requested, ...), or <0 on error.
+ */
+static int parser_read_arena(struct libmnt_parser *pa, struct libmnt_table *tb)
+{
+	struct libmnt_arena *ar = NULL, *x;
+	size_t sz = 0, bufsz = 16384, n;
+	long pos = 0;
+
+	if (tb->comms || (tb->fmt != MNT_FMT_MOUNTINFO && tb->fmt != MNT_FMT_GUESS))
+		return 1;
+	if (tb->fmt == MNT_FMT_GUESS) {
+		/* we need to rewind the stream if it is not mountinfo */
+		pos = ftell(pa->f);
+		if (pos < 0)
+			return 1;
+	}
+
+	do {
+		if (!ar || sz + 1 >= bufsz) {
+			if (ar)
+				bufsz *= 2;
+			x = realloc(ar, sizeof(*ar) + bufsz);
+			if (!x) {
+				free(ar);
+				return -ENOMEM;
+			}
+			ar = x;
+		}
+		n = fread(ar->data + sz, 1, bufsz - sz - 1, pa->f);
+		sz += n;
+	} while (n > 0);
+
+	if (ferror(pa->f)) {
+		free(ar);
+		return errno ? -errno : -EIO;
+	}
+	ar->data[sz] = '\0';
+
+	if (tb->fmt == MNT_FMT_GUESS) {
+		const char *p = ar->data;
+
+		/* the first non-blank non-comment line */
+		while (p && *(p = skip_blank(p)) && (*p == '#' || *p == '\n')) {
+			p = strchr(p, '\n');
+			if (p)
+				p++;
+		}
+		if (p && *p && guess_table_format(p) != MNT_FMT_MOUNTINFO) {
+			free(ar);
+			return fseek(pa->f, pos, SEEK_SET) == 0 ? 1 : -errno;
+		}
+	}
+
+	/* release the unused space */
+	x = realloc(ar, sizeof(*ar) + sz + 1);
+	if (x)
+		ar = x;
+	ar->refcount = 1;
+	ar->size = sz + 1;
+
+	DBG_OBJ(TAB, tb, ul_debug("%s: read to arena [%zu bytes]", pa->filename, sz));
+	pa->arena = ar;
+	pa->next = ar->data;
+	return 0;
+}
+
 /**
  * mnt_table_parse_stream:
  * @tb: tab pointer
@@ -753,6 +965,9 @@ int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filenam
 	pa.filename = filename;
 	pa.f = f;
 
+	if (parser_read_arena(&pa, tb) < 0)
+		goto err;
+
 	/* necessary for /proc/mounts only, the /proc/self/mountinfo
 	 * parser sets the flag properly
 	 */
@@ -764,7 +979,7 @@ int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filenam
 	do {
 		struct libmnt_fs *fs;
 
-		if (feof(f)) {
+		if (parser_eof(&pa)) {
 			DBG_OBJ(TAB, tb, ul_debug("end-of-file"));
 			break;
 		}
@@ -808,7 +1023,7 @@ int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filenam
 		}
 
 		/* fatal errors */
-		if (rc < 0 && !feof(f)) {
+		if (rc < 0 && !parser_eof(&pa)) {
 			DBG_OBJ(TAB, tb, ul_debug("fatal error"));
 			goto err;
 		}
@@ -91,6 +91,23 @@ int mnt_parse_offset(const char *str, size_t len, uintmax_t *res)
 	return rc;
 }
 
+/*
+ * FNV-1a hash of @path; the same paths as by streq_paths() have the same
+ * hash (duplicate and trailing slashes are ignored).
+ */
+uint32_t mnt_hash_path(const char *path)
+{
+	uint32_t h = 2166136261U;
+	const char *p;
+
+	for (p = path; *p; p++) {
+		if (*p == '/' && (*(p + 1) == '/' || *(p + 1) == '\0'))
+			continue;
+		h = (h ^ (unsigned char) *p) * 16777619U;
+	}
+	return h;
+}
+
 /* used as a callback by bsearch in mnt_fstype_is_pseudofs() */
 static int fstype_cmp(const void *v1, const void *v2)
 {
@@ -204,6 +204,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out,
 		"\n %s [options] <column-data-file> ...\n\n", program_invocation_short_name);
 
+	fputs(" -A, --arena                    allocate cell strings from table arena\n", out);
 	fputs(" -m, --maxout                   fill all terminal width\n", out);
 	fputs(" -M, --minout                   minimize trailing padding\n", out);
 	fputs(" -c, --column <file>            column definition\n", out);
@@ -216,6 +217,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(" -p, --tree-parent-column <n>   parent column\n", out);
 	fputs(" -i, --tree-id-column <n>       id column\n", out);
 	fputs(" -Q, --filter <expr>            filter\n", out);
+	fputs(" -S, --sort <n>                 sort by column\n", out);
 	fputs(" -h, --help                     this help\n", out);
 	fputs("\n", out);
 
@@ -226,12 +228,13 @@ int main(int argc, char *argv[])
 {
 	struct libscols_table *tb;
 	int c, n, nlines = 0, rc;
-	int parent_col = -1, id_col = -1;
+	int parent_col = -1, id_col = -1, sort_col = -1;
 	int fltr_dump = 0;
 	const char *fltr_str = NULL;
 	struct libscols_filter *fltr = NULL;
 
 	static const struct option longopts[] = {
+		{ "arena",  0, NULL, 'A' },
 		{ "maxout", 0, NULL, 'm' },
 		{ "minout", 0, NULL, 'M' },
 		{ "column", 1, NULL, 'c' },
@@ -245,6 +248,7 @@ int main(int argc, char *argv[])
 		{ "colsep",  1, NULL, 'C' },
 		{ "filter", 1, NULL, 'Q' },
 		{ "filter-dump", 0, NULL, 'd' },
+		{ "sort",   1, NULL, 'S' },
 		{ "help",   0, NULL, 'h' },
 		{ NULL, 0, NULL, 0 },
 	};
@@ -263,11 +267,14 @@ int main(int argc, char *argv[])
 	if (!tb)
 		err(EXIT_FAILURE, "failed to create output table");
 
-	while((c = getopt_long(argc, argv, "hCc:dEi:JMmn:p:Q:rw:", longopts, NULL)) != -1) {
+	while((c = getopt_long(argc, argv, "AhCc:dEi:JMmn:p:Q:rS:w:", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
 		switch(c) {
+		case 'A':
+			scols_table_enable_arena(tb, TRUE);
+			break;
 		case 'c': /* add column from file */
 		{
 			struct libscols_column *cl = parse_column(optarg);
@@ -311,6 +318,9 @@ int main(int argc, char *argv[])
 		case 'Q':
 			fltr_str = optarg;
 			break;
+		case 'S':
+			sort_col = strtou32_or_err(optarg, "failed to parse sort column");
+			break;
 		case 'w':
 			scols_table_set_termforce(tb, SCOLS_TERMFORCE_ALWAYS);
 			scols_table_set_termwidth(tb, strtou32_or_err(optarg, "failed to parse terminal width"));
@@ -358,6 +368,31 @@ int main(int argc, char *argv[])
 	if (scols_table_is_tree(tb) && parent_col >= 0 && id_col >= 0)
 		compose_tree(tb, parent_col, id_col);
 
+	if (sort_col >= 0) {
+		struct libscols_column *cl = scols_table_get_column(tb, sort_col);
+
+		if (!cl)
+			errx(EXIT_FAILURE, "%d: no such column", sort_col);
+
+		/* numbers and booleans are sorted by data type */
+		switch (scols_column_get_json_type(cl)) {
+		case SCOLS_JSON_NUMBER:
+			scols_column_set_data_type(cl, SCOLS_DATA_U64);
+			break;
+		case SCOLS_JSON_FLOAT:
+			scols_column_set_data_type(cl, SCOLS_DATA_FLOAT);
+			break;
+		case SCOLS_JSON_BOOLEAN:
+			scols_column_set_data_type(cl, SCOLS_DATA_BOOLEAN);
+			break;
+		default:
+			scols_column_set_cmpfunc(cl, scols_cmpstr_cells, NULL);
+			break;
+		}
+		if (scols_sort_table(tb, cl) != 0)
+			err(EXIT_FAILURE, "failed to sort table");
+	}
+
 	scols_table_enable_colors(tb, isatty(STDOUT_FILENO));
 
 	if (fltr)
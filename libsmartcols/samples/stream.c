@@ -0,0 +1,117 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "c.h"
+#include "nls.h"
+#include "strutils.h"
+
+#include "libsmartcols.h"
+
+/* add columns to the @tb */
+static void setup_columns(struct libscols_table *tb)
+{
+	if (!scols_table_new_column(tb, "COUNT", 0, SCOLS_FL_RIGHT))
+		goto fail;
+	if (!scols_table_new_column(tb, "NAME", 0, 0))
+		goto fail;
+	if (!scols_table_new_column(tb, "TEXT", 0, 0))
+		goto fail;
+	return;
+fail:
+	scols_unref_table(tb);
+	err(EXIT_FAILURE, "failed to create output columns");
+}
+
+/* the data are wider for later lines to make reflow visible */
+static void add_line(struct libscols_table *tb, size_t i)
+{
+	struct libscols_line *ln = scols_table_new_line(tb, NULL);
+
+	if (!ln)
+		err(EXIT_FAILURE, "failed to create output line");
+
+	if (scols_line_sprintf(ln, 0, "%zu", i * i * i))
+		goto fail;
+	if (scols_line_sprintf(ln, 1, "name-%.*s", (int) i, "abcdefghijklmnopqrstuvwxyz"))
+		goto fail;
+	if (scols_line_sprintf(ln, 2, "text%zu", i))
+		goto fail;
+	return;
+fail:
+	scols_unref_table(tb);
+	err(EXIT_FAILURE, "failed to create output line");
+}
+
+int main(int argc, char *argv[])
+{
+	struct libscols_table *tb;
+	size_t i, nlines = 10;
+	int c, stream = 1;
+
+	static const struct option longopts[] = {
+		{ "export",  0, NULL, 'E' },
+		{ "grow",    0, NULL, 'g' },
+		{ "json",    0, NULL, 'J' },
+		{ "nlines",  1, NULL, 'n' },
+		{ "nostream",0, NULL, 'N' },
+		{ "raw",     0, NULL, 'r' },
+		{ "sample",  1, NULL, 's' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	scols_init_debug(0);
+
+	tb = scols_new_table();
+	if (!tb)
+		err(EXIT_FAILURE, "failed to create output table");
+
+	while((c = getopt_long(argc, argv, "EgJn:Nrs:", longopts, NULL)) != -1) {
+		switch(c) {
+		case 'E':
+			scols_table_enable_export(tb, 1);
+			break;
+		case 'g':
+			scols_table_set_streaming_reflow(tb, SCOLS_REFLOW_GROW);
+			break;
+		case 'J':
+			scols_table_enable_json(tb, 1);
+			scols_table_set_name(tb, "stream");
+			break;
+		case 'n':
+			nlines = strtou32_or_err(optarg, "failed to parse number of lines");
+			break;
+		case 'N':
+			stream = 0;
+			break;
+		case 'r':
+			scols_table_enable_raw(tb, 1);
+			break;
+		case 's':
+			scols_table_set_streaming_sample(tb,
+				strtou32_or_err(optarg, "failed to parse sample size"));
+			break;
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	scols_table_enable_streaming(tb, stream);
+	setup_columns(tb);
+
+	/* the lines are printed by scols_table_new_line() */
+	for (i = 0; i < nlines; i++)
+		add_line(tb, i);
+
+	scols_print_table(tb);
+	scols_unref_table(tb);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+/*
+ * arena.c - cell strings storage
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The arena is used for tables with scols_table_enable_arena(). The cell
+ * strings are bump-allocated from memory chunks, every column has its own
+ * chunks, so data of the same column are close together (width calculation,
+ * sort, etc.). The strings are never deallocated separately; the arena is
+ * referenced by all the lines which use it and it's deallocated together
+ * with the last line.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "smartcolsP.h"
+
+#define SCOLS_ARENA_CHUNKSZ	(16 * 1024)
+
+struct libscols_arena_chunk {
+	struct libscols_arena_chunk *next;
+	size_t	size;		/* size of data[] */
+	size_t	used;
+	char	data[];
+};
+
+struct libscols_arena_column {
+	struct libscols_arena_chunk *chunks;	/* the first is the current */
+};
+
+struct libscols_arena {
+	int	refcount;
+
+	struct libscols_arena_column **columns;
+	size_t	ncolumns;
+};
+
+struct libscols_arena *scols_new_arena(void)
+{
+	struct libscols_arena *ar = calloc(1, sizeof(*ar));
+
+	if (!ar)
+		return NULL;
+	ar->refcount = 1;
+	return ar;
+}
+
+void scols_ref_arena(struct libscols_arena *ar)
+{
+	if (ar)
+		ar->refcount++;
+}
+
+void scols_unref_arena(struct libscols_arena *ar)
+{
+	size_t i;
+
+	if (!ar || --ar->refcount > 0)
+		return;
+
+	for (i = 0; i < ar->ncolumns; i++) {
+		struct libscols_arena_column *acol = ar->columns[i];
+
+		while (acol && acol->chunks) {
+			struct libscols_arena_chunk *ch = acol->chunks;
+
+			acol->chunks = ch->next;
+			free(ch);
+		}
+		free(acol);
+	}
+	free(ar->columns);
+	free(ar);
+}
+
+/* Returns storage for the column @n; the pointer is valid for the whole
+ * arena life time. */
+struct libscols_arena_column *scols_arena_get_column(struct libscols_arena *ar, size_t n)
+{
+	if (n >= ar->ncolumns) {
+		struct libscols_arena_column **cols;
+
+		cols = reallocarray(ar->columns, n + 1, sizeof(*cols));
+		if (!cols)
+			return NULL;
+		memset(cols + ar->ncolumns, 0,
+		       (n + 1 - ar->ncolumns) * sizeof(*cols));
+		ar->columns = cols;
+		ar->ncolumns = n + 1;
+	}
+
+	if (!ar->columns[n])
+		ar->columns[n] = calloc(1, sizeof(struct libscols_arena_column));
+	return ar->columns[n];
+}
+
+static struct libscols_arena_chunk *new_chunk(struct libscols_arena_column *acol,
+					      size_t sz)
+{
+	struct libscols_arena_chunk *ch;
+
+	/* large strings use private chunks, the current chunk is kept */
+	if (sz > SCOLS_ARENA_CHUNKSZ / 4) {
+		ch = malloc(sizeof(*ch) + sz);
+		if (!ch)
+			return NULL;
+		ch->size = ch->used = sz;
+		if (acol->chunks) {
+			ch->next = acol->chunks->next;
+			acol->chunks->next = ch;
+		} else {
+			ch->next = NULL;
+			acol->chunks = ch;
+		}
+		return ch;
+	}
+
+	ch = malloc(sizeof(*ch) + SCOLS_ARENA_CHUNKSZ);
+	if (!ch)
+		return NULL;
+	ch->size = SCOLS_ARENA_CHUNKSZ;
+	ch->used = sz;
+	ch->next = acol->chunks;
+	acol->chunks = ch;
+	return ch;
+}
+
+static char *arena_alloc(struct libscols_arena_column *acol, size_t sz)
+{
+	struct libscols_arena_chunk *ch = acol->chunks;
+
+	if (ch && ch->size - ch->used >= sz) {
+		char *p = ch->data + ch->used;
+
+		ch->used += sz;
+		return p;
+	}
+
+	ch = new_chunk(acol, sz);
+	if (!ch)
+		return NULL;
+	return ch->data + ch->used - sz;
+}
+
+char *scols_arena_strdup(struct libscols_arena_column *acol, const char *str)
+{
+	size_t sz = strlen(str) + 1;
+	char *p = arena_alloc(acol, sz);
+
+	if (p)
+		memcpy(p, str, sz);
+	return p;
+}
+
+/* Returns the number of printed bytes or a negative number in case of error */
+int scols_arena_vasprintf(struct libscols_arena_column *acol, char **res,
+			  const char *fmt, va_list ap)
+{
+	struct libscols_arena_chunk *ch = acol->chunks;
+	size_t avail = ch ? ch->size - ch->used : 0;
+	va_list cp;
+	int n;
+
+	/* try to print to the current chunk */
+	va_copy(cp, ap);
+	n = vsnprintf(avail ? ch->data + ch->used : NULL, avail, fmt, cp);
+	va_end(cp);
+
+	if (n < 0)
+		return -errno;
+	if ((size_t) n < avail) {
+		*res = ch->data + ch->used;
+		ch->used += n + 1;
+		return n;
+	}
+
+	*res = arena_alloc(acol, n + 1);
+	if (!*res)
+		return -ENOMEM;
+	return vsnprintf(*res, n + 1, fmt, ap);
+}
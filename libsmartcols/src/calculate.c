@@ -37,17 +37,56 @@ static void dbg_columns(struct libscols_table *tb)
 		dbg_column(tb, cl);
 }
 
+/*
+ * The width of the cell depends on the cell data only, except tree and
+ * wrapped columns. The width is kept in the cell until the data are
+ * modified (see scols_cell_set_data() and friends), so the next print of
+ * the same table does not have to encode and count the strings again.
+ *
+ * The cell data modified in place (without the setter, see datasiz in
+ * __cursor_to_buffer()) are never cached.
+ */
+static int is_cacheable_width(struct libscols_column *cl,
+			      struct libscols_cell *ce)
+{
+	if (scols_column_is_tree(cl)
+	    || scols_column_is_wrap(cl)
+	    || scols_column_is_customwrap(cl))
+		return 0;
+	if (ce->data && *ce->data && !ce->datasiz)
+		return 0;
+	return 1;
+}
+
+static void update_column_wstat(struct libscols_column *cl, size_t len)
+{
+	struct libscols_wstat *st = &cl->wstat;
+
+	st->width_max = max(len, st->width_max);
+	st->width_sum += len;
+	st->width_sum_sqr += (double) len * (double) len;
+	st->ncells++;
+}
+
 static int count_cell_width(struct libscols_table *tb,
 		struct libscols_line *ln,
 		struct libscols_column *cl,
 		struct ul_buffer *buf)
 {
 	size_t len = 0;
-	int rc = 0;
+	int rc = 0, cache;
 	struct libscols_cell *ce;
 	char *data;
 
 	ce = scols_line_get_cell(ln, cl->seqnum);
+
+	cache = ce && is_cacheable_width(cl, ce);
+	if (cache && ce->width_valid
+	    && ce->width_noencoding == (scols_table_is_noencoding(tb) ? 1 : 0)) {
+		update_column_wstat(cl, ce->width);
+		return 0;
+	}
+
 	scols_table_set_cursor(tb, ln, cl, ce);
 
 	rc = __cursor_to_buffer(tb, buf, 1);
@@ -70,7 +109,11 @@ static int count_cell_width(struct libscols_table *tb,
 	}
 
 	ce->width = len;
-	cl->wstat.width_max = max(len, cl->wstat.width_max);
+	if (cache) {
+		ce->width_valid = 1;
+		ce->width_noencoding = scols_table_is_noencoding(tb) ? 1 : 0;
+	}
+	update_column_wstat(cl, len);
 done:
 	scols_table_reset_cursor(tb);
 	return rc;
@@ -84,6 +127,42 @@ static int walk_count_cell_width(struct libscols_table *tb,
 	return count_cell_width(tb, ln, cl, (struct ul_buffer *) data);
 }
 
+/*
+ * Enlarges columns for the data in @ln, used for lines printed after the
+ * width calculation (see scols_table_set_streaming_reflow()). The truncated
+ * and wrapped columns keep the calculated width.
+ */
+int __scols_calculate_line(struct libscols_table *tb,
+			   struct libscols_line *ln,
+			   struct ul_buffer *buf)
+{
+	struct libscols_column *cl;
+	struct libscols_iter itr;
+	int rc = 0;
+
+	tb->is_dummy_print = 1;
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (rc == 0 && scols_table_next_column(tb, &itr, &cl) == 0) {
+		struct libscols_cell *ce;
+
+		if (scols_column_is_hidden(cl)
+		    || scols_column_is_trunc(cl)
+		    || scols_column_is_wrap(cl))
+			continue;
+
+		rc = count_cell_width(tb, ln, cl, buf);
+		ce = scols_line_get_cell(ln, cl->seqnum);
+		if (rc == 0 && ce && ce->width > cl->width) {
+			DBG_OBJ(COL, cl, ul_debug("reflow %zu -> %zu", cl->width, ce->width));
+			cl->width = ce->width;
+		}
+	}
+
+	tb->is_dummy_print = 0;
+	return rc;
+}
+
 static double sqrtroot(double num)
 {
 	double tmp = 0, sq = num / 2;
@@ -95,43 +174,34 @@ static double sqrtroot(double num)
 	return sq;
 }
 
+/*
+ * The average and deviation are counted from the sums collected by
+ * count_cell_width(), so the lines are not walked again.
+ */
 static void count_column_deviation(struct libscols_table *tb, struct libscols_column *cl)
 {
 	struct libscols_wstat *st;
-	struct libscols_iter itr;
-	struct libscols_line *ln;
-	struct libscols_cell *ce;
-	size_t sum = 0, n = 0, extra = 0;
+	size_t n, extra = 0;
 
 	st = &cl->wstat;
+	n = st->ncells;
 
 	if (scols_column_is_tree(cl) && has_groups(tb))
 		extra = tb->grpset_size + 1;
 
 	/* count average */
-	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
-	while (scols_table_next_line(tb, &itr, &ln) == 0) {
-		ce = scols_line_get_cell(ln, cl->seqnum);
-
-		n++;
-		sum += ce->width + extra;
-	}
-
 	if (n)
-		st->width_avg = (double) sum / (double) n;
+		st->width_avg = (double) (st->width_sum + n * extra) / (double) n;
 
-	/* count deviation */
+	/* count deviation; sum of (width - avg)^2 */
 	if (n > 1) {
 		double variance;
 
-		scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
-		while (scols_table_next_line(tb, &itr, &ln) == 0) {
-			double diff;
-			ce = scols_line_get_cell(ln, cl->seqnum);
-
-			diff = (double) ce->width - st->width_avg;
-			st->width_sqr_sum += diff * diff;	/* aka pow(x, 2) */
-		}
+		st->width_sqr_sum = st->width_sum_sqr
+				    - 2.0 * st->width_avg * (double) st->width_sum
+				    + (double) n * st->width_avg * st->width_avg;
+		if (st->width_sqr_sum < 0)
+			st->width_sqr_sum = 0;	/* rounding */
 
 		variance = st->width_sqr_sum / (double) (n - 1);
 		st->width_deviation = sqrtroot(variance);
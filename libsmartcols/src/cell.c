@@ -31,6 +31,26 @@
  * handled by libscols_line.
  */
 
+/* deallocates a string member, @_s is reset to NULL */
+#define cell_drop_str(_s, _nofree) \
+	do { \
+		if (!(_nofree)) \
+			free(_s); \
+		(_s) = NULL; \
+		(_nofree) = 0; \
+	} while (0)
+
+/* returns a copy of @str, allocated from the arena if the cell has any */
+static int cell_strdup(struct libscols_cell *ce, const char *str, char **res)
+{
+	*res = NULL;
+	if (!str)
+		return 0;
+
+	*res = ce->arena ? scols_arena_strdup(ce->arena, str) : strdup(str);
+	return *res ? 0 : -ENOMEM;
+}
+
 /**
  * scols_reset_cell:
  * @ce: pointer to a struct libscols_cell instance
@@ -41,14 +61,18 @@
  */
 int scols_reset_cell(struct libscols_cell *ce)
 {
+	struct libscols_arena_column *acol;
+
 	if (!ce)
 		return -EINVAL;
 
 	/*DBG_OBJ(CELL, ce, ul_debug("reset"));*/
-	free(ce->data);
-	free(ce->color);
-	free(ce->uri);
+	acol = ce->arena;
+	cell_drop_str(ce->data, ce->data_nofree);
+	cell_drop_str(ce->color, ce->color_nofree);
+	cell_drop_str(ce->uri, ce->uri_nofree);
 	memset(ce, 0, sizeof(*ce));
+	ce->arena = acol;
 	return 0;
 }
 
@@ -63,13 +87,20 @@ int scols_reset_cell(struct libscols_cell *ce)
  */
 int scols_cell_set_data(struct libscols_cell *ce, const char *data)
 {
+	char *p;
 	int rc;
 
 	if (!ce)
 		return -EINVAL;
 
 	ce->is_filled = 1;
-	rc = strdup_to_struct_member(ce, data, data);
+	rc = cell_strdup(ce, data, &p);
+	if (rc == 0) {
+		cell_drop_str(ce->data, ce->data_nofree);
+		ce->data = p;
+		ce->data_nofree = p && ce->arena;
+		ce->width_valid = 0;
+	}
 	ce->datasiz = ce->data && *ce->data ? strlen(ce->data) + 1: 0;
 	return rc;
 }
@@ -90,13 +121,41 @@ int scols_cell_refer_data(struct libscols_cell *ce, char *data)
 {
 	if (!ce)
 		return -EINVAL;
-	free(ce->data);
+	cell_drop_str(ce->data, ce->data_nofree);
+	ce->width_valid = 0;
 	ce->data = data;
 	ce->datasiz = ce->data && *ce->data ? strlen(ce->data) + 1: 0;
 	ce->is_filled = 1;
 	return 0;
 }
 
+/**
+ * scols_cell_refer_static_data:
+ * @ce: a pointer to a struct libscols_cell instance
+ * @data: string (used for scols_print_table())
+ *
+ * Adds a reference to @data to @ce, the string is not copied and it's never
+ * deallocated by the library. The @data has to be valid as long as the cell
+ * uses it; this function is designed for string literals and strings owned
+ * by the application for the whole table life time.
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: 2.44
+ */
+int scols_cell_refer_static_data(struct libscols_cell *ce, const char *data)
+{
+	if (!ce)
+		return -EINVAL;
+	cell_drop_str(ce->data, ce->data_nofree);
+	ce->width_valid = 0;
+	ce->data = (char *) data;
+	ce->data_nofree = 1;
+	ce->datasiz = ce->data && *ce->data ? strlen(ce->data) + 1: 0;
+	ce->is_filled = 1;
+	return 0;
+}
+
 /**
  * scols_cell_refer_memory:
  * @ce: a pointer to a struct libscols_cell instance
@@ -118,7 +177,8 @@ int scols_cell_refer_memory(struct libscols_cell *ce, char *data, size_t datasiz
 {
 	if (!ce)
 		return -EINVAL;
-	free(ce->data);
+	cell_drop_str(ce->data, ce->data_nofree);
+	ce->width_valid = 0;
 	ce->data = data;
 	ce->datasiz = datasiz;
 	return 0;
@@ -217,6 +277,9 @@ int scols_cmpstr_cells(struct libscols_cell *a,
  */
 int scols_cell_set_color(struct libscols_cell *ce, const char *color)
 {
+	char *p;
+	int rc;
+
 	if (!ce)
 		return -EINVAL;
 
@@ -224,11 +287,18 @@ int scols_cell_set_color(struct libscols_cell *ce, const char *color)
 		char *seq = color_get_sequence(color);
 		if (!seq)
 			return -EINVAL;
-		free(ce->color);
+		cell_drop_str(ce->color, ce->color_nofree);
 		ce->color = seq;
 		return 0;
 	}
-	return strdup_to_struct_member(ce, color, color);
+
+	rc = cell_strdup(ce, color, &p);
+	if (rc == 0) {
+		cell_drop_str(ce->color, ce->color_nofree);
+		ce->color = p;
+		ce->color_nofree = p && ce->arena;
+	}
+	return rc;
 }
 
 /**
@@ -258,10 +328,19 @@ const char *scols_cell_get_color(const struct libscols_cell *ce)
  */
 int scols_cell_set_uri(struct libscols_cell *ce, const char *uri)
 {
+	char *p;
+	int rc;
+
 	if (!ce)
 		return -EINVAL;
 
-	return strdup_to_struct_member(ce, uri, uri);
+	rc = cell_strdup(ce, uri, &p);
+	if (rc == 0) {
+		cell_drop_str(ce->uri, ce->uri_nofree);
+		ce->uri = p;
+		ce->uri_nofree = p && ce->arena;
+	}
+	return rc;
 }
 
 /**
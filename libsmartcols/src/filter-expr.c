@@ -64,6 +64,21 @@ void filter_free_expr(struct filter_expr *n)
 	free(n);
 }
 
+enum filter_etype filter_expr_get_type(struct filter_expr *n)
+{
+	return n->type;
+}
+
+struct filter_node *filter_expr_get_left(struct filter_expr *n)
+{
+	return n->left;
+}
+
+struct filter_node *filter_expr_get_right(struct filter_expr *n)
+{
+	return n->right;
+}
+
 static const char *expr_type_as_string(struct filter_expr *n)
 {
 	switch (n->type) {
@@ -150,7 +165,7 @@ static int node_get_datatype(struct filter_node *n)
 	return SCOLS_DATA_NONE;
 }
 
-static int guess_expr_datatype(struct filter_expr *n)
+int filter_expr_get_datatype(struct filter_expr *n)
 {
 	int type;
 	int l = node_get_datatype(n->left),
@@ -212,7 +227,7 @@ int filter_eval_expr(struct libscols_filter *fltr, struct libscols_line *ln,
 		break;
 	}
 
-	type = guess_expr_datatype(n);
+	type = filter_expr_get_datatype(n);
 
 	/* compare data */
 	rc = cast_node(fltr, ln, type, n->left, &l);
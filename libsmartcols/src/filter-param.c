@@ -273,6 +273,13 @@ int filter_param_get_datatype(struct filter_param *n)
 	return n ? n->type : SCOLS_DATA_NONE;
 }
 
+/* used by compiled filters for temporary expression results */
+void filter_param_set_boolean(struct filter_param *n, bool x)
+{
+	n->val.boolean = x;
+	n->empty = 0;
+}
+
 int is_filter_holder_node(struct filter_node *n)
 {
 	return n && filter_node_get_type(n) == F_NODE_PARAM
@@ -919,6 +926,9 @@ int scols_filter_assign_column(struct libscols_filter *fltr,
 					scols_column_get_name(col)));
 		n->col = col;
 		scols_ref_column(col);
+
+		/* data types of the compiled expression depend on columns */
+		filter_free_prog(fltr);
 	}
 
 	return n ? 0 : -EINVAL;
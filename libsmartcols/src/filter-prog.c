@@ -0,0 +1,378 @@
+/*
+ * filter-prog.c - compiled filter expressions
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The expression tree is compiled to a flat array of instructions before the
+ * first line is filtered. The data types of the comparisons are resolved
+ * once, literals are casted to the wanted type in advance, sub-expressions
+ * without holders are folded to constants, and logical operators are
+ * converted to conditional jumps. The program uses one status register; the
+ * results of sub-expressions used as comparison operands are stored to
+ * temporary boolean params.
+ *
+ * The holder data types depend on the assigned columns, so the program is
+ * dropped when the filter is parsed again or a column is assigned. If the
+ * expression cannot be compiled (e.g. a literal cannot be casted) the
+ * filter falls back to the tree evaluation to keep the original errors.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "smartcolsP.h"
+
+enum filter_opcode {
+	F_OP_CONST,	/* status = constant */
+	F_OP_TEST,	/* status = param value is true */
+	F_OP_CMP,	/* status = compare params */
+	F_OP_NOT,	/* status = !status */
+	F_OP_JMPF,	/* jump if status is false */
+	F_OP_JMPT,	/* jump if status is true */
+	F_OP_STORE	/* store status to the temporary param */
+};
+
+struct filter_insn {
+	enum filter_opcode	op;
+	enum filter_etype	oper;	/* F_OP_CMP operator */
+	int			type;	/* F_OP_CMP data type */
+	int			status;	/* F_OP_CONST value */
+	size_t			jmp;	/* F_OP_JMP{F,T} target */
+
+	struct filter_param	*l, *r;	/* referenced operands */
+};
+
+struct filter_prog {
+	struct filter_insn	*insns;
+	size_t			ninsns;
+	size_t			nalloc;
+};
+
+/* node is not a constant, the code has been added to the program */
+#define F_PROG_CODE	-1
+
+static struct filter_insn *prog_add(struct filter_prog *pg, enum filter_opcode op)
+{
+	struct filter_insn *in;
+
+	if (pg->ninsns == pg->nalloc) {
+		size_t sz = pg->nalloc ? pg->nalloc * 2 : 16;
+
+		in = reallocarray(pg->insns, sz, sizeof(struct filter_insn));
+		if (!in)
+			return NULL;
+		pg->insns = in;
+		pg->nalloc = sz;
+	}
+
+	in = &pg->insns[pg->ninsns++];
+	memset(in, 0, sizeof(*in));
+	in->op = op;
+	return in;
+}
+
+/* remove the last instruction; used for jumps over folded constants */
+static void prog_pop(struct filter_prog *pg)
+{
+	struct filter_insn *in = &pg->insns[--pg->ninsns];
+
+	filter_unref_node((struct filter_node *) in->l);
+	filter_unref_node((struct filter_node *) in->r);
+}
+
+static int compile_node(struct libscols_filter *fltr, struct filter_prog *pg,
+			struct filter_node *n, int *cst);
+
+/*
+ * Returns referenced comparison operand in @res. The literals are casted to
+ * @type, holders and sub-expression results are casted on evaluation.
+ */
+static int compile_operand(struct libscols_filter *fltr, struct filter_prog *pg,
+			   int type, struct filter_node *n,
+			   struct filter_param **res, int *cst)
+{
+	struct filter_node *tmp;
+	struct filter_insn *in;
+	int rc;
+	bool x;
+
+	*res = NULL;
+	*cst = 0;
+
+	if (is_filter_holder_node(n)) {
+		filter_ref_node(n);
+		*res = (struct filter_param *) n;
+		return 0;
+	}
+	if (filter_node_get_type(n) == F_NODE_PARAM) {
+		*cst = 1;
+		return filter_cast_param(fltr, NULL, type, (struct filter_param *) n, res);
+	}
+
+	rc = compile_node(fltr, pg, n, cst);
+	if (rc)
+		return rc;
+
+	x = *cst == 1;
+	tmp = filter_new_param(NULL, SCOLS_DATA_BOOLEAN, 0, (void *) &x);
+	if (!tmp)
+		return -ENOMEM;
+
+	if (*cst != F_PROG_CODE) {
+		*cst = 1;
+		rc = filter_cast_param(fltr, NULL, type, (struct filter_param *) tmp, res);
+		filter_unref_node(tmp);
+		return rc;
+	}
+
+	*cst = 0;
+	in = prog_add(pg, F_OP_STORE);
+	if (!in) {
+		filter_unref_node(tmp);
+		return -ENOMEM;
+	}
+	in->l = (struct filter_param *) tmp;
+	filter_ref_node(tmp);
+	*res = (struct filter_param *) tmp;
+	return 0;
+}
+
+static int compile_compare(struct libscols_filter *fltr, struct filter_prog *pg,
+			   struct filter_expr *n, int *cst)
+{
+	struct filter_param *l = NULL, *r = NULL;
+	struct filter_insn *in;
+	int type = filter_expr_get_datatype(n);
+	int l_cst, r_cst, rc;
+
+	rc = compile_operand(fltr, pg, type, filter_expr_get_left(n), &l, &l_cst);
+	if (!rc)
+		rc = compile_operand(fltr, pg, type, filter_expr_get_right(n), &r, &r_cst);
+	if (rc)
+		goto done;
+
+	if (l_cst && r_cst) {
+		rc = filter_compare_params(fltr, filter_expr_get_type(n), l, r, cst);
+		goto done;
+	}
+
+	in = prog_add(pg, F_OP_CMP);
+	if (!in) {
+		rc = -ENOMEM;
+		goto done;
+	}
+	in->oper = filter_expr_get_type(n);
+	in->type = type;
+	in->l = l;
+	in->r = r;
+	*cst = F_PROG_CODE;
+	return 0;
+done:
+	filter_unref_node((struct filter_node *) l);
+	filter_unref_node((struct filter_node *) r);
+	return rc;
+}
+
+/* AND and OR; the right side is evaluated only if the left side status
+ * is @cont */
+static int compile_logical(struct libscols_filter *fltr, struct filter_prog *pg,
+			   struct filter_expr *n, int cont, int *cst)
+{
+	struct filter_insn *in;
+	size_t jmp;
+	int rc, l, r;
+
+	rc = compile_node(fltr, pg, filter_expr_get_left(n), &l);
+	if (rc)
+		return rc;
+	if (l != F_PROG_CODE) {
+		if (l != cont) {
+			*cst = l;
+			return 0;
+		}
+		return compile_node(fltr, pg, filter_expr_get_right(n), cst);
+	}
+
+	in = prog_add(pg, cont ? F_OP_JMPF : F_OP_JMPT);
+	if (!in)
+		return -ENOMEM;
+	jmp = pg->ninsns - 1;
+
+	rc = compile_node(fltr, pg, filter_expr_get_right(n), &r);
+	if (rc)
+		return rc;
+	if (r != F_PROG_CODE) {
+		/* status is already defined by the left side */
+		prog_pop(pg);
+		if (r != cont) {
+			in = prog_add(pg, F_OP_CONST);
+			if (!in)
+				return -ENOMEM;
+			in->status = r;
+		}
+	} else
+		pg->insns[jmp].jmp = pg->ninsns;
+
+	*cst = F_PROG_CODE;
+	return 0;
+}
+
+/*
+ * Adds code to evaluate @n to the program, or returns the constant result
+ * in @cst (then no code is added).
+ */
+static int compile_node(struct libscols_filter *fltr, struct filter_prog *pg,
+			struct filter_node *n, int *cst)
+{
+	struct filter_expr *ex;
+	struct filter_insn *in;
+	int rc;
+
+	if (filter_node_get_type(n) == F_NODE_PARAM) {
+		if (!is_filter_holder_node(n))
+			return filter_eval_param(fltr, NULL, (struct filter_param *) n, cst);
+
+		in = prog_add(pg, F_OP_TEST);
+		if (!in)
+			return -ENOMEM;
+		filter_ref_node(n);
+		in->l = (struct filter_param *) n;
+		*cst = F_PROG_CODE;
+		return 0;
+	}
+
+	ex = (struct filter_expr *) n;
+
+	switch (filter_expr_get_type(ex)) {
+	case F_EXPR_AND:
+		return compile_logical(fltr, pg, ex, 1, cst);
+	case F_EXPR_OR:
+		return compile_logical(fltr, pg, ex, 0, cst);
+	case F_EXPR_NEG:
+		rc = compile_node(fltr, pg, filter_expr_get_right(ex), cst);
+		if (rc || *cst != F_PROG_CODE) {
+			*cst = !*cst;
+			return rc;
+		}
+		if (!prog_add(pg, F_OP_NOT))
+			return -ENOMEM;
+		return 0;
+	default:
+		break;
+	}
+
+	return compile_compare(fltr, pg, ex, cst);
+}
+
+void filter_free_prog(struct libscols_filter *fltr)
+{
+	struct filter_prog *pg = fltr->prog;
+
+	fltr->noprog = 0;
+	if (!pg)
+		return;
+
+	while (pg->ninsns)
+		prog_pop(pg);
+	free(pg->insns);
+	free(pg);
+	fltr->prog = NULL;
+}
+
+/*
+ * Compiles the filter expression. The holder data types have to be already
+ * initialized by filter_param_reset_holder().
+ */
+int filter_compile_prog(struct libscols_filter *fltr)
+{
+	struct filter_insn *in;
+	int rc, cst = 0;
+
+	filter_free_prog(fltr);
+	if (!fltr->root)
+		return 0;
+
+	fltr->prog = calloc(1, sizeof(struct filter_prog));
+	if (!fltr->prog)
+		return -ENOMEM;
+
+	rc = compile_node(fltr, fltr->prog, fltr->root, &cst);
+	if (!rc && cst != F_PROG_CODE) {
+		in = prog_add(fltr->prog, F_OP_CONST);
+		if (in)
+			in->status = cst;
+		else
+			rc = -ENOMEM;
+	}
+
+	if (rc) {
+		DBG_OBJ(FLTR, fltr, ul_debug("failed to compile [rc=%d]", rc));
+		filter_free_prog(fltr);
+		fltr->noprog = 1;
+		return rc;
+	}
+
+	DBG_OBJ(FLTR, fltr, ul_debug("compiled [%zu instructions]", fltr->prog->ninsns));
+	return 0;
+}
+
+static int run_compare(struct libscols_filter *fltr, struct libscols_line *ln,
+		       struct filter_insn *in, int *status)
+{
+	struct filter_param *l = NULL, *r = NULL;
+	int rc;
+
+	rc = filter_cast_param(fltr, ln, in->type, in->l, &l);
+	if (!rc)
+		rc = filter_cast_param(fltr, ln, in->type, in->r, &r);
+	if (!rc)
+		rc = filter_compare_params(fltr, in->oper, l, r, status);
+
+	filter_unref_node((struct filter_node *) l);
+	filter_unref_node((struct filter_node *) r);
+	return rc;
+}
+
+int filter_run_prog(struct libscols_filter *fltr, struct libscols_line *ln,
+		    int *status)
+{
+	struct filter_prog *pg = fltr->prog;
+	size_t i = 0;
+	int rc = 0;
+
+	*status = 0;
+
+	while (rc == 0 && i < pg->ninsns) {
+		struct filter_insn *in = &pg->insns[i++];
+
+		switch (in->op) {
+		case F_OP_CONST:
+			*status = in->status;
+			break;
+		case F_OP_TEST:
+			rc = filter_eval_param(fltr, ln, in->l, status);
+			break;
+		case F_OP_CMP:
+			rc = run_compare(fltr, ln, in, status);
+			break;
+		case F_OP_NOT:
+			*status = !*status;
+			break;
+		case F_OP_JMPF:
+			if (!*status)
+				i = in->jmp;
+			break;
+		case F_OP_JMPT:
+			if (*status)
+				i = in->jmp;
+			break;
+		case F_OP_STORE:
+			filter_param_set_boolean(in->l, *status != 0);
+			break;
+		}
+	}
+
+	return rc;
+}
@@ -73,6 +73,7 @@ static void reset_filter(struct libscols_filter *fltr)
 {
 	if (!fltr)
 		return;
+	filter_free_prog(fltr);
 	filter_unref_node(fltr->root);
 	fltr->root = NULL;
 
@@ -300,7 +301,13 @@ int scols_line_apply_filter(struct libscols_line *ln,
 		filter_param_reset_holder(prm);
 	}
 
-	if (fltr->root)
+	/* compile on the first line, the holders data types are known now */
+	if (fltr->root && !fltr->prog && !fltr->noprog)
+		filter_compile_prog(fltr);
+
+	if (fltr->prog)
+		rc = filter_run_prog(fltr, ln, &res);
+	else if (fltr->root)
 		rc = filter_eval_node(fltr, ln, fltr->root, &res);
 	else
 		rc = 0, res = 1;	/* empty filter matches all lines */
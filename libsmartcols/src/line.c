@@ -79,6 +79,7 @@ void scols_unref_line(struct libscols_line *ln)
 		list_del(&ln->ln_groups);
 		scols_unref_group(ln->group);
 		scols_line_free_cells(ln);
+		scols_unref_arena(ln->arena);
 		free(ln->color);
 		free(ln);
 		return;
@@ -504,6 +505,27 @@ int scols_line_refer_data(struct libscols_line *ln, size_t n, char *data)
 	return scols_cell_refer_data(ce, data);
 }
 
+/**
+ * scols_line_refer_static_data:
+ * @ln: a pointer to a struct libscols_line instance
+ * @n: number of the cell which will refer to @data
+ * @data: string literal or data owned by application
+ *
+ * See scols_cell_refer_static_data().
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: 2.44
+ */
+int scols_line_refer_static_data(struct libscols_line *ln, size_t n, const char *data)
+{
+	struct libscols_cell *ce = scols_line_get_cell(ln, n);
+
+	if (!ce)
+		return -EINVAL;
+	return scols_cell_refer_static_data(ce, data);
+}
+
 /**
  * scols_line_vprintf:
  * @ln: a pointer to a struct libscols_line instance
@@ -525,6 +547,15 @@ int scols_line_vprintf(struct libscols_line *ln, size_t n,
 	if (!ce)
 		return -EINVAL;
 
+	if (ce->arena) {
+		ret = scols_arena_vasprintf(ce->arena, &data, fmt, ap);
+		if (ret < 0)
+			return ret;
+		ret = scols_cell_refer_data(ce, data);
+		ce->data_nofree = 1;
+		return ret;
+	}
+
 	if (vasprintf(&data, fmt, ap) < 0)
 		return errno ? -errno : -ENOMEM;
 
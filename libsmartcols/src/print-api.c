@@ -143,6 +143,112 @@ int scols_table_calculate(struct libscols_table *tb)
 	return rc;
 }
 
+/* default number of lines used to calculate column widths for streamed output */
+#define SCOLS_STREAM_SAMPLE	64
+
+static int stream_start(struct libscols_table *tb)
+{
+	int rc;
+
+	DBG_OBJ(TAB, tb, ul_debug("stream: start [sample=%zu lines]", tb->nlines));
+
+	tb->header_printed = 0;
+	tb->stream_nlines = 0;
+
+	rc = __scols_initialize_printing(tb, &tb->stream_buf);
+	if (rc)
+		return rc;
+
+	tb->is_calculated = 1;
+	tb->stream_started = 1;
+
+	if (scols_table_is_json(tb) && tb->json_format != UL_JSON_LINE) {
+		ul_jsonwrt_root_open(&tb->json);
+		ul_jsonwrt_array_open(&tb->json, tb->name ? tb->name : "");
+	}
+
+	if (tb->format == SCOLS_FMT_HUMAN)
+		__scols_print_title(tb);
+
+	return __scols_print_header(tb, &tb->stream_buf);
+}
+
+/* prints and removes all lines from the table */
+static int stream_flush(struct libscols_table *tb)
+{
+	int rc = 0;
+
+	while (rc == 0 && !list_empty(&tb->tb_lines)) {
+		struct libscols_line *ln = list_entry(tb->tb_lines.next,
+					struct libscols_line, ln_lines);
+
+		if (tb->format == SCOLS_FMT_HUMAN
+		    && tb->stream_reflow == SCOLS_REFLOW_GROW)
+			rc = __scols_calculate_line(tb, ln, &tb->stream_buf);
+		if (!rc)
+			rc = __scols_print_stream_line(tb, &tb->stream_buf, ln);
+
+		scols_table_remove_line(tb, ln);
+	}
+	return rc;
+}
+
+static int stream_end(struct libscols_table *tb)
+{
+	int rc = 0;
+
+	if (!tb->stream_started)
+		rc = stream_start(tb);
+	if (!rc)
+		rc = stream_flush(tb);
+
+	if (tb->stream_started && scols_table_is_json(tb)) {
+		if (tb->json_format != UL_JSON_LINE) {
+			ul_jsonwrt_array_close(&tb->json);
+			ul_jsonwrt_root_close(&tb->json);
+		} else {
+			fputc('\n', tb->out);	/* trailing newline after last object */
+		}
+	}
+
+	DBG_OBJ(TAB, tb, ul_debug("stream: end [%zu lines, rc=%d]", tb->stream_nlines, rc));
+
+	__scols_cleanup_printing(tb, &tb->stream_buf);
+	tb->stream_started = 0;
+	tb->stream_nlines = 0;
+	tb->is_calculated = 0;
+	return rc;
+}
+
+/*
+ * Private API, called by scols_table_add_line() before a new line is added.
+ * All the lines in the table are complete now, so we can print them.
+ */
+int __scols_stream_lines(struct libscols_table *tb)
+{
+	int rc;
+
+	if (!tb->is_streaming
+	    || scols_table_is_tree(tb)
+	    || list_empty(&tb->tb_columns)
+	    || list_empty(&tb->tb_lines))
+		return 0;
+
+	if (!tb->stream_started) {
+		size_t sample = tb->stream_sample ?: SCOLS_STREAM_SAMPLE;
+
+		/* only human-readable output needs column widths */
+		if (tb->format == SCOLS_FMT_HUMAN && tb->nlines < sample)
+			return 0;
+
+		rc = stream_start(tb);
+		if (rc)
+			return rc;
+	}
+
+	return stream_flush(tb);
+}
+
 static int do_print_table(struct libscols_table *tb, int *is_empty)
 {
 	int rc = 0;
@@ -159,6 +265,10 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 		DBG_OBJ(TAB, tb, ul_debug("error -- no columns"));
 		return -EINVAL;
 	}
+	if (tb->stream_started
+	    || (tb->is_streaming && !scols_table_is_tree(tb)
+		&& !list_empty(&tb->tb_lines)))
+		return stream_end(tb);
 	if (list_empty(&tb->tb_lines)) {
 		DBG_OBJ(TAB, tb, ul_debug("ignore -- no lines"));
 		if (scols_table_is_json(tb)) {
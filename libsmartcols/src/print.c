@@ -1141,6 +1141,40 @@ int __scols_print_range(struct libscols_table *tb,
 
 }
 
+/*
+ * Prints @ln as the next line of the streamed output, the line separator is
+ * printed before the line, because we don't know if another line follows.
+ */
+int __scols_print_stream_line(struct libscols_table *tb,
+			      struct ul_buffer *buf,
+			      struct libscols_line *ln)
+{
+	int rc;
+
+	assert(tb);
+	assert(ln);
+
+	if (tb->stream_nlines) {
+		if (!scols_table_is_json(tb) && tb->no_linesep == 0) {
+			fputs(linesep(tb), tb->out);
+			tb->termlines_used++;
+		}
+		if (want_repeat_header(tb))
+			__scols_print_header(tb, buf);
+	}
+
+	if (scols_table_is_json(tb))
+		ul_jsonwrt_object_open(&tb->json, NULL);
+
+	rc = print_line(tb, ln, buf);
+
+	if (scols_table_is_json(tb))
+		ul_jsonwrt_object_close(&tb->json);
+
+	tb->stream_nlines++;
+	return rc;
+}
+
 int __scols_print_table(struct libscols_table *tb, struct ul_buffer *buf)
 {
 	struct libscols_iter itr;
@@ -88,15 +88,39 @@ struct libscols_cell {
 	int	flags;
 	size_t	width;
 
+	struct libscols_arena_column *arena;	/* storage for strings or NULL */
+
 	unsigned int is_filled : 1,
-		     no_uri : 1;
+		     no_uri : 1,
+		     data_nofree : 1,	/* data[] in arena or static */
+		     color_nofree : 1,
+		     uri_nofree : 1,
+		     width_valid : 1,	/* width is valid for the current data */
+		     width_noencoding : 1; /* width counted by mbs_width() */
 };
 
 extern int scols_line_move_cells(struct libscols_line *ln, size_t newn, size_t oldn);
 
+/*
+ * arena.c
+ */
+struct libscols_arena;
+struct libscols_arena_column;
+
+extern struct libscols_arena *scols_new_arena(void);
+extern void scols_ref_arena(struct libscols_arena *ar);
+extern void scols_unref_arena(struct libscols_arena *ar);
+extern struct libscols_arena_column *scols_arena_get_column(struct libscols_arena *ar, size_t n);
+extern char *scols_arena_strdup(struct libscols_arena_column *acol, const char *str);
+extern int scols_arena_vasprintf(struct libscols_arena_column *acol, char **res,
+				 const char *fmt, va_list ap);
+
 struct libscols_wstat {
 	size_t	width_min;
 	size_t	width_max;
+	size_t	width_sum;		/* sum of the cells width */
+	double	width_sum_sqr;		/* sum of the squared cells width */
+	size_t	ncells;
 	double	width_avg;
 	double  width_sqr_sum;
 	double  width_deviation;
@@ -202,6 +226,7 @@ struct libscols_line {
 
 	struct libscols_cell	*cells;		/* array with data */
 	size_t			ncells;		/* number of cells */
+	struct libscols_arena	*arena;		/* storage for cells strings */
 
 	struct list_head	ln_lines;	/* member of table->tb_lines */
 	struct list_head	ln_branch;	/* head of line->ln_children */
@@ -269,6 +294,13 @@ struct libscols_table {
 
 	enum ul_json_format json_format;	/* JSON output format */
 
+	size_t	stream_sample;	/* number of lines to calculate widths (streaming) */
+	size_t	stream_nlines;	/* number of already streamed lines */
+	int	stream_reflow;	/* SCOLS_REFLOW_* */
+	struct ul_buffer stream_buf;	/* printing buffer kept between streamed lines */
+
+	struct libscols_arena *arena;	/* storage for cells strings or NULL */
+
 	/* flags */
 	bool		ascii	      ,	/* don't use unicode */
 			colors_wanted ,	/* enable colors */
@@ -286,7 +318,9 @@ struct libscols_table {
 			no_encode     ,	/* don't care about control and non-printable chars */
 			no_linesep    ,	/* don't print line separator */
 			no_wrap	      ,	/* never wrap lines */
-			is_calculated ;	/* column widths already calculated */
+			is_calculated ,	/* column widths already calculated */
+			is_streaming  ,	/* print lines when added */
+			stream_started;	/* streamed output already initialized */
 };
 
 #define IS_ITER_FORWARD(_i)	((_i)->direction == SCOLS_ITER_FORWARD)
@@ -349,6 +383,11 @@ int scols_table_set_cursor(struct libscols_table *tb,
 #define scols_table_reset_cursor(_t)	scols_table_set_cursor((_t), NULL, NULL, NULL)
 
 
+/*
+ * sort.c
+ */
+int __scols_sort_lines(struct libscols_column *cl, struct list_head *head, int children);
+
 /*
  * grouping.c
  */
@@ -377,6 +416,9 @@ extern int scols_walk_is_last(struct libscols_table *tb, struct libscols_line *l
  * calculate.c
  */
 extern int __scols_calculate(struct libscols_table *tb, struct ul_buffer *buf);
+extern int __scols_calculate_line(struct libscols_table *tb,
+				  struct libscols_line *ln,
+				  struct ul_buffer *buf);
 
 /*
  * print.c
@@ -395,6 +437,14 @@ int __scols_print_range(struct libscols_table *tb,
                         struct ul_buffer *buf,
                         struct libscols_iter *itr,
                         struct libscols_line *end);
+int __scols_print_stream_line(struct libscols_table *tb,
+			      struct ul_buffer *buf,
+			      struct libscols_line *ln);
+
+/*
+ * print-api.c
+ */
+int __scols_stream_lines(struct libscols_table *tb);
 
 static inline int is_tree_root(struct libscols_line *ln)
 {
@@ -534,6 +584,7 @@ struct filter_node {
 
 struct filter_param;
 struct filter_expr;
+struct filter_prog;
 
 struct libscols_counter {
 	char *name;
@@ -560,8 +611,11 @@ struct libscols_filter {
 	struct list_head params;
 	struct list_head counters;
 
+	struct filter_prog *prog;	/* compiled root, see filter-prog.c */
+
 	size_t parse_nodes;
-	unsigned int parsing : 1;
+	unsigned int parsing : 1,
+		     noprog : 1;	/* failed to compile, use the tree */
 };
 
 #define SCOLS_FILTER_MAX_EXPRSZ	1024
@@ -601,6 +655,7 @@ int filter_cast_param(struct libscols_filter *fltr,
                       struct filter_param **result);
 
 int is_filter_holder_node(struct filter_node *n);
+void filter_param_set_boolean(struct filter_param *n, bool x);
 
 int filter_count_param(struct libscols_filter *fltr,
                 struct libscols_line *ln,
@@ -611,6 +666,15 @@ void filter_free_expr(struct filter_expr *n);
 void filter_dump_expr(struct ul_jsonwrt *json, struct filter_expr *n);
 int filter_eval_expr(struct libscols_filter *fltr, struct libscols_line *ln,
 			struct filter_expr *n, int *status);
+enum filter_etype filter_expr_get_type(struct filter_expr *n);
+struct filter_node *filter_expr_get_left(struct filter_expr *n);
+struct filter_node *filter_expr_get_right(struct filter_expr *n);
+int filter_expr_get_datatype(struct filter_expr *n);
+
+/* prog */
+int filter_compile_prog(struct libscols_filter *fltr);
+int filter_run_prog(struct libscols_filter *fltr, struct libscols_line *ln, int *status);
+void filter_free_prog(struct libscols_filter *fltr);
 
 /* required by parser */
 struct filter_node *filter_new_param(struct libscols_filter *filter,
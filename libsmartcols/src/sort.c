@@ -0,0 +1,330 @@
+/*
+ * sort.c - sort lines by precomputed keys
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The generic scols_sort_table() calls the column cmpfunc() for each
+ * comparison, which usually means strcoll() or string to number conversion
+ * O(n log n) times. If the sort order is known to the library (the column
+ * uses scols_cmpstr_cells() or it has no cmpfunc() but a data type), the
+ * sort key is extracted only once per line to an array, the array is sorted
+ * (radix sort for numbers), and the list of the lines is relinked.
+ *
+ * The strings are compared by strcmp() of strxfrm() keys, which is the same
+ * order as strcoll(). Lines without data (or with data which cannot be
+ * converted to the column type) are sorted first. The sort is stable.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+
+#include "rpmatch.h"
+#include "cctype.h"
+#include "smartcolsP.h"
+
+/* use qsort() rather than radix sort for small lists */
+#define SCOLS_RADIX_MINSZ	64
+
+struct sortkey {
+	union {
+		uint64_t	num;
+		long double	fnum;
+		const char	*str;
+	} key;
+	size_t	idx;		/* original position */
+};
+
+struct sortdata {
+	struct libscols_line	**lines;
+	struct sortkey		*keys;
+	size_t			nlines;
+	size_t			nempty;	/* keys without data at the begin of keys[] */
+
+	char			*xfrm;	/* strxfrm() keys */
+};
+
+/* Returns SCOLS_DATA_* type of the sort keys, or SCOLS_DATA_NONE */
+static int get_sort_type(struct libscols_column *cl)
+{
+	if (cl->cmpfunc == scols_cmpstr_cells)
+		return SCOLS_DATA_STRING;
+	if (cl->cmpfunc)
+		return SCOLS_DATA_NONE;		/* unknown order */
+	return cl->data_type;
+}
+
+static inline int use_datafunc(struct libscols_column *cl)
+{
+	return !cl->cmpfunc && cl->datafunc;
+}
+
+static int is_c_collation(void)
+{
+	const char *lc = setlocale(LC_COLLATE, NULL);
+
+	return !lc || strcmp(lc, "C") == 0 || strcmp(lc, "POSIX") == 0;
+}
+
+/* Returns string to sort @ln */
+static const char *get_cell_str(struct libscols_column *cl, struct libscols_line *ln)
+{
+	struct libscols_cell *ce = scols_line_get_cell(ln, cl->seqnum);
+
+	if (!ce)
+		return NULL;
+	if (use_datafunc(cl))
+		return cl->datafunc(cl, ce, cl->datafunc_data);
+	return scols_cell_get_data(ce);
+}
+
+/* Returns 0 if the key is defined, 1 for the empty key */
+static int get_key(struct libscols_column *cl, int type,
+		   struct libscols_line *ln, struct sortkey *k)
+{
+	struct libscols_cell *ce;
+	const char *str;
+	void *data;
+
+	if (type == SCOLS_DATA_STRING) {
+		k->key.str = get_cell_str(cl, ln);
+		return k->key.str ? 0 : 1;
+	}
+
+	ce = scols_line_get_cell(ln, cl->seqnum);
+	if (!ce)
+		return 1;
+
+	if (use_datafunc(cl)) {
+		data = cl->datafunc(cl, ce, cl->datafunc_data);
+		if (!data)
+			return 1;
+		switch (type) {
+		case SCOLS_DATA_U64:
+			k->key.num = *((unsigned long long *) data);
+			break;
+		case SCOLS_DATA_FLOAT:
+			k->key.fnum = *((long double *) data);
+			break;
+		case SCOLS_DATA_BOOLEAN:
+			k->key.num = *((bool *) data) ? 1 : 0;
+			break;
+		}
+		return 0;
+	}
+
+	str = scols_cell_get_data(ce);
+	if (!str || !*str)
+		return 1;
+
+	switch (type) {
+	case SCOLS_DATA_U64:
+		if (ul_strtou64(str, &k->key.num, 10) != 0)
+			return 1;
+		break;
+	case SCOLS_DATA_FLOAT:
+		if (ul_strtold(str, &k->key.fnum) != 0
+		    || k->key.fnum != k->key.fnum)	/* NaN */
+			return 1;
+		break;
+	case SCOLS_DATA_BOOLEAN:
+		k->key.num = strcmp(str, "1") == 0
+			     || c_strcasecmp(str, "true") == 0
+			     || rpmatch(str) == RPMATCH_YES;
+		break;
+	}
+	return 0;
+}
+
+/* Replaces strings by strxfrm() keys */
+static int xfrm_keys(struct sortdata *sd)
+{
+	size_t i, off = 0, sz = 0;
+
+	for (i = sd->nempty; i < sd->nlines; i++)
+		sz += strxfrm(NULL, sd->keys[i].key.str, 0) + 1;
+
+	sd->xfrm = malloc(sz ? sz : 1);
+	if (!sd->xfrm)
+		return -ENOMEM;
+
+	for (i = sd->nempty; i < sd->nlines; i++) {
+		struct sortkey *k = &sd->keys[i];
+		char *x = sd->xfrm + off;
+
+		off += strxfrm(x, k->key.str, sz - off) + 1;
+		k->key.str = x;
+	}
+	return 0;
+}
+
+static int cmp_str_keys(const void *a, const void *b)
+{
+	const struct sortkey *x = a, *y = b;
+	int rc = strcmp(x->key.str, y->key.str);
+
+	if (rc)
+		return rc;
+	return x->idx < y->idx ? -1 : 1;
+}
+
+static int cmp_float_keys(const void *a, const void *b)
+{
+	const struct sortkey *x = a, *y = b;
+
+	if (x->key.fnum != y->key.fnum)
+		return x->key.fnum < y->key.fnum ? -1 : 1;
+	return x->idx < y->idx ? -1 : 1;
+}
+
+static int cmp_num_keys(const void *a, const void *b)
+{
+	const struct sortkey *x = a, *y = b;
+
+	if (x->key.num != y->key.num)
+		return x->key.num < y->key.num ? -1 : 1;
+	return x->idx < y->idx ? -1 : 1;
+}
+
+/* LSD radix sort, stable */
+static int radix_sort(struct sortkey *keys, size_t n)
+{
+	struct sortkey *tmp, *src = keys, *dst;
+	size_t count[256];
+	unsigned int shift;
+
+	tmp = malloc(n * sizeof(struct sortkey));
+	if (!tmp)
+		return -ENOMEM;
+	dst = tmp;
+
+	for (shift = 0; shift < 64; shift += 8) {
+		size_t i, sum = 0;
+
+		memset(count, 0, sizeof(count));
+		for (i = 0; i < n; i++)
+			count[(src[i].key.num >> shift) & 0xff]++;
+
+		/* the same byte in all keys */
+		if (count[(src[0].key.num >> shift) & 0xff] == n)
+			continue;
+
+		for (i = 0; i < 256; i++) {
+			size_t c = count[i];
+
+			count[i] = sum;
+			sum += c;
+		}
+		for (i = 0; i < n; i++)
+			dst[count[(src[i].key.num >> shift) & 0xff]++] = src[i];
+
+		dst = src;
+		src = src == keys ? tmp : keys;
+	}
+
+	if (src != keys)
+		memcpy(keys, src, n * sizeof(struct sortkey));
+	free(tmp);
+	return 0;
+}
+
+/*
+ * Sorts lines in the list @head by the precomputed keys. The @children
+ * means that the list is ln_children list (tree), otherwise ln_lines.
+ *
+ * Returns: 0 on success, 1 if the column order is unknown (use cmpfunc()),
+ *          or <0 on error.
+ */
+int __scols_sort_lines(struct libscols_column *cl, struct list_head *head, int children)
+{
+	struct sortdata sd = { .nlines = 0 };
+	struct sortkey *keys;
+	struct list_head *p;
+	size_t i, n = 0;
+	int type, rc = 0;
+
+	type = get_sort_type(cl);
+	switch (type) {
+	case SCOLS_DATA_STRING:
+	case SCOLS_DATA_U64:
+	case SCOLS_DATA_FLOAT:
+	case SCOLS_DATA_BOOLEAN:
+		break;
+	default:
+		return 1;
+	}
+
+	list_for_each(p, head)
+		n++;
+	if (n < 2)
+		return 0;
+
+	sd.lines = malloc(n * sizeof(struct libscols_line *));
+	sd.keys = malloc(n * sizeof(struct sortkey));
+	if (!sd.lines || !sd.keys) {
+		rc = -ENOMEM;
+		goto done;
+	}
+
+	/* extract keys; empty keys first, both parts in the original order */
+	list_for_each(p, head) {
+		struct libscols_line *ln = children ?
+				list_entry(p, struct libscols_line, ln_children) :
+				list_entry(p, struct libscols_line, ln_lines);
+		struct sortkey k;
+
+		sd.lines[sd.nlines] = ln;
+		k.idx = sd.nlines++;
+
+		if (get_key(cl, type, ln, &k) == 0)
+			sd.keys[n - 1 - (k.idx - sd.nempty)] = k;
+		else
+			sd.keys[sd.nempty++] = k;
+	}
+
+	/* the non-empty keys are in reverse order at the end of the array */
+	keys = sd.keys + sd.nempty;
+	n = sd.nlines - sd.nempty;
+	for (i = 0; i < n / 2; i++) {
+		struct sortkey x = keys[i];
+
+		keys[i] = keys[n - 1 - i];
+		keys[n - 1 - i] = x;
+	}
+
+	switch (type) {
+	case SCOLS_DATA_STRING:
+		if (!is_c_collation()) {
+			rc = xfrm_keys(&sd);
+			if (rc)
+				goto done;
+		}
+		qsort(keys, n, sizeof(struct sortkey), cmp_str_keys);
+		break;
+	case SCOLS_DATA_FLOAT:
+		qsort(keys, n, sizeof(struct sortkey), cmp_float_keys);
+		break;
+	case SCOLS_DATA_U64:
+	case SCOLS_DATA_BOOLEAN:
+		if (n < SCOLS_RADIX_MINSZ)
+			qsort(keys, n, sizeof(struct sortkey), cmp_num_keys);
+		else
+			rc = radix_sort(keys, n);
+		if (rc)
+			goto done;
+		break;
+	}
+
+	/* relink */
+	INIT_LIST_HEAD(head);
+	for (i = 0; i < sd.nlines; i++) {
+		struct libscols_line *ln = sd.lines[sd.keys[i].idx];
+
+		list_add_tail(children ? &ln->ln_children : &ln->ln_lines, head);
+	}
+done:
+	free(sd.xfrm);
+	free(sd.keys);
+	free(sd.lines);
+	return rc;
+}
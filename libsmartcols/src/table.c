@@ -147,6 +147,8 @@ void scols_unref_table(struct libscols_table *tb)
 		scols_table_remove_columns(tb);
 		scols_unref_symbols(tb->symbols);
 		scols_reset_cell(&tb->title);
+		scols_unref_arena(tb->arena);
+		ul_buffer_free_data(&tb->stream_buf);
 		free(tb->grpset);
 		free(tb->linesep);
 		free(tb->colsep);
@@ -223,6 +225,32 @@ struct libscols_cell *scols_table_get_title(struct libscols_table *tb)
 	return &tb->title;
 }
 
+/* Use the table arena for the line cells. The line keeps the arena
+ * referenced, so it's possible to use the line after the table is gone. */
+static int line_use_arena(struct libscols_table *tb, struct libscols_line *ln)
+{
+	size_t i;
+
+	if (!tb->arena || (ln->arena && ln->arena != tb->arena))
+		return 0;
+
+	for (i = 0; i < ln->ncells; i++) {
+		struct libscols_cell *ce = &ln->cells[i];
+
+		if (ce->arena)
+			continue;
+		ce->arena = scols_arena_get_column(tb->arena, i);
+		if (!ce->arena)
+			return -ENOMEM;
+	}
+
+	if (!ln->arena) {
+		ln->arena = tb->arena;
+		scols_ref_arena(ln->arena);
+	}
+	return 0;
+}
+
 /**
  * scols_table_add_column:
  * @tb: a pointer to a struct libscols_table instance
@@ -263,6 +291,8 @@ int scols_table_add_column(struct libscols_table *tb, struct libscols_column *cl
 	 */
 	while (scols_table_next_line(tb, &itr, &ln) == 0) {
 		rc = scols_line_alloc_cells(ln, tb->ncols);
+		if (!rc)
+			rc = line_use_arena(tb, ln);
 		if (rc)
 			break;
 	}
@@ -742,6 +772,18 @@ int scols_table_add_line(struct libscols_table *tb, struct libscols_line *ln)
 			return rc;
 	}
 
+	if (tb->arena) {
+		int rc = line_use_arena(tb, ln);
+		if (rc)
+			return rc;
+	}
+
+	if (tb->is_streaming) {
+		int rc = __scols_stream_lines(tb);
+		if (rc)
+			return rc;
+	}
+
 	DBG_OBJ(TAB, tb, ul_debug("add line"));
 	list_add_tail(&ln->ln_lines, &tb->tb_lines);
 	ln->seqnum = tb->nlines++;
@@ -1408,6 +1450,141 @@ int scols_table_is_noencoding(const struct libscols_table *tb)
 	return tb->no_encode;
 }
 
+/**
+ * scols_table_enable_streaming:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Print lines as soon as they are complete, rather than keeping all of them
+ * in memory until scols_print_table(). A line is complete when the next line
+ * is added to the table; the printed line is removed from the table. The
+ * last lines and the end of the output are printed by scols_print_table().
+ *
+ * The column widths for the human-readable output are calculated from the
+ * first lines only (see scols_table_set_streaming_sample()). JSON, raw and
+ * export outputs do not need any lookahead.
+ *
+ * The streaming is not supported for trees, and the lines cannot be sorted.
+ * The output stream has to be set before the first line is added.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.44
+ */
+int scols_table_enable_streaming(struct libscols_table *tb, int enable)
+{
+	if (!tb || tb->stream_started)
+		return -EINVAL;
+	DBG_OBJ(TAB, tb, ul_debug("streaming: %s", enable ? "ENABLE" : "DISABLE"));
+	tb->is_streaming = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * scols_table_is_streaming:
+ * @tb: a pointer to a struct libscols_table instance
+ *
+ * Returns: 1 if streaming is enabled.
+ *
+ * Since: 2.44
+ */
+int scols_table_is_streaming(const struct libscols_table *tb)
+{
+	return tb->is_streaming;
+}
+
+/**
+ * scols_table_set_streaming_sample:
+ * @tb: table
+ * @nlines: number of lines or 0 for the default
+ *
+ * Sets the number of lines kept in memory to calculate column widths for
+ * streamed human-readable output. The default is 64 lines.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.44
+ */
+int scols_table_set_streaming_sample(struct libscols_table *tb, size_t nlines)
+{
+	if (!tb || tb->stream_started)
+		return -EINVAL;
+	tb->stream_sample = nlines;
+	return 0;
+}
+
+/**
+ * scols_table_set_streaming_reflow:
+ * @tb: table
+ * @reflow: SCOLS_REFLOW_NONE or SCOLS_REFLOW_GROW
+ *
+ * Defines what happens if streamed data do not fit into the column widths
+ * calculated from the first lines. The default is SCOLS_REFLOW_NONE, which keeps
+ * the widths (the data are truncated for columns with SCOLS_FL_TRUNC). The
+ * SCOLS_REFLOW_GROW enlarges the columns for the following lines; the
+ * already printed lines are not aligned with the new width.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.44
+ */
+int scols_table_set_streaming_reflow(struct libscols_table *tb, int reflow)
+{
+	if (!tb || (reflow != SCOLS_REFLOW_NONE && reflow != SCOLS_REFLOW_GROW))
+		return -EINVAL;
+	tb->stream_reflow = reflow;
+	return 0;
+}
+
+/**
+ * scols_table_enable_arena:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Allocate cell strings (data, colors and URIs copied by the library) from
+ * per-column memory chunks rather than by malloc() for each string. The
+ * memory is deallocated all at once when the table and all the lines are
+ * deallocated, so the memory used by overwritten or reset cells is not
+ * reused. This is recommended for large tables which are filled once and
+ * printed; it's not suitable for streaming or for tables with frequently
+ * updated lines.
+ *
+ * The setting affects only lines added to the table later.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.44
+ */
+int scols_table_enable_arena(struct libscols_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+
+	DBG_OBJ(TAB, tb, ul_debug("arena: %s", enable ? "ENABLE" : "DISABLE"));
+	if (enable && !tb->arena) {
+		tb->arena = scols_new_arena();
+		if (!tb->arena)
+			return -ENOMEM;
+	} else if (!enable && tb->arena) {
+		scols_unref_arena(tb->arena);
+		tb->arena = NULL;
+	}
+	return 0;
+}
+
+/**
+ * scols_table_is_arena:
+ * @tb: a pointer to a struct libscols_table instance
+ *
+ * Returns: 1 if cell strings are allocated from the table arena.
+ *
+ * Since: 2.44
+ */
+int scols_table_is_arena(const struct libscols_table *tb)
+{
+	return tb->arena ? 1 : 0;
+}
+
 /**
  * scols_table_colors_wanted:
  * @tb: table
@@ -1637,9 +1814,28 @@ static int cells_cmp_wrapper_children(struct list_head *a, struct list_head *b,
 }
 
 
+static inline int has_sort_order(struct libscols_column *cl)
+{
+	return cl->cmpfunc || cl->data_type != SCOLS_DATA_NONE;
+}
+
+static int sort_lines(struct list_head *head, struct libscols_column *cl, int children)
+{
+	int rc = __scols_sort_lines(cl, head, children);
+
+	/* unknown order or error; try the generic way */
+	if (rc != 0 && cl->cmpfunc) {
+		list_sort(head, children ? cells_cmp_wrapper_children :
+					   cells_cmp_wrapper_lines, cl);
+		rc = 0;
+	}
+	return rc;
+}
+
 static int sort_line_children(struct libscols_line *ln, struct libscols_column *cl)
 {
 	struct list_head *p;
+	int rc = 0;
 
 	if (!list_empty(&ln->ln_branch)) {
 		list_for_each(p, &ln->ln_branch) {
@@ -1648,20 +1844,20 @@ static int sort_line_children(struct libscols_line *ln, struct libscols_column *
 			sort_line_children(chld, cl);
 		}
 
-		list_sort(&ln->ln_branch, cells_cmp_wrapper_children, cl);
+		rc = sort_lines(&ln->ln_branch, cl, 1);
 	}
 
-	if (is_first_group_member(ln)) {
+	if (rc == 0 && is_first_group_member(ln)) {
 		list_for_each(p, &ln->group->gr_children) {
 			struct libscols_line *chld =
 					list_entry(p, struct libscols_line, ln_children);
 			sort_line_children(chld, cl);
 		}
 
-		list_sort(&ln->group->gr_children, cells_cmp_wrapper_children, cl);
+		rc = sort_lines(&ln->group->gr_children, cl, 1);
 	}
 
-	return 0;
+	return rc;
 }
 
 static int  __scols_sort_tree(struct libscols_table *tb, struct libscols_column *cl)
@@ -1669,13 +1865,15 @@ static int  __scols_sort_tree(struct libscols_table *tb, struct libscols_column
 	struct libscols_line *ln;
 	struct libscols_iter itr;
 
-	if (!tb || !cl || !cl->cmpfunc)
+	int rc = 0;
+
+	if (!tb || !cl || !has_sort_order(cl))
 		return -EINVAL;
 
 	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
-	while (scols_table_next_line(tb, &itr, &ln) == 0)
-		sort_line_children(ln, cl);
-	return 0;
+	while (rc == 0 && scols_table_next_line(tb, &itr, &ln) == 0)
+		rc = sort_line_children(ln, cl);
+	return rc;
 }
 
 /**
@@ -1686,6 +1884,16 @@ static int  __scols_sort_tree(struct libscols_table *tb, struct libscols_column
  * Orders the table by the column. See also scols_column_set_cmpfunc(). If the
  * tree output is enabled then children in the tree are recursively sorted too.
  *
+ * If the column has no compare function, then the lines are ordered by the
+ * column data type (see scols_column_set_data_type()); the data are converted
+ * from the cell strings or returned by scols_column_set_data_func() callback.
+ * Lines without data are sorted first. Since 2.44.
+ *
+ * The library does not call the compare function for each comparison if the
+ * function is scols_cmpstr_cells() or if the data type is used. The sort keys
+ * are extracted only once per line in this case, which is significantly
+ * faster for large tables.
+ *
  * The column @cl is saved as the default sort column to the @tb and the next time
  * is possible to call scols_sort_table(tb, NULL). The saved column is also used by
  * scols_sort_table_by_tree().
@@ -1694,18 +1902,22 @@ static int  __scols_sort_tree(struct libscols_table *tb, struct libscols_column
  */
 int scols_sort_table(struct libscols_table *tb, struct libscols_column *cl)
 {
+	int rc;
+
 	if (!tb)
 		return -EINVAL;
 	if (!cl)
 		cl = tb->dflt_sort_column;
-	if (!cl || !cl->cmpfunc)
+	if (!cl || !has_sort_order(cl))
 		return -EINVAL;
 
 	DBG_OBJ(TAB, tb, ul_debug("sorting table by %zu column", cl->seqnum));
-	list_sort(&tb->tb_lines, cells_cmp_wrapper_lines, cl);
+	rc = sort_lines(&tb->tb_lines, cl, 0);
 
-	if (scols_table_is_tree(tb))
-		__scols_sort_tree(tb, cl);
+	if (rc == 0 && scols_table_is_tree(tb))
+		rc = __scols_sort_tree(tb, cl);
+	if (rc)
+		return rc;
 
 	if (cl && cl != tb->dflt_sort_column)
 		tb->dflt_sort_column = cl;
@@ -705,13 +705,8 @@ int uuid_generate_time_safe(uuid_t out)
 	return uuid_generate_time_generic(out);
 }
 
-void uuid_generate_time_v6(uuid_t out)
+static void set_time_v6(uuid_t out, uint32_t clock_high, uint32_t clock_low)
 {
-	uint32_t clock_high, clock_low;
-	uint16_t clock_seq;
-
-	get_clock(&clock_high, &clock_low, &clock_seq, NULL);
-
 	out[0] = clock_high >> 20;
 	out[1] = clock_high >> 12;
 	out[2] = clock_high >>  4;
@@ -721,31 +716,171 @@ void uuid_generate_time_v6(uuid_t out)
 	out[5] = clock_low >> 12;
 	out[6] = clock_low >>  8;
 	out[7] = clock_low >>  0;
+}
+
+void uuid_generate_time_v6(uuid_t out)
+{
+	uint32_t clock_high, clock_low;
+	uint16_t clock_seq;
+
+	get_clock(&clock_high, &clock_low, &clock_seq, NULL);
+	set_time_v6(out, clock_high, clock_low);
 
 	ul_random_get_bytes(out + 8, 8);
 	__uuid_set_variant_and_version(out, UUID_TYPE_DCE_TIME_V6);
 }
 
-// FIXME variable additional information
-void uuid_generate_time_v7(uuid_t out)
+static uint64_t get_time_v7(void)
 {
 	struct timeval tv;
-	uint64_t ms;
 
 	gettimeofday(&tv, NULL);
 
-	ms = tv.tv_sec * MSEC_PER_SEC + tv.tv_usec / USEC_PER_MSEC;
+	return tv.tv_sec * MSEC_PER_SEC + tv.tv_usec / USEC_PER_MSEC;
+}
 
+static void set_time_v7(uuid_t out, uint64_t ms)
+{
 	out[0] = ms >> 40;
 	out[1] = ms >> 32;
 	out[2] = ms >> 24;
 	out[3] = ms >> 16;
 	out[4] = ms >>  8;
 	out[5] = ms >>  0;
+}
+
+// FIXME variable additional information
+void uuid_generate_time_v7(uuid_t out)
+{
+	set_time_v7(out, get_time_v7());
 	ul_random_get_bytes(out + 6, 10);
 	__uuid_set_variant_and_version(out, UUID_TYPE_DCE_TIME_V7);
 }
 
+/*
+ * Reserve a range of @num consecutive 100ns clock ticks from uuidd or from
+ * the global clock state counter. The first tick is returned in @clock_high
+ * and @clock_low, the clock sequence and node ID in @uu.
+ *
+ * Returns the same as __uuid_generate_time().
+ */
+static int reserve_time_range(int num, uint32_t *clock_high, uint32_t *clock_low,
+			      struct uuid *uu)
+{
+	uuid_t buf;
+	int n = num, ret = 0;
+
+	if (get_uuid_via_daemon(UUIDD_OP_BULK_TIME_UUID, buf, &n) != 0) {
+		n = num;
+		ret = __uuid_generate_time(buf, &n);
+	}
+	uuid_unpack(buf, uu);
+
+	*clock_high = ((uint32_t) (uu->time_hi_and_version & 0x0FFF) << 16) | uu->time_mid;
+	*clock_low = uu->time_low;
+	return ret;
+}
+
+static int generate_time_bulk(uuid_t *out, size_t num, int type)
+{
+	uint32_t clock_high, clock_low;
+	struct uuid uu;
+	size_t i;
+	int ret;
+
+	ret = reserve_time_range((int) num, &clock_high, &clock_low, &uu);
+
+	if (type == UUID_TYPE_DCE_TIME_V6)
+		ul_random_get_bytes(out, num * sizeof(uuid_t));
+
+	for (i = 0; i < num; i++) {
+		if (type == UUID_TYPE_DCE_TIME_V6) {
+			set_time_v6(out[i], clock_high, clock_low);
+			__uuid_set_variant_and_version(out[i], UUID_TYPE_DCE_TIME_V6);
+		} else {
+			uu.time_low = clock_low;
+			uu.time_mid = (uint16_t) clock_high;
+			uu.time_hi_and_version = ((clock_high >> 16) & 0x0FFF) | 0x1000;
+			uuid_pack(&uu, out[i]);
+		}
+		if (++clock_low == 0)
+			clock_high++;
+	}
+	return ret;
+}
+
+/*
+ * The 12 bits after the v7 timestamp are used as a counter, so the UUIDs
+ * are ordered also within one millisecond. The counter starts from a random
+ * value with the most significant bit clear; on overflow the timestamp is
+ * incremented (RFC 9562, 6.2 method 1).
+ */
+static int generate_time_v7_bulk(uuid_t *out, size_t num)
+{
+	uint64_t ms = get_time_v7();
+	uint16_t counter = 0;
+	size_t i;
+	int ret = 0;
+
+	if (ul_random_get_bytes(out, num * sizeof(uuid_t)) == UL_RAND_WEAK)
+		ret = -1;
+
+	for (i = 0; i < num; i++) {
+		if (i == 0 || ++counter > 0x0FFF) {
+			if (i)
+				ms++;
+			counter = ((out[i][6] << 8) | out[i][7]) & 0x07FF;
+		}
+		set_time_v7(out[i], ms);
+		out[i][6] = counter >> 8;
+		out[i][7] = counter;
+		__uuid_set_variant_and_version(out[i], UUID_TYPE_DCE_TIME_V7);
+	}
+	return ret;
+}
+
+/*
+ * Generate @num time-based UUIDs of the given @type (UUID_TYPE_DCE_TIME,
+ * UUID_TYPE_DCE_TIME_V6 or UUID_TYPE_DCE_TIME_V7) and store them to @out.
+ *
+ * For v1 and v6, the whole range of timestamps is reserved from uuidd or the
+ * global clock state counter by one request, the UUIDs are then composed
+ * without any locking or system calls. The range has to be contiguous, the
+ * next reservation would restart at the current time (with another clock
+ * sequence) and v6 UUIDs would not be ordered. v7 UUIDs are ordered by
+ * a counter and need only one gettimeofday(). Every thread should use its
+ * own @out array.
+ *
+ * Returns 0 if the UUIDs have been generated in a safe way (see
+ * uuid_generate_time_safe()), -1 otherwise (the UUIDs are generated anyway),
+ * or -EINVAL for unsupported @type.
+ */
+int uuid_generate_time_bulk(uuid_t *out, size_t num, int type)
+{
+	int ret = 0;
+
+	switch (type) {
+	case UUID_TYPE_DCE_TIME:
+	case UUID_TYPE_DCE_TIME_V6:
+		while (num) {
+			size_t n = min(num, (size_t) INT_MAX);
+
+			if (generate_time_bulk(out, n, type))
+				ret = -1;
+			out += n;
+			num -= n;
+		}
+		break;
+	case UUID_TYPE_DCE_TIME_V7:
+		if (num)
+			ret = generate_time_v7_bulk(out, num);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return ret;
+}
+
 
 int __uuid_generate_random(uuid_t out, int *num)
 {
@@ -847,11 +982,64 @@ void uuid_generate_sha1(uuid_t out, const uuid_t ns, const char *name, size_t le
 }
 
 #ifdef TEST_PROGRAM
-int main(void)
+/* v1 UUIDs are not ordered by bytes, compare timestamps */
+static int cmp_bulk(const uuid_t a, const uuid_t b, int type)
+{
+	struct uuid x, y;
+	uint64_t tx, ty;
+
+	if (type != UUID_TYPE_DCE_TIME)
+		return memcmp(a, b, sizeof(uuid_t));
+
+	uuid_unpack(a, &x);
+	uuid_unpack(b, &y);
+	tx = ((uint64_t) (x.time_hi_and_version & 0x0FFF) << 48)
+	     | ((uint64_t) x.time_mid << 32) | x.time_low;
+	ty = ((uint64_t) (y.time_hi_and_version & 0x0FFF) << 48)
+	     | ((uint64_t) y.time_mid << 32) | y.time_low;
+	return tx < ty ? -1 : tx > ty ? 1 : 0;
+}
+
+/* the UUIDs have to be strictly ordered (so unique) and of the right type */
+static int test_bulk(int type, size_t num)
+{
+	uuid_t *uu = calloc(num, sizeof(uuid_t));
+	size_t i, bad = 0;
+
+	if (!uu)
+		return 1;
+
+	uuid_generate_time_bulk(uu, num, type);
+
+	for (i = 0; i < num; i++) {
+		if (uuid_type(uu[i]) != type
+		    || uuid_variant(uu[i]) != UUID_VARIANT_DCE
+		    || (i && cmp_bulk(uu[i - 1], uu[i], type) >= 0))
+			bad++;
+	}
+	printf("type %d, %zu UUIDs: %s\n", type, num, bad ? "FAILED" : "ok");
+	free(uu);
+	return bad ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
 {
 	char buf[UUID_STR_LEN];
 	uuid_t uuid;
 
+	if (argc == 2 && strcmp(argv[1], "--bulk") == 0) {
+		int rc = 0;
+
+		rc |= test_bulk(UUID_TYPE_DCE_TIME, CS_MAX + 1000);
+		rc |= test_bulk(UUID_TYPE_DCE_TIME_V6, CS_MAX + 1000);
+		rc |= test_bulk(UUID_TYPE_DCE_TIME_V7, 3 * 4096);	/* counter overflow */
+
+		printf("type %d: %s\n", UUID_TYPE_DCE_SECURITY,
+			uuid_generate_time_bulk(&uuid, 1, UUID_TYPE_DCE_SECURITY) == -EINVAL ?
+			"EINVAL" : "FAILED");
+		return rc;
+	}
+
 	uuid_generate_time(uuid);
 	uuid_unparse(uuid, buf);
 	printf("%s\n", buf);
@@ -97,6 +97,7 @@ extern void uuid_generate_time(uuid_t out);
 extern int uuid_generate_time_safe(uuid_t out);
 extern void uuid_generate_time_v6(uuid_t out);
 extern void uuid_generate_time_v7(uuid_t out);
+extern int uuid_generate_time_bulk(uuid_t *out, size_t num, int type);
 
 extern void uuid_generate_md5(uuid_t out, const uuid_t ns, const char *name, size_t len);
 extern void uuid_generate_sha1(uuid_t out, const uuid_t ns, const char *name, size_t len);
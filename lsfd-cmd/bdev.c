@@ -40,7 +40,7 @@ static bool bdev_fill_column(struct proc *proc __attribute__((__unused__)),
 
 	switch(column_id) {
 	case COL_TYPE:
-		if (scols_line_set_data(ln, column_index, "BLK"))
+		if (scols_line_refer_static_data(ln, column_index, "BLK"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_BLKDRV:
@@ -149,6 +149,20 @@ const char *get_partition(dev_t dev)
 	return NULL;
 }
 
+static unsigned int bdev_get_column_sources(int column_id)
+{
+	switch(column_id) {
+	case COL_TYPE:
+	case COL_BLKDRV:
+	case COL_DEVTYPE:
+	case COL_SOURCE:
+	case COL_PARTITION:
+	case COL_MAJMIN:
+		return LSFD_SRC_STAT;
+	}
+	return 0;
+}
+
 const struct file_class bdev_class = {
 	.super = &file_class,
 	.size = sizeof(struct file),
@@ -156,4 +170,5 @@ const struct file_class bdev_class = {
 	.finalize_class = bdev_class_finalize,
 	.fill_column = bdev_fill_column,
 	.free_content = NULL,
+	.get_column_sources = bdev_get_column_sources,
 };
@@ -92,7 +92,7 @@ static bool cdev_fill_column(struct proc *proc __attribute__((__unused__)),
 		}
 		return false;
 	case COL_TYPE:
-		if (scols_line_set_data(ln, column_index, "CHR"))
+		if (scols_line_refer_static_data(ln, column_index, "CHR"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_DEVTYPE:
@@ -812,6 +812,28 @@ static void cdev_inspect_target_fd(struct file *file, int fd)
 		cdev->cdev_ops->inspect_target_fd(cdev, fd);
 }
 
+static unsigned int cdev_get_column_sources(int column_id)
+{
+	switch(column_id) {
+	case COL_TYPE:
+	case COL_DEVTYPE:
+	case COL_CHRDRV:
+	case COL_SOURCE:
+	case COL_MAJMIN:
+	case COL_MISCDEV:
+		return LSFD_SRC_STAT;
+	case COL_NAME:
+	case COL_TUN_DEVNETNS:
+	case COL_TUN_IFACE:
+	case COL_SOCK_NETNS:
+	case COL_PTMX_TTY_INDEX:
+		return LSFD_SRC_FDINFO;
+	case COL_ENDPOINTS:
+		return LSFD_SRC_LSTAT | LSFD_SRC_FDINFO | LSFD_SRC_PEERS;
+	}
+	return 0;
+}
+
 const struct file_class cdev_class = {
 	.super = &file_class,
 	.size = sizeof(struct cdev),
@@ -825,4 +847,5 @@ const struct file_class cdev_class = {
 	.get_ipc_class = cdev_get_ipc_class,
 	.needs_target_fd = cdev_needs_target_fd,
 	.inspect_target_fd = cdev_inspect_target_fd,
+	.get_column_sources = cdev_get_column_sources,
 };
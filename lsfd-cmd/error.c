@@ -67,7 +67,7 @@ static bool error_fill_column(struct proc *proc __attribute__((__unused__)),
 
 	switch(column_id) {
 	case COL_TYPE:
-		if (scols_line_set_data(ln, column_index, "ERROR"))
+		if (scols_line_refer_static_data(ln, column_index, "ERROR"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_SOURCE:
@@ -91,11 +91,22 @@ static void error_file_free_content(struct file *file)
 	free(file->name);	/* NULL is acceptable.  */
 }
 
+static unsigned int error_get_column_sources(int column_id)
+{
+	switch(column_id) {
+	case COL_TYPE:
+	case COL_SOURCE:
+		return LSFD_SRC_STAT;
+	}
+	return 0;
+}
+
 static const struct file_class error_class = {
 	.super = &abst_class,
 	.size = sizeof(struct file),
 	.free_content = error_file_free_content,
 	.fill_column = error_fill_column,
+	.get_column_sources = error_get_column_sources,
 };
 
 static bool readlink_error_fill_column(struct proc *proc __attribute__((__unused__)),
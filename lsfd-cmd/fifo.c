@@ -52,7 +52,7 @@ static bool fifo_fill_column(struct proc *proc __attribute__((__unused__)),
 
 	switch(column_id) {
 	case COL_TYPE:
-		if (scols_line_set_data(ln, column_index, "FIFO"))
+		if (scols_line_refer_static_data(ln, column_index, "FIFO"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_SOURCE:
@@ -129,6 +129,18 @@ static void fifo_initialize_content(struct file *file)
 	add_endpoint(&fifo->endpoint, ipc);
 }
 
+static unsigned int fifo_get_column_sources(int column_id)
+{
+	switch(column_id) {
+	case COL_TYPE:
+	case COL_SOURCE:
+		return LSFD_SRC_STAT;
+	case COL_ENDPOINTS:
+		return LSFD_SRC_LSTAT | LSFD_SRC_PEERS;
+	}
+	return 0;
+}
+
 const struct file_class fifo_class = {
 	.super = &file_class,
 	.size = sizeof(struct fifo),
@@ -136,4 +148,5 @@ const struct file_class fifo_class = {
 	.initialize_content = fifo_initialize_content,
 	.free_content = NULL,
 	.get_ipc_class = fifo_get_ipc_class,
+	.get_column_sources = fifo_get_column_sources,
 };
@@ -221,12 +221,41 @@ static bool abst_fill_column(struct proc *proc,
 	return true;
 }
 
+static unsigned int abst_get_column_sources(int column_id)
+{
+	switch(column_id) {
+	case COL_COMMAND:
+	case COL_USER:
+	case COL_PID:
+	case COL_TID:
+	case COL_UID:
+	case COL_KTHREAD:
+		return LSFD_SRC_PROC;
+	case COL_NAME:
+	case COL_KNAME:
+	case COL_DEVTYPE:
+	case COL_FD:
+	case COL_ASSOC:
+	case COL_MAPLEN:
+		return LSFD_SRC_STAT;
+	case COL_MODE:
+		return LSFD_SRC_LSTAT;
+	case COL_XMODE:
+		return LSFD_SRC_LSTAT | LSFD_SRC_FDINFO | LSFD_SRC_PEERS;
+	case COL_POS:
+	case COL_FLAGS:
+		return LSFD_SRC_FDINFO;
+	}
+	return 0;
+}
+
 const struct file_class abst_class = {
 	.super = NULL,
 	.size = sizeof(struct file),
 	.initialize_class = abst_class_initialize,
 	.finalize_class = abst_class_finalize,
 	.fill_column = abst_fill_column,
+	.get_column_sources = abst_get_column_sources,
 };
 
 /*
@@ -417,6 +446,38 @@ static bool file_fill_column(struct proc *proc __attribute__((__unused__)),
 	return true;
 }
 
+static unsigned int file_get_column_sources(int column_id)
+{
+	switch(column_id) {
+	case COL_NAME:
+	case COL_KNAME:
+	case COL_STTYPE:
+	case COL_TYPE:
+	case COL_INODE:
+	case COL_SOURCE:
+	case COL_PARTITION:
+	case COL_DEV:
+	case COL_MAJMIN:
+	case COL_RDEV:
+	case COL_FUID:
+	case COL_SIZE:
+	case COL_NLINK:
+	case COL_DELETED:
+		return LSFD_SRC_STAT;
+	case COL_MNT_ID:
+#if defined(HAVE_STATX) && defined(HAVE_STRUCT_STATX_STX_MNT_ID)
+		return LSFD_SRC_STAT;		/* statx() */
+#else
+		return LSFD_SRC_FDINFO;
+#endif
+	case COL_MODE:
+		return LSFD_SRC_LSTAT;
+	case COL_XMODE:
+		return LSFD_SRC_LSTAT | LSFD_SRC_FDINFO | LSFD_SRC_PEERS;
+	}
+	return 0;
+}
+
 enum lock_mode {
 	LOCK_NONE,
 	READ_LOCK,
@@ -601,6 +662,7 @@ const struct file_class file_class = {
 	.fill_column = file_fill_column,
 	.handle_fdinfo = file_handle_fdinfo,
 	.free_content = file_free_content,
+	.get_column_sources = file_get_column_sources,
 };
 
 /*
@@ -730,6 +792,16 @@ static bool nsfs_file_fill_column(struct proc *proc __attribute__((__unused__)),
 	return true;
 }
 
+static unsigned int nsfs_file_get_column_sources(int column_id)
+{
+	switch (column_id) {
+	case COL_NS_NAME:
+	case COL_NS_TYPE:
+		return LSFD_SRC_STAT;
+	}
+	return 0;
+}
+
 const struct file_class nsfs_file_class = {
 	.super = &file_class,
 	.size = sizeof(struct nsfs_file),
@@ -739,6 +811,7 @@ const struct file_class nsfs_file_class = {
 	.free_content = NULL,
 	.fill_column = nsfs_file_fill_column,
 	.handle_fdinfo = NULL,
+	.get_column_sources = nsfs_file_get_column_sources,
 };
 
 /*
@@ -780,7 +853,7 @@ static bool mqueue_file_fill_column(struct proc *proc __attribute__((__unused__)
 {
 	switch (column_id) {
 	case COL_TYPE:
-		if (scols_line_set_data(ln, column_index, "mqueue"))
+		if (scols_line_refer_static_data(ln, column_index, "mqueue"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_ENDPOINTS: {
@@ -849,12 +922,24 @@ static void init_mqueue_file_content(struct file *file)
 	add_endpoint(&mqueue_file->endpoint, ipc);
 }
 
+static unsigned int mqueue_file_get_column_sources(int column_id)
+{
+	switch (column_id) {
+	case COL_TYPE:
+		return LSFD_SRC_STAT;
+	case COL_ENDPOINTS:
+		return LSFD_SRC_LSTAT | LSFD_SRC_PEERS;
+	}
+	return 0;
+}
+
 const struct file_class mqueue_file_class = {
 	.super = &file_class,
 	.size = sizeof(struct mqueue_file),
 	.initialize_content = init_mqueue_file_content,
 	.fill_column = mqueue_file_fill_column,
 	.get_ipc_class = mqueue_file_get_ipc_class,
+	.get_column_sources = mqueue_file_get_column_sources,
 };
 
 struct pidfs_file {
@@ -894,7 +979,7 @@ static bool pidfs_file_fill_column(struct proc *proc __attribute__((__unused__))
 
 	switch(column_id) {
 	case COL_TYPE:
-		if (scols_line_set_data(ln, column_index, "pidfd"))
+		if (scols_line_refer_static_data(ln, column_index, "pidfd"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_NAME:
@@ -912,6 +997,20 @@ static bool pidfs_file_fill_column(struct proc *proc __attribute__((__unused__))
 	return true;
 }
 
+static unsigned int pidfs_file_get_column_sources(int column_id)
+{
+	switch(column_id) {
+	case COL_TYPE:
+		return LSFD_SRC_STAT;
+	case COL_NAME:
+	case COL_PIDFD_COMM:
+	case COL_PIDFD_NSPID:
+	case COL_PIDFD_PID:
+		return LSFD_SRC_FDINFO;
+	}
+	return 0;
+}
+
 const struct file_class pidfs_file_class = {
 	.super = &file_class,
 	.size = sizeof(struct pidfs_file),
@@ -919,6 +1018,7 @@ const struct file_class pidfs_file_class = {
 	.handle_fdinfo = pidfs_file_handle_fdinfo,
 	.fill_column = pidfs_file_fill_column,
 	.free_content = pidfs_file_free_content,
+	.get_column_sources = pidfs_file_get_column_sources,
 };
 
 bool is_pidfs_dev(dev_t dev)
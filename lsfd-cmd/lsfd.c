@@ -41,6 +41,10 @@
 #  include <linux/kcmp.h>
 #endif
 
+#ifdef HAVE_LIBPTHREAD
+#  include <pthread.h>
+#endif
+
 /* See proc(5).
  * Defined in linux/include/linux/sched.h private header file. */
 #define PF_KTHREAD		0x00200000	/* I am a kernel thread */
@@ -650,14 +654,23 @@ struct lsfd_control {
 			show_main : 1,		/* print main table */
 			show_summary : 1,	/* print summary/counters */
 			sockets_only : 1,	/* display only SOCKETS */
-			show_xmode : 1;		/* XMODE column is enabled. */
+			show_xmode : 1,		/* XMODE column is enabled. */
+			fd_need_lstat : 1,	/* see init_fd_collection() */
+			fd_need_fdinfo : 1;
+
+	unsigned int fd_stat_mask;		/* statx() mask for /proc/#/fd/# */
+	unsigned int filter_sources;		/* LSFD_SRC_* used by the filter */
 
 	char *uri;
+	size_t jobs;				/* number of worker threads */
 
 	struct libscols_filter *filter;		/* filter */
 	struct libscols_filter **ct_filters;	/* counters (NULL terminated array) */
 };
 
+static bool match_process(struct lsfd_control *ctl, struct proc *proc);
+static bool match_file(struct lsfd_control *ctl, struct proc *proc, struct file *file);
+
 static void *proc_tree;			/* for tsearch/tfind */
 
 static int proc_tree_compare(const void *a, const void *b)
@@ -674,6 +687,39 @@ struct proc *get_proc(pid_t pid)
 	return NULL;
 }
 
+/*
+ * The processes may be read by worker threads (--jobs). The workers share
+ * the mount namespaces, nodevs, IPCs and sockets tables, and the file
+ * classes keep their data there. The lock serializes everything what
+ * touches the tables (stat2class(), file_init_content(), read_fdinfo(),
+ * ...); the syscalls to read /proc are mostly done without the lock.
+ */
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t lsfd_mutex;
+#endif
+THREAD_LOCAL bool lsfd_worker;
+
+void lsfd_lock(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	if (lsfd_worker)
+		pthread_mutex_lock(&lsfd_mutex);
+#endif
+}
+
+void lsfd_unlock(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	if (lsfd_worker)
+		pthread_mutex_unlock(&lsfd_mutex);
+#endif
+}
+
+bool lsfd_is_worker(void)
+{
+	return lsfd_worker;
+}
+
 static int column_name_to_id(const char *name, size_t namesz)
 {
 	size_t i;
@@ -769,20 +815,24 @@ static const struct file_class *stat2class(struct stat *sb)
 	case S_IFDIR:
 		return &file_class;
 	case S_IFREG:
+	{
+		const struct file_class *class = &file_class;
+
 		dev = sb->st_dev;
 		if (major(dev) != 0)
 			return &file_class;
 
+		lsfd_lock();
 		if (is_nsfs_dev(dev))
-			return &nsfs_file_class;
-
-		if (is_mqueue_dev(dev))
-			return &mqueue_file_class;
-
-		if (is_pidfs_dev(dev))
-			return &pidfs_file_class;
-
-		return &file_class;
+			class = &nsfs_file_class;
+		else if (is_mqueue_dev(dev))
+			class = &mqueue_file_class;
+		else if (is_pidfs_dev(dev))
+			class = &pidfs_file_class;
+		lsfd_unlock();
+
+		return class;
+	}
 	default:
 		break;
 	}
@@ -866,8 +916,11 @@ static struct file *copy_file(struct file *old, int new_association)
 
 static void file_init_content(struct file *file)
 {
-	if (file->class && file->class->initialize_content)
+	if (file->class && file->class->initialize_content) {
+		lsfd_lock();
 		file->class->initialize_content(file);
+		lsfd_unlock();
+	}
 }
 
 static void free_file(struct file *file)
@@ -914,6 +967,7 @@ static void read_fdinfo(struct file *file, FILE *fdinfo)
 {
 	char buf[1024];
 
+	lsfd_lock();
 	while (fgets(buf, sizeof(buf), fdinfo)) {
 		const struct file_class *class;
 		char *val = strchr(buf, ':');
@@ -933,6 +987,7 @@ static void read_fdinfo(struct file *file, FILE *fdinfo)
 			class = class->super;
 		}
 	}
+	lsfd_unlock();
 }
 
 static int call_inspect_target_fd_method(int fd, void *data)
@@ -950,6 +1005,25 @@ static void inspect_target_fd(struct file *f, struct proc *proc)
 					       call_inspect_target_fd_method, f);
 }
 
+static struct file *new_symlink_file(struct proc *proc, struct stat *sb,
+				     const char *sym, int assoc,
+				     bool sockets_only)
+{
+	const struct file_class *class = stat2class(sb);
+
+	if (sockets_only
+	    /* A nsfs file is not a socket but the nsfs file can
+	     * be used as a entry point to collect information from
+	     * other network namespaces. Based on the information,
+	     * various columns of sockets can be filled.
+	     */
+	    && (class != &sock_class) && (class != &nsfs_file_class))
+		return NULL;
+	return new_file(proc, class, sb, sym, assoc);
+}
+
+/* read the other symlinks than /proc/#/fd/# (exe, cwd, root, ns/...)
+ */
 static struct file *collect_file_symlink(struct path_cxt *pc,
 					 struct proc *proc,
 					 const char *name,
@@ -965,17 +1039,9 @@ static struct file *collect_file_symlink(struct path_cxt *pc,
 	else if (ul_path_stat(pc, &sb, 0, name) < 0)
 		f = new_stat_error_file(proc, sym, errno, assoc);
 	else {
-		const struct file_class *class = stat2class(&sb);
-
-		if (sockets_only
-		    /* A nsfs file is not a socket but the nsfs file can
-		     * be used as a entry point to collect information from
-		     * other network namespaces. Based on the information,
-		     * various columns of sockets can be filled.
-		     */
-		    && (class != &sock_class) && (class != &nsfs_file_class))
+		f = new_symlink_file(proc, &sb, sym, assoc, sockets_only);
+		if (!f)
 			return NULL;
-		f = new_file(proc, class, &sb, sym, assoc);
 	}
 
 	file_init_content(f);
@@ -984,47 +1050,125 @@ static struct file *collect_file_symlink(struct path_cxt *pc,
 		return f;
 
 	if (is_association(f, NS_MNT)) {
+		lsfd_lock();
 		proc->mnt_ns = find_mnt_ns(f->stat.st_ino);
 		if (proc->mnt_ns == NULL)
 			proc->mnt_ns = add_mnt_ns(f->stat.st_ino);
+		lsfd_unlock();
 	} else if (is_association(f, NS_NET))
 		load_sock_xinfo(pc, name, f->stat.st_ino);
 
-	else if (assoc >= 0) {
-		/* file-descriptor based association */
-		FILE *fdinfo;
+	return f;
+}
+
+/* stat() for the file descriptor @name in /proc/#/fd directory @dd; only
+ * the fields in @mask are filled, the mount ID is returned in @mnt_id if
+ * STATX_MNT_ID is in the @mask and supported */
+static int stat_fd_file(int dd, const char *name, unsigned int mask,
+			struct stat *sb, unsigned int *mnt_id)
+{
+#ifdef HAVE_STATX
+	struct statx stx;
+
+	if (statx(dd, name, 0, mask, &stx) == 0) {
+		memset(sb, 0, sizeof(*sb));
+		sb->st_mode = stx.stx_mode;
+		sb->st_ino = stx.stx_ino;
+		sb->st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+		sb->st_rdev = makedev(stx.stx_rdev_major, stx.stx_rdev_minor);
+		sb->st_nlink = stx.stx_nlink;
+		sb->st_uid = stx.stx_uid;
+		sb->st_gid = stx.stx_gid;
+		sb->st_size = stx.stx_size;
+# ifdef HAVE_STRUCT_STATX_STX_MNT_ID
+		if (stx.stx_mask & STATX_MNT_ID)
+			*mnt_id = stx.stx_mnt_id;
+# endif
+		return 0;
+	}
+	if (errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP)
+		return -1;
+#endif	/* HAVE_STATX */
+	return fstatat(dd, name, sb, 0);
+}
+
+/* read the file descriptor @name from the /proc/#/fd directory @dd; lstat()
+ * and fdinfo are read only if a column needs them, see
+ * init_fd_collection() */
+static struct file *collect_fd_file(struct lsfd_control *ctl,
+				    struct path_cxt *pc,
+				    struct proc *proc,
+				    int dd, const char *name, int fd)
+{
+	char sym[PATH_MAX];
+	struct stat sb = { .st_mode = 0 };
+	unsigned int mnt_id = 0;
+	struct file *f;
+	ssize_t sz;
+
+	sz = readlinkat(dd, name, sym, sizeof(sym) - 1);
+	if (sz < 0)
+		f = new_readlink_error_file(proc, errno, fd);
+	else {
+		sym[sz] = '\0';
+		if (stat_fd_file(dd, name, ctl->fd_stat_mask, &sb, &mnt_id) < 0)
+			f = new_stat_error_file(proc, sym, errno, fd);
+		else {
+			f = new_symlink_file(proc, &sb, sym, fd, ctl->sockets_only);
+			if (!f)
+				return NULL;
+		}
+	}
+
+	file_init_content(f);
 
-		if (ul_path_stat(pc, &sb, AT_SYMLINK_NOFOLLOW, name) == 0)
-			f->mode = sb.st_mode;
+	if (is_error_object(f))
+		return f;
+
+	if (!match_file(ctl, proc, f)) {
+		f->filtered_out = 1;
+		return f;
+	}
 
-		if (is_nsfs_dev(f->stat.st_dev))
-			load_sock_xinfo(pc, name, f->stat.st_ino);
+	if (ctl->fd_need_lstat
+	    && fstatat(dd, name, &sb, AT_SYMLINK_NOFOLLOW) == 0)
+		f->mode = sb.st_mode;
 
+	if (is_nsfs_dev(f->stat.st_dev)) {
+		char path[sizeof("fd/") + sizeof(stringify_value(UINT64_MAX))];
+
+		snprintf(path, sizeof(path), "fd/%d", fd);
+		load_sock_xinfo(pc, path, f->stat.st_ino);
+	}
+
+	if (ctl->fd_need_fdinfo) {
+		FILE *fdinfo = ul_path_fopenf(pc, "r", "fdinfo/%d", fd);
 
-		fdinfo = ul_path_fopenf(pc, "r", "fdinfo/%d", assoc);
 		if (fdinfo) {
 			read_fdinfo(f, fdinfo);
 			fclose(fdinfo);
 		}
+	} else
+		f->mnt_id = mnt_id;
 
-		if (f->class->needs_target_fd &&
-		    f->class->needs_target_fd(f)) {
-			assert(f->class->inspect_target_fd);
-			inspect_target_fd(f, proc);
-		}
+	lsfd_lock();
+	if (f->class->needs_target_fd &&
+	    f->class->needs_target_fd(f)) {
+		assert(f->class->inspect_target_fd);
+		inspect_target_fd(f, proc);
 	}
+	lsfd_unlock();
 
 	return f;
 }
 
 /* read symlinks from /proc/#/fd
  */
-static void collect_fd_files(struct path_cxt *pc, struct proc *proc,
-			     bool sockets_only)
+static void collect_fd_files(struct lsfd_control *ctl, struct path_cxt *pc,
+			     struct proc *proc)
 {
 	DIR *sub = NULL;
 	struct dirent *d = NULL;
-	char path[sizeof("fd/") + sizeof(stringify_value(UINT64_MAX))];
 
 	while (ul_path_next_dirent(pc, &sub, "fd", &d) == 0) {
 		uint64_t num;
@@ -1032,8 +1176,7 @@ static void collect_fd_files(struct path_cxt *pc, struct proc *proc,
 		if (ul_strtou64(d->d_name, &num, 10) != 0)	/* only numbers */
 			continue;
 
-		snprintf(path, sizeof(path), "fd/%ju", (uintmax_t) num);
-		collect_file_symlink(pc, proc, path, num, sockets_only);
+		collect_fd_file(ctl, pc, proc, dirfd(sub), d->d_name, num);
 	}
 }
 
@@ -1680,6 +1823,58 @@ static int filter_filler_cb(
 	return 0;
 }
 
+/* Returns true if the (maybe incomplete) file passes the filter */
+static bool match_line(struct lsfd_control *ctl, struct proc *proc,
+		       struct file *file)
+{
+	struct libscols_line *ln;
+	struct filler_data fid = {
+		.proc = proc,
+		.file = file,
+		.hyperlink_enabled = false,
+	};
+	int status = 0;
+
+	/* the filter and the caches used by the classes are shared */
+	lsfd_lock();
+	ln = scols_new_line();
+	if (!ln || scols_line_alloc_cells(ln, ncolumns) != 0)
+		err(EXIT_FAILURE, _("failed to allocate output line"));
+
+	scols_filter_set_filler_cb(ctl->filter, filter_filler_cb, (void *) &fid);
+	if (scols_line_apply_filter(ln, ctl->filter, &status))
+		err(EXIT_FAILURE, _("failed to apply filter"));
+
+	scols_unref_line(ln);
+	lsfd_unlock();
+
+	return status != 0;
+}
+
+/* Returns false if no file of the process can pass the filter */
+static bool match_process(struct lsfd_control *ctl, struct proc *proc)
+{
+	struct file file = {
+		.class = &abst_class,
+		.proc = proc,
+	};
+
+	if (!ctl->filter || (ctl->filter_sources & ~LSFD_SRC_PROC))
+		return true;
+	return match_line(ctl, proc, &file);
+}
+
+/* Returns false if the file cannot pass the filter; called before lstat()
+ * and fdinfo are read */
+static bool match_file(struct lsfd_control *ctl, struct proc *proc,
+		       struct file *file)
+{
+	if (!ctl->filter || !(ctl->filter_sources & ~LSFD_SRC_PROC)
+	    || (ctl->filter_sources & ~(LSFD_SRC_PROC | LSFD_SRC_STAT)))
+		return true;
+	return match_line(ctl, proc, file);
+}
+
 static void convert_file(struct proc *proc,
 		     struct file *file,
 		     struct libscols_line *ln,
@@ -1706,9 +1901,13 @@ static void convert(struct list_head *procs, struct lsfd_control *ctl)
 
 		list_for_each (f, &proc->files) {
 			struct file *file = list_entry(f, struct file, files);
-			struct libscols_line *ln = scols_table_new_line(ctl->tb, NULL);
+			struct libscols_line *ln;
 			struct libscols_filter **ct_fltr = NULL;
 
+			if (file->filtered_out)
+				continue;
+
+			ln = scols_table_new_line(ctl->tb, NULL);
 			if (!ln)
 				err(EXIT_FAILURE, _("failed to allocate output line"));
 			if (ctl->filter) {
@@ -2169,6 +2368,10 @@ static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
 		goto out;
 	}
 
+	/* The filter uses only PID, COMMAND, ... */
+	if (!match_process(ctl, proc))
+		goto skip_files;
+
 	collect_execve_file(pc, proc, ctl->sockets_only);
 
 	if (proc->pid == proc->leader->pid
@@ -2198,6 +2401,8 @@ static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
 	if (proc->mnt_ns == NULL)
 		collect_namespace_files_tophalf(pc, proc);
 
+	lsfd_lock();
+
 	/* 2/3. read /proc/$pid/mountinfo unless we have read it already.
 	 * The backing device for "nsfs" is solved here.
 	 */
@@ -2215,6 +2420,7 @@ static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
 			fclose(mountinfo);
 		}
 	}
+	lsfd_unlock();
 
 	/* 3/3. read /proc/$pid/ns/{the other namespaces including net}
 	 * When reading the information about the net namespace,
@@ -2234,11 +2440,10 @@ static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
 
 	if (proc->pid == proc->leader->pid
 	    || kcmp(proc->leader->pid, proc->pid, KCMP_FILES, 0, 0) != 0)
-		collect_fd_files(pc, proc, ctl->sockets_only);
+		collect_fd_files(ctl, pc, proc);
 
+ skip_files:
 	list_add_tail(&proc->procs, &ctl->procs);
-	if (tsearch(proc, &proc_tree, proc_tree_compare) == NULL)
-		errx(EXIT_FAILURE, _("failed to allocate memory"));
 
 	if (ctl->show_xmode)
 		parse_proc_syscall(ctl, pc, pid, proc);
@@ -2312,20 +2517,139 @@ static bool member_pids(const pid_t pid, const pid_t pids[], const int count)
 	return bsearch(&pid, pids, count, sizeof(pid_t), pidcmp)? true: false;
 }
 
-static void collect_processes(struct lsfd_control *ctl, const pid_t pids[], int n_pids)
+#ifdef HAVE_LIBPTHREAD
+struct collector {
+	struct lsfd_control *ctl;
+
+	pid_t *pids;			/* processes to read */
+	size_t npids;
+	size_t next;			/* the next pids[] for a worker */
+
+	struct list_head *results;	/* procs for each pids[] */
+};
+
+static void *collect_worker(void *data)
 {
-	DIR *dir;
-	struct dirent *d;
-	struct path_cxt *pc = NULL;
+	struct collector *co = data;
+	struct lsfd_control wctl = *co->ctl;
+	struct path_cxt *pc;
+
+	lsfd_worker = true;
+
+	/* setns(CLONE_NEWNS) does not work for threads sharing the
+	 * filesystem attributes, see read_mountinfo_in_mntns() */
+	if (unshare(CLONE_FS) < 0)
+		DBG(INIT, ul_debug("unshare(CLONE_FS) failed: %m"));
 
 	pc = ul_new_path(NULL);
 	if (!pc)
 		err(EXIT_FAILURE, _("failed to alloc procfs handler"));
 
+	INIT_LIST_HEAD(&wctl.procs);
+
+	for (;;) {
+		size_t i;
+
+		lsfd_lock();
+		i = co->next++;
+		lsfd_unlock();
+
+		if (i >= co->npids)
+			break;
+
+		read_process(&wctl, pc, co->pids[i], NULL);
+		list_splice(&wctl.procs, &co->results[i]);
+		INIT_LIST_HEAD(&wctl.procs);
+	}
+
+	ul_unref_path(pc);
+	return NULL;
+}
+
+/*
+ * Reads the processes by ctl->jobs threads. Every process (with its
+ * threads) is read to a private list, the lists are merged in the /proc
+ * order, so the output is the same as with one thread.
+ */
+static void collect_processes_by_workers(struct lsfd_control *ctl, DIR *dir,
+					 const pid_t pids[], int n_pids)
+{
+	struct collector co = { .ctl = ctl };
+	pthread_t *workers;
+	pthread_mutexattr_t attr;
+	struct dirent *d;
+	size_t i, nalloc = 0, nworkers = 0;
+
+	while ((d = readdir(dir))) {
+		pid_t pid;
+
+		if (procfs_dirent_get_pid(d, &pid) != 0)
+			continue;
+		if (n_pids && !member_pids(pid, pids, n_pids))
+			continue;
+		if (co.npids == nalloc) {
+			nalloc = nalloc ? nalloc * 2 : 512;
+			co.pids = xreallocarray(co.pids, nalloc, sizeof(pid_t));
+		}
+		co.pids[co.npids++] = pid;
+	}
+
+	co.results = xcalloc(max(co.npids, (size_t) 1), sizeof(struct list_head));
+	for (i = 0; i < co.npids; i++)
+		INIT_LIST_HEAD(&co.results[i]);
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&lsfd_mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	workers = xcalloc(ctl->jobs, sizeof(pthread_t));
+	for (i = 0; i < ctl->jobs && i < co.npids; i++) {
+		if (pthread_create(&workers[i], NULL, collect_worker, &co) != 0) {
+			if (i == 0)
+				err(EXIT_FAILURE, _("failed to create thread"));
+			break;
+		}
+		nworkers++;
+	}
+	for (i = 0; i < nworkers; i++)
+		pthread_join(workers[i], NULL);
+
+	pthread_mutex_destroy(&lsfd_mutex);
+
+	for (i = 0; i < co.npids; i++)
+		list_splice(&co.results[i], ctl->procs.prev);
+
+	/* network namespaces found by the workers */
+	load_pending_sock_xinfos();
+
+	free(workers);
+	free(co.results);
+	free(co.pids);
+}
+#endif /* HAVE_LIBPTHREAD */
+
+static void collect_processes(struct lsfd_control *ctl, const pid_t pids[], int n_pids)
+{
+	DIR *dir;
+	struct dirent *d;
+	struct path_cxt *pc = NULL;
+	struct list_head *p;
+
 	dir = opendir(_PATH_PROC);
 	if (!dir)
 		err(EXIT_FAILURE, _("failed to open /proc"));
 
+#ifdef HAVE_LIBPTHREAD
+	if (ctl->jobs > 1) {
+		collect_processes_by_workers(ctl, dir, pids, n_pids);
+		goto done;
+	}
+#endif
+	pc = ul_new_path(NULL);
+	if (!pc)
+		err(EXIT_FAILURE, _("failed to alloc procfs handler"));
+
 	while ((d = readdir(dir))) {
 		pid_t pid;
 
@@ -2334,9 +2658,18 @@ static void collect_processes(struct lsfd_control *ctl, const pid_t pids[], int
 		if (n_pids == 0 || member_pids(pid, pids, n_pids))
 			read_process(ctl, pc, pid, 0);
 	}
-
-	closedir(dir);
 	ul_unref_path(pc);
+#ifdef HAVE_LIBPTHREAD
+done:
+#endif
+	closedir(dir);
+
+	list_for_each(p, &ctl->procs) {
+		struct proc *proc = list_entry(p, struct proc, procs);
+
+		if (tsearch(proc, &proc_tree, proc_tree_compare) == NULL)
+			errx(EXIT_FAILURE, _("failed to allocate memory"));
+	}
 }
 
 static void __attribute__((__noreturn__)) list_columns(const char *table_name,
@@ -2384,6 +2717,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -u, --notruncate             don't truncate text in columns\n"), out);
 	fputs(_(" -p, --pid <list>             collect information only for specified processes\n"), out);
 	fputs(_(" -i[4|6], --inet[=4|=6]       list only IPv4 and/or IPv6 sockets\n"), out);
+	fputs(_(" -j, --jobs <num>             read processes by <num> threads (0: one per CPU)\n"), out);
 	fputs(_(" -Q, --filter <expr>          apply display filter\n"), out);
 	fputs(_("     --debug-filter           dump the internal data structure of filter and exit\n"), out);
 	fputs(_(" -C, --counter <name>:<expr>  define custom counter for --summary output\n"), out);
@@ -2391,6 +2725,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_("     --hyperlink[=<when>]     print paths as hyperlinks (always|never|auto)\n"), out);
 	fputs(_("     --summary[=<mode>]       print summary information (append|only|never)\n"), out);
 	fputs(_("     --_drop-privilege        (testing purpose) do setuid(1) just after starting\n"), out);
+	fputs(_("     --_no-sock-diag          (testing purpose) don't use NETLINK_SOCK_DIAG\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_LIST_COLUMNS_OPTION(30));
@@ -2568,6 +2903,100 @@ static struct libscols_filter **new_default_counters(struct lsfd_control *ctl)
 	return ct_filters;
 }
 
+static const struct file_class *all_classes[] = {
+	&readlink_error_class, &stat_error_class,
+	&file_class, &cdev_class, &bdev_class, &sock_class, &unkn_class,
+	&fifo_class, &nsfs_file_class, &mqueue_file_class, &pidfs_file_class,
+};
+
+/* Returns LSFD_SRC_* needed to fill the column by any class */
+static unsigned int get_column_sources(int column_id)
+{
+	unsigned int src = 0;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(all_classes); i++) {
+		const struct file_class *class;
+
+		for (class = all_classes[i]; class; class = class->super) {
+			if (class->get_column_sources)
+				src |= class->get_column_sources(column_id);
+		}
+	}
+	return src;
+}
+
+/*
+ * The data for the files are read in the order of LSFD_SRC_* sources. The
+ * lstat() and fdinfo of the file descriptors are read only if a column
+ * (output, filter or counter) needs them, and the statx() mask contains
+ * only the fields used by the columns.
+ *
+ * If the filter needs only the process or stat() data, it is evaluated
+ * before the other data are read (see match_process() and match_file()).
+ * This is not possible if a column describes the other files (ENDPOINTS,
+ * ...), all the files are needed then.
+ */
+static void init_fd_collection(struct lsfd_control *ctl)
+{
+	unsigned int src = 0;
+	size_t i;
+
+	for (i = 0; i < ncolumns; i++)
+		src |= get_column_sources(columns[i]);
+
+	ctl->fd_need_lstat = !!(src & LSFD_SRC_LSTAT);
+	ctl->fd_need_fdinfo = !!(src & LSFD_SRC_FDINFO);
+
+	ctl->filter_sources = LSFD_SRC_PEERS;
+	if (ctl->filter && !(src & LSFD_SRC_PEERS)) {
+		struct libscols_iter *itr = scols_new_iter(SCOLS_ITER_FORWARD);
+		const char *name = NULL;
+
+		if (!itr)
+			err(EXIT_FAILURE, _("failed to allocate iterator"));
+
+		ctl->filter_sources = 0;
+		while (scols_filter_next_holder(ctl->filter, itr, &name, 0) == 0) {
+			int id = column_name_to_id(name, strlen(name));
+
+			if (id >= 0)
+				ctl->filter_sources |= get_column_sources(id);
+		}
+		scols_free_iter(itr);
+	}
+
+#ifdef HAVE_STATX
+	/* stat2class() and the classes use type, device and inode */
+	ctl->fd_stat_mask = STATX_TYPE | STATX_MODE | STATX_INO;
+
+	if (ctl->fd_need_fdinfo) {
+		ctl->fd_stat_mask = STATX_BASIC_STATS;
+		return;
+	}
+	for (i = 0; i < ncolumns; i++) {
+		switch (columns[i]) {
+		case COL_DELETED:
+		case COL_NLINK:
+			ctl->fd_stat_mask |= STATX_NLINK;
+			break;
+		case COL_FUID:
+		case COL_OWNER:
+			ctl->fd_stat_mask |= STATX_UID;
+			break;
+		case COL_SIZE:
+			ctl->fd_stat_mask |= STATX_SIZE;
+			break;
+# ifdef HAVE_STRUCT_STATX_STX_MNT_ID
+		case COL_MNT_ID:
+			ctl->fd_stat_mask |= STATX_MNT_ID;
+			break;
+# endif
+		}
+	}
+#endif	/* HAVE_STATX */
+}
+
 static void dump_default_counter_specs(void)
 {
 	size_t len = ARRAY_SIZE(default_counter_specs);
@@ -2665,6 +3094,8 @@ static void attach_xinfos(struct list_head *procs)
 
 		list_for_each (f, &proc->files) {
 			struct file *file = list_entry(f, struct file, files);
+			if (file->filtered_out)
+				continue;
 			if (file->class->attach_xinfo)
 				file->class->attach_xinfo(file);
 		}
@@ -2734,6 +3165,7 @@ int main(int argc, char *argv[])
 		OPT_SUMMARY,
 		OPT_DUMP_COUNTERS,
 		OPT_DROP_PRIVILEGE,
+		OPT_NO_SOCK_DIAG,
 		OPT_HYPERLINK
 	};
 	static const struct option longopts[] = {
@@ -2747,6 +3179,7 @@ int main(int argc, char *argv[])
 		{ "notruncate", no_argument, NULL, 'u' },
 		{ "pid",        required_argument, NULL, 'p' },
 		{ "inet",       optional_argument, NULL, 'i' },
+		{ "jobs",       required_argument, NULL, 'j' },
 		{ "filter",     required_argument, NULL, 'Q' },
 		{ "debug-filter",no_argument, NULL, OPT_DEBUG_FILTER },
 		{ "summary",    optional_argument, NULL,  OPT_SUMMARY },
@@ -2754,6 +3187,7 @@ int main(int argc, char *argv[])
 		{ "dump-counters",no_argument, NULL, OPT_DUMP_COUNTERS },
 		{ "list-columns",no_argument, NULL, 'H' },
 		{ "_drop-privilege",no_argument,NULL,OPT_DROP_PRIVILEGE },
+		{ "_no-sock-diag",no_argument,NULL,OPT_NO_SOCK_DIAG },
 		{ "hyperlink",  optional_argument, NULL, OPT_HYPERLINK },
 		{ NULL, 0, NULL, 0 },
 	};
@@ -2765,7 +3199,7 @@ int main(int argc, char *argv[])
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "no:JrVhluQ:p:i::C:sH", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "no:JrVhluQ:p:i::j:C:sH", longopts, NULL)) != -1) {
 		switch (c) {
 		case 'n':
 			ctl.noheadings = 1;
@@ -2808,6 +3242,13 @@ int main(int argc, char *argv[])
 			append_filter_expr(&filter_expr, subexpr, true);
 			break;
 		}
+		case 'j':
+			ctl.jobs = strtou32_or_err(optarg, _("invalid jobs argument"));
+			if (ctl.jobs == 0) {
+				long n = sysconf(_SC_NPROCESSORS_ONLN);
+				ctl.jobs = n > 0 ? (size_t) n : 1;
+			}
+			break;
 		case 'Q':
 			append_filter_expr(&filter_expr, optarg, true);
 			break;
@@ -2839,6 +3280,9 @@ int main(int argc, char *argv[])
 			if (setuid(1) == -1)
 				err(EXIT_FAILURE, _("failed to drop privilege"));
 			break;
+		case OPT_NO_SOCK_DIAG:
+			disable_sock_diag();
+			break;
 		case OPT_HYPERLINK:
 			if (hyperlinkwanted(optarg))
 				ctl.uri = xgethosturi(NULL);
@@ -2890,6 +3334,14 @@ int main(int argc, char *argv[])
 	if (ctl.json)
 		scols_table_set_name(ctl.tb, "lsfd");
 
+	/* raw and JSON outputs do not need column widths, print the lines
+	 * as they are converted rather than keep all of them in memory */
+	if (ctl.show_main && (ctl.raw || ctl.json))
+		scols_table_enable_streaming(ctl.tb, 1);
+	else
+		/* all the lines are kept until the end */
+		scols_table_enable_arena(ctl.tb, 1);
+
 	/* create output columns */
 	for (i = 0; i < ncolumns; i++) {
 		struct libscols_column *cl = add_column(ctl.tb, get_column_id(i), 0, ctl.uri);
@@ -2935,6 +3387,8 @@ int main(int argc, char *argv[])
 	if (scols_table_get_column_by_name(ctl.tb, "XMODE"))
 		ctl.show_xmode = 1;
 
+	init_fd_collection(&ctl);
+
 	/* Minimize the output related to lsfd itself. */
 # ifdef HAVE_CLOSE_RANGE
 	if (close_range(STDERR_FILENO + 1, ~0U, 0) < 0)
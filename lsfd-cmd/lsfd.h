@@ -237,7 +237,8 @@ struct file {
 
 	bool	locked_read,
 		locked_write,
-		multiplexed;
+		multiplexed,
+		filtered_out;	/* rejected by the filter before fdinfo */
 };
 
 #define is_opened_file(_f) ((_f)->association >= 0)
@@ -247,6 +248,20 @@ struct file {
 			|| is_association(_f, EXE) || is_association(_f, CWD) || is_association(_f, ROOT) \
 			|| is_association(_f, PIDFS))
 
+/*
+ * Data sources of the columns. The sources are read in this order for each
+ * file; if the filter needs only the first sources, the file (or the whole
+ * process) is filtered before reading the others.
+ */
+enum {
+	LSFD_SRC_PROC	= (1 << 0),	/* /proc/#/{comm,stat,status} */
+	LSFD_SRC_STAT	= (1 << 1),	/* symlink, stat() and the class content */
+	LSFD_SRC_LSTAT	= (1 << 2),	/* lstat() of /proc/#/fd/# (open mode) */
+	LSFD_SRC_FDINFO	= (1 << 3),	/* /proc/#/fdinfo/# and the target fd */
+	LSFD_SRC_XINFO	= (1 << 4),	/* attached after all processes are read */
+	LSFD_SRC_PEERS	= (1 << 5),	/* the other files (IPC endpoints, ...) */
+};
+
 struct file_class {
 	const struct file_class *super;
 	size_t size;
@@ -268,6 +283,10 @@ struct file_class {
 	void (*initialize_content)(struct file *file);
 	void (*free_content)(struct file *file);
 	const struct ipc_class *(*get_ipc_class)(struct file *file);
+
+	/* Returns LSFD_SRC_* needed to fill the column by this class (not
+	 * by the super class), or 0 if the class does not fill it. */
+	unsigned int (*get_column_sources)(int column_id);
 };
 
 extern const struct file_class abst_class, readlink_error_class, stat_error_class,
@@ -344,7 +363,9 @@ void load_sock_xinfo(struct path_cxt *pc, const char *name, ino_t netns);
 bool is_nsfs_dev(dev_t dev);
 
 void load_fdsk_xinfo(ino_t netns_ino, int netns_fd);
+void load_pending_sock_xinfos(void);
 ino_t get_netns_from_socket(int sk);
+void disable_sock_diag(void);
 
 /*
  * POSIX Mqueue
@@ -362,6 +383,13 @@ bool is_multiplexed_by_eventpoll(int fd, struct list_head *eventpolls);
  */
 bool is_pidfs_dev(dev_t dev);
 
+/*
+ * Worker threads (--jobs)
+ */
+void lsfd_lock(void);
+void lsfd_unlock(void);
+bool lsfd_is_worker(void);
+
 /*
  * Utility
  */
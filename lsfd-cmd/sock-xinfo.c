@@ -26,6 +26,7 @@
 #include <netdb.h>		/* getprotobyname */
 #include <net/if.h>		/* if_nametoindex */
 #include <linux/if_ether.h>	/* ETH_P_* */
+#include <linux/inet_diag.h>	/* inet_diag_req_v2, inet_diag_msg */
 #include <linux/net.h>		/* SS_* */
 #include <linux/netlink.h>	/* NETLINK_*, NLMSG_* */
 #include <linux/rtnetlink.h>	/* RTA_*, struct rtattr,  */
@@ -67,6 +68,8 @@ static void load_xinfo_from_proc_raw6(ino_t netns_inode, enum sysfs_byteorder by
 static void load_xinfo_from_proc_netlink(ino_t netns_inode);
 static void load_xinfo_from_proc_packet(ino_t netns_inode);
 
+static void load_xinfo_from_diag_inet_L4s(int diag, ino_t netns_inode,
+					  enum sysfs_byteorder byteorder);
 static void load_xinfo_from_diag_unix(int diag, ino_t netns_inode);
 static void load_xinfo_from_diag_vsock(int diag, ino_t netns_inode);
 
@@ -75,9 +78,21 @@ static void fill_peers_of_unix_oneway_ipcs(void);
 static int self_netns_fd = -1;
 static struct stat self_netns_sb;
 
+static bool sock_diag_disabled;
+
 static void *xinfo_tree;	/* for tsearch/tfind */
 static void *netns_tree;
 
+/* Network namespaces found by the --jobs workers. A worker cannot enter
+ * a network namespace (/proc/net follows the main thread), so the
+ * namespace is kept open and loaded by load_pending_sock_xinfos() later. */
+struct pending_netns {
+	ino_t	inode;
+	int	fd;
+	struct pending_netns *next;
+};
+static struct pending_netns *pending_netns;
+
 static struct list_head unix_ipcs;
 static void *unix_oneway_ipc_tree;	/* for tsearch/tfind */
 
@@ -179,23 +194,24 @@ static void load_sock_xinfo_no_nsswitch(struct netns *nsobj)
 	int diagsd;
 	enum sysfs_byteorder byteorder = sysfs_get_byteorder(NULL);
 
+	if (sock_diag_disabled)
+		diagsd = -1;
+	else {
+		diagsd = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_SOCK_DIAG);
+		DBG(ENDPOINTS, ul_debug("made a diagnose socket [fd=%d; %s]", diagsd,
+					(diagsd >= 0)? "successful": strerror(errno)));
+	}
+
 	load_xinfo_from_proc_unix(netns);
-	load_xinfo_from_proc_tcp(netns, byteorder);
-	load_xinfo_from_proc_udp(netns, byteorder);
-	load_xinfo_from_proc_udplite(netns, byteorder);
+	/* TCP, UDP, and UDP-Lite; /proc/net files are used as fallback */
+	load_xinfo_from_diag_inet_L4s(diagsd, netns, byteorder);
 	load_xinfo_from_proc_raw(netns, byteorder);
-	load_xinfo_from_proc_tcp6(netns, byteorder);
-	load_xinfo_from_proc_udp6(netns, byteorder);
-	load_xinfo_from_proc_udplite6(netns, byteorder);
 	load_xinfo_from_proc_raw6(netns, byteorder);
 	load_xinfo_from_proc_icmp(netns, byteorder);
 	load_xinfo_from_proc_icmp6(netns, byteorder);
 	load_xinfo_from_proc_netlink(netns);
 	load_xinfo_from_proc_packet(netns);
 
-	diagsd = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_SOCK_DIAG);
-	DBG(ENDPOINTS, ul_debug("made a diagnose socket [fd=%d; %s]", diagsd,
-				(diagsd >= 0)? "successful": strerror(errno)));
 	if (diagsd >= 0) {
 		load_xinfo_from_diag_unix(diagsd, netns);
 		load_xinfo_from_diag_vsock(diagsd, netns);
@@ -215,6 +231,44 @@ static void load_sock_xinfo_with_fd(int fd, struct netns *nsobj)
 	}
 }
 
+/* Keeps @fd (or its copy if @dup is true) for load_pending_sock_xinfos() */
+static void add_pending_netns(ino_t netns, int fd, bool dup)
+{
+	struct pending_netns *p;
+
+	lsfd_lock();
+	for (p = pending_netns; p; p = p->next) {
+		if (p->inode == netns)
+			break;
+	}
+	if (!p && dup)
+		fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (!p && fd >= 0) {
+		p = xmalloc(sizeof(*p));
+		p->inode = netns;
+		p->fd = fd;
+		p->next = pending_netns;
+		pending_netns = p;
+	} else if (!dup && fd >= 0)
+		close(fd);
+	lsfd_unlock();
+}
+
+void load_pending_sock_xinfos(void)
+{
+	while (pending_netns) {
+		struct pending_netns *p = pending_netns;
+
+		if (!is_sock_xinfo_loaded(p->inode)) {
+			struct netns *nsobj = mark_sock_xinfo_loaded(p->inode);
+			load_sock_xinfo_with_fd(p->fd, nsobj);
+		}
+		pending_netns = p->next;
+		close(p->fd);
+		free(p);
+	}
+}
+
 void load_sock_xinfo(struct path_cxt *pc, const char *name, ino_t netns)
 {
 	if (self_netns_fd == -1)
@@ -222,7 +276,15 @@ void load_sock_xinfo(struct path_cxt *pc, const char *name, ino_t netns)
 
 	if (!is_sock_xinfo_loaded(netns)) {
 		int fd;
-		struct netns *nsobj = mark_sock_xinfo_loaded(netns);
+		struct netns *nsobj;
+
+		if (lsfd_is_worker()) {
+			fd = ul_path_open(pc, O_RDONLY|O_CLOEXEC, name);
+			add_pending_netns(netns, fd, false);
+			return;
+		}
+
+		nsobj = mark_sock_xinfo_loaded(netns);
 		fd = ul_path_open(pc, O_RDONLY, name);
 		if (fd < 0)
 			return;
@@ -235,11 +297,26 @@ void load_sock_xinfo(struct path_cxt *pc, const char *name, ino_t netns)
 void load_fdsk_xinfo(ino_t netns_ino, int netns_fd)
 {
 	if (!is_sock_xinfo_loaded(netns_ino)) {
-		struct netns *nsobj = mark_sock_xinfo_loaded(netns_ino);
+		struct netns *nsobj;
+
+		if (lsfd_is_worker()) {
+			add_pending_netns(netns_ino, netns_fd, true);
+			return;
+		}
+		nsobj = mark_sock_xinfo_loaded(netns_ino);
 		load_sock_xinfo_with_fd(netns_fd, nsobj);
 	}
 }
 
+/*
+ * Don't use NETLINK_SOCK_DIAG, read the sockets from /proc/net files only
+ * (testing purpose).
+ */
+void disable_sock_diag(void)
+{
+	sock_diag_disabled = true;
+}
+
 void initialize_sock_xinfos(void)
 {
 	struct path_cxt *pc;
@@ -329,6 +406,10 @@ static void add_sock_info(struct sock_xinfo *xinfo)
 
 	if (tmp == NULL)
 		errx(EXIT_FAILURE, _("failed to allocate memory"));
+	if (*tmp != xinfo)
+		/* already loaded (e.g. by a partial sock_diag dump before
+		 * falling back to /proc/net) */
+		free_sock_xinfo(xinfo);
 }
 
 struct sock_xinfo *get_sock_xinfo(ino_t inode)
@@ -368,9 +449,12 @@ static const char *sock_decode_type(uint16_t type)
 	}
 }
 
-static void send_diag_request(int diagsd, void *req, size_t req_size,
-			      bool (*cb)(ino_t, size_t, void *),
-			      ino_t netns)
+/*
+ * Returns true if the whole dump has been received and accepted by @cb.
+ */
+static bool send_diag_request(int diagsd, void *req, size_t req_size,
+			      bool (*cb)(ino_t, size_t, void *, void *),
+			      ino_t netns, void *data)
 {
 	int r;
 	struct sockaddr_nl nladdr = {
@@ -396,12 +480,13 @@ static void send_diag_request(int diagsd, void *req, size_t req_size,
 	};
 
 	__attribute__((aligned(sizeof(void *)))) uint8_t buf[8192];
+	bool complete = true;
 
 	r = sendmsg(diagsd, &mhd, 0);
 	DBG(ENDPOINTS, ul_debug("sendmsg [rc=%d; %s]",
 				r, (r >= 0)? "successful": strerror(errno)));
 	if (r < 0)
-		return;
+		return false;
 
 	for (;;) {
 		const struct nlmsghdr *h;
@@ -409,34 +494,42 @@ static void send_diag_request(int diagsd, void *req, size_t req_size,
 		DBG(ENDPOINTS, ul_debug("recvfrom [rc=%d; %s]",
 					r, (r >= 0)? "successful": strerror(errno)));
 		if (r < 0)
-			return;
+			goto drop;
 
 		h = (void *) buf;
 		DBG(ENDPOINTS, ul_debug("   OK: %d", NLMSG_OK(h, (size_t)r)));
 		if (!NLMSG_OK(h, (size_t)r))
-			return;
+			goto drop;
 
 		for (; NLMSG_OK(h, (size_t)r); h = NLMSG_NEXT(h, r)) {
 			if (h->nlmsg_type == NLMSG_DONE) {
 				DBG(ENDPOINTS, ul_debug("      DONE"));
-				return;
+				return complete;
 			}
 			if (h->nlmsg_type == NLMSG_ERROR)  {
 				struct nlmsgerr *e = (struct nlmsgerr *)NLMSG_DATA(h);
 				DBG(ENDPOINTS, ul_debug("      ERROR: %s",
 							strerror(- e->error)));
-				return;
+				return false;
 			}
 
-			if (h->nlmsg_type == SOCK_DIAG_BY_FAMILY) {
+			/* after the callback failure the rest of the dump is
+			 * only read from the socket, the socket is shared by
+			 * the next requests */
+			if (complete && h->nlmsg_type == SOCK_DIAG_BY_FAMILY) {
 				DBG(ENDPOINTS, ul_debug("      FAMILY"));
-				if (!cb(netns, h->nlmsg_len, NLMSG_DATA(h)))
-					return;
+				if (!cb(netns, h->nlmsg_len, NLMSG_DATA(h), data))
+					complete = false;
 			}
 			DBG(ENDPOINTS, ul_debug("   NEXT"));
 		}
 		DBG(ENDPOINTS, ul_debug("   OK: 0"));
 	}
+drop:
+	/* the dump state is unknown, drop all pending messages */
+	while (recv(diagsd, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+		;
+	return false;
 }
 
 /*
@@ -812,7 +905,8 @@ static struct unix_ipc *get_unix_oneway_ipc(ino_t inode)
 }
 
 static bool handle_diag_unix(ino_t netns __attribute__((__unused__)),
-			     size_t nlmsg_len, void *nlmsg_data)
+			     size_t nlmsg_len, void *nlmsg_data,
+			     void *data __attribute__((__unused__)))
 {
 	const struct unix_diag_msg *diag = nlmsg_data;
 	size_t rta_len;
@@ -910,7 +1004,7 @@ static void load_xinfo_from_diag_unix(int diagsd, ino_t netns)
 		.udiag_show = UDIAG_SHOW_NAME | UDIAG_SHOW_PEER | UNIX_DIAG_SHUTDOWN,
 	};
 
-	send_diag_request(diagsd, &udr, sizeof(udr), handle_diag_unix, netns);
+	send_diag_request(diagsd, &udr, sizeof(udr), handle_diag_unix, netns, NULL);
 }
 
 static void fill_peers_of_unix_oneway_ipcs(void)
@@ -1894,6 +1988,96 @@ static void load_xinfo_from_proc_udplite6(ino_t netns_inode, enum sysfs_byteorde
 				     byteorder);
 }
 
+/*
+ * TCP, UDP, and UDP-Lite over IP and IP6 via NETLINK_SOCK_DIAG
+ *
+ * A dump request returns all the sockets of a protocol in the current
+ * network namespace in binary form, which is much cheaper than formatting
+ * and parsing the /proc/net files on hosts with many sockets.
+ */
+static bool handle_diag_inet(ino_t netns,
+			     size_t nlmsg_len, void *nlmsg_data,
+			     void *data)
+{
+	const struct inet_diag_msg *diag = nlmsg_data;
+	const struct l4_xinfo_class *class = data;
+	struct tcp_xinfo *tcp;
+	struct sock_xinfo *sock;
+
+	if (nlmsg_len < NLMSG_LENGTH(sizeof(*diag)))
+		return false;
+	if (diag->idiag_family != class->family)
+		return false;
+
+	/* TIME_WAIT and NEW_SYN_RECV mini sockets */
+	if (diag->idiag_inode == 0)
+		return true;
+	if (get_sock_xinfo((ino_t)diag->idiag_inode))
+		return true;
+
+	tcp = xcalloc(1, sizeof(*tcp));
+	sock = &tcp->l4.inet.sock;
+	sock->class = &class->sock;
+	sock->inode = (ino_t)diag->idiag_inode;
+	sock->netns_inode = netns;
+	if (class->family == AF_INET) {
+		tcp->l4.inet.local_addr.s_addr = diag->id.idiag_src[0];
+		tcp->l4.inet.remote_addr.s_addr = diag->id.idiag_dst[0];
+	} else {
+		memcpy(&tcp->l4.inet6.local_addr, diag->id.idiag_src,
+		       sizeof(tcp->l4.inet6.local_addr));
+		memcpy(&tcp->l4.inet6.remote_addr, diag->id.idiag_dst,
+		       sizeof(tcp->l4.inet6.remote_addr));
+	}
+	tcp->local_port = ntohs(diag->id.idiag_sport);
+	tcp->remote_port = ntohs(diag->id.idiag_dport);
+	tcp->l4.st = diag->idiag_state;
+
+	add_sock_info(sock);
+	return true;
+}
+
+static bool load_xinfo_from_diag_inet(int diagsd, ino_t netns,
+				      const struct l4_xinfo_class *class,
+				      uint8_t protocol)
+{
+	struct inet_diag_req_v2 req = {
+		.sdiag_family = class->family,
+		.sdiag_protocol = protocol,
+		.idiag_states = ~(uint32_t)0,
+	};
+
+	return send_diag_request(diagsd, &req, sizeof(req), handle_diag_inet,
+				 netns, (void *)class);
+}
+
+static void load_xinfo_from_diag_inet_L4s(int diagsd, ino_t netns,
+					  enum sysfs_byteorder byteorder)
+{
+	static const struct {
+		const struct l4_xinfo_class *class;
+		uint8_t protocol;
+		void (*load_from_proc)(ino_t, enum sysfs_byteorder);
+	} L4s[] = {
+		{ &tcp_xinfo_class,      IPPROTO_TCP,     load_xinfo_from_proc_tcp },
+		{ &udp_xinfo_class,      IPPROTO_UDP,     load_xinfo_from_proc_udp },
+		{ &udplite_xinfo_class,  IPPROTO_UDPLITE, load_xinfo_from_proc_udplite },
+		{ &tcp6_xinfo_class,     IPPROTO_TCP,     load_xinfo_from_proc_tcp6 },
+		{ &udp6_xinfo_class,     IPPROTO_UDP,     load_xinfo_from_proc_udp6 },
+		{ &udplite6_xinfo_class, IPPROTO_UDPLITE, load_xinfo_from_proc_udplite6 },
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(L4s); i++) {
+		if (diagsd >= 0
+		    && load_xinfo_from_diag_inet(diagsd, netns,
+						 L4s[i].class, L4s[i].protocol))
+			continue;
+		DBG(ENDPOINTS, ul_debug("fallback to /proc/net [family=%d, protocol=%d]",
+					L4s[i].class->family, L4s[i].protocol));
+		L4s[i].load_from_proc(netns, byteorder);
+	}
+}
+
 /*
  * RAW6
  */
@@ -2755,7 +2939,8 @@ static const struct sock_xinfo_class vsock_xinfo_class = {
 };
 
 static bool handle_diag_vsock(ino_t netns __attribute__((__unused__)),
-			     size_t nlmsg_len, void *nlmsg_data)
+			     size_t nlmsg_len, void *nlmsg_data,
+			     void *data __attribute__((__unused__)))
 {
 	const struct vsock_diag_msg *diag = nlmsg_data;
 	ino_t inode;
@@ -2807,7 +2992,7 @@ static void load_xinfo_from_diag_vsock(int diagsd, ino_t netns)
 	vdr.sdiag_family = AF_VSOCK;
 	vdr.vdiag_states =  ~(uint32_t)0;
 
-	send_diag_request(diagsd, &vdr, sizeof(vdr), handle_diag_vsock, netns);
+	send_diag_request(diagsd, &vdr, sizeof(vdr), handle_diag_vsock, netns, NULL);
 }
 #else
 static void load_xinfo_from_diag_vsock(int diagsd __attribute__((__unused__)),
@@ -165,6 +165,62 @@ ino_t get_netns_from_socket(int sk)
 	return sb.st_ino;
 }
 
+/* The most of the columns are filled by the socket information tables
+ * (xinfo) attached after collecting all the processes. */
+static unsigned int sock_get_column_sources(int column_id)
+{
+	switch(column_id) {
+	case COL_SOURCE:
+		return LSFD_SRC_STAT;
+	case COL_ENDPOINTS:
+	case COL_UNIX_IPEER:
+		return LSFD_SRC_XINFO | LSFD_SRC_PEERS;
+	case COL_SOCK_NETNS:
+		return LSFD_SRC_XINFO | LSFD_SRC_FDINFO;	/* target fd */
+	case COL_TYPE:
+	case COL_NAME:
+	case COL_SOCK_PROTONAME:
+	case COL_SOCK_TYPE:
+	case COL_SOCK_STATE:
+	case COL_SOCK_LISTENING:
+	case COL_SOCK_SHUTDOWN:
+	case COL_INET_LADDR:
+	case COL_INET_RADDR:
+	case COL_INET6_LADDR:
+	case COL_INET6_RADDR:
+	case COL_NETLINK_GROUPS:
+	case COL_NETLINK_LPORT:
+	case COL_NETLINK_PROTOCOL:
+	case COL_PACKET_IFACE:
+	case COL_PACKET_PROTOCOL:
+	case COL_PACKET_PROTOCOL_RAW:
+	case COL_PING_ID:
+	case COL_RAW_PROTOCOL:
+	case COL_RAW_PROTOCOL_RAW:
+	case COL_TCP_LADDR:
+	case COL_TCP_RADDR:
+	case COL_TCP_LPORT:
+	case COL_TCP_RPORT:
+	case COL_UDP_LADDR:
+	case COL_UDP_RADDR:
+	case COL_UDP_LPORT:
+	case COL_UDP_RPORT:
+	case COL_UDPLITE_LADDR:
+	case COL_UDPLITE_RADDR:
+	case COL_UDPLITE_LPORT:
+	case COL_UDPLITE_RPORT:
+	case COL_UNIX_PATH:
+	case COL_VSOCK_LADDR:
+	case COL_VSOCK_RADDR:
+	case COL_VSOCK_LCID:
+	case COL_VSOCK_RCID:
+	case COL_VSOCK_LPORT:
+	case COL_VSOCK_RPORT:
+		return LSFD_SRC_XINFO;
+	}
+	return 0;
+}
+
 static void init_sock_content(struct file *file)
 {
 	int fd;
@@ -254,4 +310,5 @@ const struct file_class sock_class = {
 	.initialize_class = initialize_sock_class,
 	.finalize_class = finalize_sock_class,
 	.get_ipc_class = sock_get_ipc_class,
+	.get_column_sources = sock_get_column_sources,
 };
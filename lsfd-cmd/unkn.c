@@ -1708,6 +1708,57 @@ static const struct anon_ops *anon_probe(const char *str)
 	return &anon_generic_ops;
 }
 
+static unsigned int unkn_get_column_sources(int column_id)
+{
+	switch(column_id) {
+	case COL_TYPE:		/* the class is detected by the name */
+	case COL_AINODECLASS:
+	case COL_SOURCE:
+		return LSFD_SRC_STAT;
+	case COL_NAME:
+	case COL_BPF_LINK_ID:
+	case COL_BPF_LINK_PROG_ID:
+	case COL_BPF_LINK_TYPE:
+	case COL_BPF_LINK_TYPE_RAW:
+	case COL_BPF_MAP_ID:
+	case COL_BPF_MAP_TYPE:
+	case COL_BPF_MAP_TYPE_RAW:
+	case COL_BPF_NAME:
+	case COL_BPF_PROG_ID:
+	case COL_BPF_PROG_TAG:
+	case COL_BPF_PROG_TYPE:
+	case COL_BPF_PROG_TYPE_RAW:
+	case COL_EVENTFD_ID:
+	case COL_EVENTPOLL_TFDS:
+	case COL_INOTIFY_INODES:
+	case COL_INOTIFY_INODES_RAW:
+	case COL_IO_URING_CQ_HEAD:
+	case COL_IO_URING_CQ_MASK:
+	case COL_IO_URING_CQ_TAIL:
+	case COL_IO_URING_CQES:
+	case COL_IO_URING_NAPI:
+	case COL_IO_URING_SQ_HEAD:
+	case COL_IO_URING_SQ_MASK:
+	case COL_IO_URING_SQ_TAIL:
+	case COL_IO_URING_SQES:
+	case COL_IO_URING_SQTHREAD:
+	case COL_IO_URING_SQTHREAD_CPU:
+	case COL_IO_URING_USER_BUFS:
+	case COL_IO_URING_USER_FILES:
+	case COL_PIDFD_COMM:
+	case COL_PIDFD_NSPID:
+	case COL_PIDFD_PID:
+	case COL_SIGNALFD_MASK:
+	case COL_TIMERFD_CLOCKID:
+	case COL_TIMERFD_INTERVAL:
+	case COL_TIMERFD_REMAINING:
+		return LSFD_SRC_FDINFO;
+	case COL_ENDPOINTS:
+		return LSFD_SRC_FDINFO | LSFD_SRC_XINFO | LSFD_SRC_PEERS;
+	}
+	return 0;
+}
+
 const struct file_class unkn_class = {
 	.super = &file_class,
 	.size = sizeof(struct unkn),
@@ -1717,4 +1768,5 @@ const struct file_class unkn_class = {
 	.handle_fdinfo = unkn_handle_fdinfo,
 	.attach_xinfo = unkn_attach_xinfo,
 	.get_ipc_class = unkn_get_ipc_class,
+	.get_column_sources = unkn_get_column_sources,
 };
@@ -966,6 +966,10 @@ int main(int argc, char **argv)
 			else if (fltr_type &&
 				 blkid_probe_filter_superblocks_type(pr, fltr_flag, fltr_type))
 				goto exit;
+
+			/* safeprobe reads the magic strings of all the enabled
+			 * filesystems, read them by one batch */
+			blkid_probe_enable_prefetch(pr, 1);
 		}
 
 		for (i = 0; i < numdev; i++) {
@@ -1012,7 +1016,7 @@ int main(int argc, char **argv)
 		blkid_dev_iterate	iter;
 		blkid_dev		dev;
 
-		blkid_probe_all(cache);
+		blkid_probe_all_parallel(cache, 0);
 
 		iter = blkid_dev_iterate_begin(cache);
 		blkid_dev_set_search(iter, search_type, search_value);
@@ -36,7 +36,9 @@
 #include <signal.h>		/* SIG*, sigaction */
 #include <getopt.h>		/* getopt_long() */
 #include <ctype.h>		/* tolower() */
+#include <dirent.h>		/* fdopendir(), readdir() */
 #include <sys/ioctl.h>
+#include <sys/mman.h>		/* mmap() */
 
 #if defined(HAVE_LINUX_FIEMAP_H) && defined(HAVE_SYS_VFS_H)
 # include <linux/fs.h>
@@ -50,13 +52,20 @@
 # define USE_SKIP_SUBTREE 1
 #endif
 
+#if defined(HAVE_LIBPTHREAD) && defined(HAVE_TLS)
+# include <pthread.h>
+# define USE_JOBS 1
+#endif
+
 #include "nls.h"
 #include "c.h"
 #include "xalloc.h"
 #include "strutils.h"
 #include "monotonic.h"
 #include "optutils.h"
+#include "fileutils.h"
 #include "fileeq.h"
+#include "all-io.h"
 
 #ifdef USE_REFLINK
 # include "statfs_magic.h"
@@ -82,16 +91,43 @@ enum {
 };
 static int reflink_mode = REFLINK_NEVER;
 static int reflinks_skip;
+static int compare_extents;	/* files sharing all extents are equal */
 #endif
 
 static struct ul_fileeq fileeq;
 
+#ifdef USE_JOBS
+/*
+ * With --jobs the directories are read and the size groups are compared by
+ * worker threads. The workers write the log messages to a per-group memory
+ * stream (hdl_out), the streams are printed by the main thread in the same
+ * order as without threads. The statistics are updated under stats_mutex.
+ */
+THREAD_LOCAL bool hdl_worker;
+THREAD_LOCAL FILE *hdl_out;
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+# define is_worker()	hdl_worker
+# define out_stream()	(hdl_out ? hdl_out : stdout)
+# define stats_update(x) \
+	do { \
+		pthread_mutex_lock(&stats_mutex); \
+		x; \
+		pthread_mutex_unlock(&stats_mutex); \
+	} while (0)
+#else
+# define is_worker()	0
+# define out_stream()	stdout
+# define stats_update(x) do { x; } while (0)
+#endif
+
 /**
  * struct file - Information about a file
  * @st:       The stat buffer associated with the file
  * @next:     Next file with the same size
  * @basename: The offset off the basename in the filename
  * @path:     The path of the file
+ * @dc:       The --digest-cache data (or NULL)
  *
  * This contains all information we need about a file.
  */
@@ -113,9 +149,67 @@ struct file {
 #endif
 	} *links;
 
+	struct dcache_file *dc;
 	unsigned short tree_seqnum;
 };
 
+/*
+ * Digest cache (--digest-cache)
+ *
+ * The intro and the whole-file digest of the compared files are stored to
+ * the cache file, so the next run does not have to read the unchanged files.
+ * The cached data are used only if the file has the same device, inode, size,
+ * mtime and ctime. The file entries are sorted by device and inode numbers and
+ * the cache is mmap()ed and searched by bsearch(). The cache file is written
+ * to a temporary file and renamed at the end of the run; it contains only
+ * the files compared in the last run.
+ */
+#define DCACHE_MAGIC		"hlcache1"
+
+#define DCACHE_HAS_INTRO	(1 << 0)
+#define DCACHE_HAS_DIGEST	(1 << 1)
+
+struct dcache_header {
+	char		magic[8];	/* DCACHE_MAGIC */
+	uint32_t	entsz;		/* sizeof(struct dcache_entry) */
+	uint32_t	digsiz;		/* digest size */
+	char		method[16];	/* comparison method */
+	uint64_t	nents;		/* number of entries */
+};
+
+/* The cache uses the native byte order, the header is checked by entsz. */
+struct dcache_entry {
+	uint64_t	dev;
+	uint64_t	ino;
+	uint64_t	size;
+	int64_t		mtime_sec;
+	int64_t		ctime_sec;
+	uint32_t	mtime_nsec;
+	uint32_t	ctime_nsec;
+	uint32_t	flags;		/* DCACHE_HAS_* */
+	uint32_t	reserved;
+	unsigned char	intro[UL_FILEEQ_INTROSIZ];
+	unsigned char	digest[UL_FILEEQ_DIGSIZ_MAX];
+};
+
+struct dcache_file {
+	struct dcache_entry ent;
+	bool linked;			/* ctime modified by file_link() */
+};
+
+static struct dcache {
+	void		*map;		/* mmap()ed cache file */
+	size_t		mapsz;
+
+	const struct dcache_entry *ents;	/* entries in the mapped file */
+	size_t		nents;
+	size_t		digsiz;
+
+	struct dcache_entry *out;	/* entries for the new cache file */
+	size_t		nout;
+	size_t		nalloc;
+} dcache;
+
 /**
  * enum log_level - Logging levels
  * @HDL_LOG_SUMMARY: Default log level
@@ -176,6 +270,8 @@ struct hdl_regex {
  * @dry_run: Specifies whether hardlink should not link files (default = FALSE)
  * @min_size: Minimum size of files to consider. (default = 1 byte)
  * @max_size: Maximum size of files to consider, 0 means umlimited. (default = 0 byte)
+ * @jobs: Number of threads to read directories and compare files (default = 1)
+ * @digest_cache: File to store digests of the compared files (default = NULL)
  */
 static struct options {
 	struct hdl_regex *include;
@@ -203,6 +299,8 @@ static struct options {
 	uintmax_t max_size;
 	size_t io_size;
 	size_t cache_size;
+	size_t jobs;
+	const char *digest_cache;
 } opts = {
 	/* default setting */
 #ifdef USE_FILEEQ_CRYPTOAPI
@@ -218,7 +316,8 @@ static struct options {
 	.prio_trees = FALSE,
 	.line_delim = '\n',
 	.min_size = 1,
-	.cache_size = 10*1024*1024
+	.cache_size = 10*1024*1024,
+	.jobs = 1
 };
 
 /*
@@ -245,12 +344,14 @@ static volatile sig_atomic_t last_signal;
  * hdl_log - Logging for hardlink
  * @l: The log level (without HDL_LOG_ prefix)
  * @x: function to print output
+ *
+ * The code called by the worker threads has to print to out_stream().
  */
 #define jlog(l, x) \
 	do { \
 		if (is_log_enabled( l )) { \
 			x; \
-			fputc('\n', stdout); \
+			fputc('\n', out_stream()); \
 		} \
 	} while (0)
 
@@ -432,13 +533,18 @@ static void print_stats(void)
 
 /**
  * handle_interrupt - Handle a signal
+ *
+ * SIGUSR1 is handled by the main thread only, the statistics are not
+ * printed to the worker's output.
  */
 static inline void handle_interrupt(void)
 {
 	switch (last_signal) {
 	case 0:
-		break;
+		return;
 	case SIGUSR1:
+		if (is_worker())
+			return;
 		print_stats();
 		putchar('\n');
 		break;
@@ -559,10 +665,10 @@ static int file_xattrs_equal(const struct file *a, const struct file *b)
 	assert(a->links != NULL);
 	assert(b->links != NULL);
 
-	jlog(VERBOSE1, printf(_("Comparing xattrs of %s to %s"),
+	jlog(VERBOSE1, fprintf(out_stream(), _("Comparing xattrs of %s to %s"),
 				a->links->path, b->links->path));
 
-	stats.xattr_comparisons++;
+	stats_update(stats.xattr_comparisons++);
 
 	len_a = llistxattr_or_die(a->links->path, NULL, 0);
 	len_b = llistxattr_or_die(b->links->path, NULL, 0);
@@ -732,7 +838,7 @@ fallback:
 
 		if (reflink_mode == REFLINK_ALWAYS)
 			return -errno;
-		jlog(VERBOSE2, printf(_("Reflinking failed, fallback to hardlinking")));
+		jlog(VERBOSE2, fprintf(out_stream(), _("Reflinking failed, fallback to hardlinking")));
 	}
 
 	return link(a->links->path, new_name);
@@ -747,17 +853,190 @@ static inline int do_link(struct file *a,
 }
 #endif /* USE_REFLINK */
 
+#ifdef USE_REFLINK
+/* max. length of one FIDEDUPERANGE request (the btrfs limit) */
+# define DEDUPE_CHUNKSZ		(16 * 1024 * 1024)
+
+/* max. number of destinations in one request, the kernel limits the request
+ * size to one page */
+# define DEDUPE_MAXDEST		((4096 - sizeof(struct file_dedupe_range)) \
+				 / sizeof(struct file_dedupe_range_info))
+
+/* returns 0 if done, 1 if the data differ, <0 on error */
+static int dedupe_status(const struct file_dedupe_range_info *info)
+{
+	if (info->status == FILE_DEDUPE_RANGE_DIFFERS)
+		return 1;
+	if (info->status < 0)
+		return info->status;
+	if (info->bytes_deduped == 0)
+		return -EINVAL;
+	return 0;
+}
+
+/*
+ * Shares the extents from @off to @end with one destination, used if the
+ * kernel has done only a part of a request for the destination.
+ */
+static int dedupe_one(int src, int dest, uint64_t off, uint64_t end)
+{
+	struct {
+		struct file_dedupe_range range;
+		struct file_dedupe_range_info info;
+	} req;
+	int rc;
+
+	while (off < end) {
+		memset(&req, 0, sizeof(req));
+		req.range.src_offset = off;
+		req.range.src_length = end - off;
+		req.range.dest_count = 1;
+		req.info.dest_fd = dest;
+		req.info.dest_offset = off;
+
+		if (ioctl(src, FIDEDUPERANGE, &req.range) != 0)
+			return -errno;
+		rc = dedupe_status(&req.info);
+		if (rc)
+			return rc;
+		off += req.info.bytes_deduped;
+	}
+	return 0;
+}
+
+/**
+ * do_dedupe - Share extents of the file a with the files b
+ * @a: The source file
+ * @b: The destination files
+ * @n: The number of the destination files
+ * @res: Returns the result for every destination file
+ *
+ * The extents are shared in-place by FIDEDUPERANGE, so all the links and
+ * metadata of @b are kept. The kernel compares the data before it remaps
+ * them, so it's safe if the file has been modified after our comparison.
+ * All the destinations are sent in one request per chunk, so the source
+ * chunk is read only once for all of them.
+ *
+ * The result is 0 on success, 1 if the data differ, <0 on error.
+ */
+static void do_dedupe(struct file *a, struct file **b, size_t n, int *res)
+{
+	struct file_dedupe_range *range;
+	uint64_t size = a->st.st_size;
+	size_t i, first, *idx;
+	int *fds, src;
+
+	src = open(a->links->path, O_RDONLY | O_CLOEXEC);
+	if (src < 0) {
+		for (i = 0; i < n; i++)
+			res[i] = -errno;
+		return;
+	}
+
+	range = xcalloc(1, sizeof(*range)
+			   + DEDUPE_MAXDEST * sizeof(struct file_dedupe_range_info));
+	fds = xcalloc(DEDUPE_MAXDEST, sizeof(*fds));
+	idx = xcalloc(DEDUPE_MAXDEST, sizeof(*idx));
+
+	for (first = 0; first < n; first += DEDUPE_MAXDEST) {
+		size_t nb = min(n - first, (size_t) DEDUPE_MAXDEST);
+		int *rb = res + first;
+		uint64_t off = 0;
+
+		for (i = 0; i < nb; i++) {
+			const char *path = b[first + i]->links->path;
+
+			fds[i] = open(path, O_RDWR | O_CLOEXEC);
+			if (fds[i] < 0)
+				/* read-only is enough for the file owner
+				 * since Linux 4.19 */
+				fds[i] = open(path, O_RDONLY | O_CLOEXEC);
+			rb[i] = fds[i] < 0 ? -errno : 0;
+		}
+
+		while (off < size) {
+			uint64_t len = min(size - off, (uint64_t) DEDUPE_CHUNKSZ);
+			size_t ndest = 0;
+
+			/* all destinations without a result yet */
+			for (i = 0; i < nb; i++) {
+				struct file_dedupe_range_info *info;
+
+				if (rb[i] != 0)
+					continue;
+				info = &range->info[ndest];
+				memset(info, 0, sizeof(*info));
+				info->dest_fd = fds[i];
+				info->dest_offset = off;
+				idx[ndest++] = i;
+			}
+			if (!ndest)
+				break;
+
+			range->src_offset = off;
+			range->src_length = len;
+			range->dest_count = ndest;
+
+			if (ioctl(src, FIDEDUPERANGE, range) != 0) {
+				int rc = -errno;
+
+				for (i = 0; i < ndest; i++)
+					rb[idx[i]] = rc;
+				break;
+			}
+
+			for (i = 0; i < ndest; i++) {
+				struct file_dedupe_range_info *info = &range->info[i];
+				int rc = dedupe_status(info);
+
+				if (rc == 0 && info->bytes_deduped < len)
+					rc = dedupe_one(src, fds[idx[i]],
+							off + info->bytes_deduped,
+							off + len);
+				rb[idx[i]] = rc;
+			}
+			off += len;
+		}
+
+		for (i = 0; i < nb; i++) {
+			if (fds[i] >= 0)
+				close(fds[i]);
+		}
+	}
+
+	close(src);
+	free(idx);
+	free(fds);
+	free(range);
+}
+#else
+static inline void do_dedupe(struct file *a __attribute__((__unused__)),
+			     struct file **b __attribute__((__unused__)),
+			     size_t n, int *res)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		res[i] = -ENOTSUP;
+}
+#endif /* USE_REFLINK */
+
 /**
  * file_link - Replace b with a link to a
  * @a: The first file
  * @b: The second file
+ * @reflink: Create a reflink rather than a hardlink
+ * @dedupe_rc: The do_dedupe() result for @b if @reflink is set
  *
  * Link the file, replacing @b with the current one. The file is first
  * linked to a temporary name, and then renamed to the name of @b, making
- * the replace atomic (@b will always exist).
+ * the replace atomic (@b will always exist). The reflinks are created by
+ * do_dedupe() in-place if possible, the new file is created only if the
+ * ioctl is not supported for the files.
  */
-static int file_link(struct file *a, struct file *b, int reflink)
+static int file_link(struct file *a, struct file *b, int reflink, int dedupe_rc)
 {
+	int deduped = 0;
 
  file_link:
 	assert(a->links != NULL);
@@ -767,7 +1046,7 @@ static int file_link(struct file *a, struct file *b, int reflink)
 		char *ssz = size_to_human_string(SIZE_SUFFIX_3LETTER |
 				   SIZE_SUFFIX_SPACE |
 				   SIZE_DECIMAL_2DIGITS, a->st.st_size);
-		jlog(INFO, printf(_("%s%sLinking %s to %s (-%s)"),
+		jlog(INFO, fprintf(out_stream(), _("%s%sLinking %s to %s (-%s)"),
 		     opts.dry_run ? _("[DryRun] ") : "",
 		     reflink ? "Ref" : "",
 		     a->links->path, b->links->path,
@@ -775,7 +1054,28 @@ static int file_link(struct file *a, struct file *b, int reflink)
 		free(ssz);
 	}
 
-	if (!opts.dry_run) {
+	if (!opts.dry_run && reflink && !deduped) {
+		int rc = dedupe_rc;
+
+		if (rc == 1) {
+			warnx(_("cannot dedupe %s and %s: content changed"),
+			      a->links->path, b->links->path);
+			return FALSE;
+		}
+		/* the old way replaces the inode of @b, so it's used only if
+		 * the ioctl is not supported for the files */
+		if (rc < 0 && rc != -EOPNOTSUPP && rc != -ENOTTY
+		    && rc != -EINVAL && rc != -EXDEV) {
+			errno = -rc;
+			warn(_("cannot dedupe %s and %s"),
+			     a->links->path, b->links->path);
+			return FALSE;
+		}
+		/* all links of @b share the extents now */
+		deduped = rc == 0;
+	}
+
+	if (!opts.dry_run && !deduped) {
 		char *new_path;
 		int failed = 1;
 
@@ -796,14 +1096,18 @@ static int file_link(struct file *a, struct file *b, int reflink)
 	}
 
 	/* Update statistics */
-	stats.linked++;
+	stats_update(stats.linked++);
+
+	/* ctime of the file is modified by link() */
+	if (a->dc && !opts.dry_run)
+		a->dc->linked = 1;
 
 	/* Increase the link count of this file, and set stat() of other file */
 	a->st.st_nlink++;
 	b->st.st_nlink--;
 
 	if (b->st.st_nlink == 0)
-		stats.saved += a->st.st_size;
+		stats_update(stats.saved += a->st.st_size);
 
 	/* Move the link from file b to a */
 	{
@@ -986,8 +1290,8 @@ static int insert_file(const char *fpath)
 #ifdef USE_REFLINK
 static int is_reflink_compatible(dev_t devno, const char *filename)
 {
-	static dev_t last_dev = 0;
-	static int last_status = 0;
+	THREAD_LOCAL dev_t last_dev = 0;
+	THREAD_LOCAL int last_status = 0;
 
 	if (last_dev != devno) {
 		struct statfs vfs;
@@ -1011,6 +1315,20 @@ static int is_reflink_compatible(dev_t devno, const char *filename)
 	return last_status;
 }
 
+/* extents with unreliable physical offset or with data which are not stored
+ * directly at the offset (compressed, encrypted, inline, ...) */
+#define FIEMAP_EXTENT_NOCMP	(FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | \
+				 FIEMAP_EXTENT_ENCODED | FIEMAP_EXTENT_DATA_ENCRYPTED | \
+				 FIEMAP_EXTENT_NOT_ALIGNED | FIEMAP_EXTENT_DATA_INLINE | \
+				 FIEMAP_EXTENT_DATA_TAIL | FIEMAP_EXTENT_UNWRITTEN)
+
+/**
+ * is_reflink - Check whether the files share all extents
+ * @xa: The first file
+ * @xb: The second file
+ *
+ * The files sharing all extents have the same content.
+ */
 static int is_reflink(struct file *xa, struct file *xb)
 {
 	int last = 0, rc = 0;
@@ -1054,6 +1372,9 @@ static int is_reflink(struct file *xa, struct file *xb)
 			    a->fe_length !=  b->fe_length ||
 			    a->fe_physical != b->fe_physical)
 				goto done;
+			if ((a->fe_flags & FIEMAP_EXTENT_NOCMP) ||
+			    (b->fe_flags & FIEMAP_EXTENT_NOCMP))
+				goto done;
 			if (!(a->fe_flags & FIEMAP_EXTENT_SHARED) ||
 			    !(b->fe_flags & FIEMAP_EXTENT_SHARED))
 				goto done;
@@ -1076,6 +1397,303 @@ done:
 }
 #endif /* USE_REFLINK */
 
+static void dcache_set_key(struct dcache_entry *e, const struct stat *st)
+{
+	memset(e, 0, sizeof(*e));
+	e->dev = st->st_dev;
+	e->ino = st->st_ino;
+	e->size = st->st_size;
+	e->mtime_sec = st->st_mtim.tv_sec;
+	e->mtime_nsec = st->st_mtim.tv_nsec;
+	e->ctime_sec = st->st_ctim.tv_sec;
+	e->ctime_nsec = st->st_ctim.tv_nsec;
+}
+
+static int dcache_cmp_entries(const void *_a, const void *_b)
+{
+	const struct dcache_entry *a = _a, *b = _b;
+
+	if (a->dev != b->dev)
+		return CMP(a->dev, b->dev);
+	return CMP(a->ino, b->ino);
+}
+
+static inline int dcache_key_match(const struct dcache_entry *e, const struct stat *st)
+{
+	return e->size == (uint64_t) st->st_size
+		&& e->mtime_sec == st->st_mtim.tv_sec
+		&& e->mtime_nsec == (uint32_t) st->st_mtim.tv_nsec
+		&& e->ctime_sec == st->st_ctim.tv_sec
+		&& e->ctime_nsec == (uint32_t) st->st_ctim.tv_nsec;
+}
+
+/**
+ * dcache_open - Map the cache file
+ *
+ * The cache is ignored (and replaced at the end) if it has been written by
+ * another method or it's corrupted.
+ */
+static void dcache_open(void)
+{
+	const struct dcache_header *hdr;
+	struct stat st;
+	int fd;
+
+	dcache.digsiz = ul_fileeq_digest_size(&fileeq);
+	if (!dcache.digsiz) {
+		warnx(_("digest cache is not supported by the %s method"), opts.method);
+		opts.digest_cache = NULL;
+		return;
+	}
+
+	fd = open(opts.digest_cache, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		if (errno != ENOENT)
+			warn(_("cannot open %s"), opts.digest_cache);
+		return;
+	}
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(*hdr))
+		goto ignore;
+
+	dcache.mapsz = st.st_size;
+	dcache.map = mmap(NULL, dcache.mapsz, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (dcache.map == MAP_FAILED) {
+		dcache.map = NULL;
+		goto ignore;
+	}
+
+	hdr = dcache.map;
+	if (memcmp(hdr->magic, DCACHE_MAGIC, sizeof(hdr->magic)) != 0
+	    || hdr->entsz != sizeof(struct dcache_entry)
+	    || hdr->digsiz != dcache.digsiz
+	    || strncmp(hdr->method, opts.method, sizeof(hdr->method)) != 0
+	    || hdr->nents > (dcache.mapsz - sizeof(*hdr)) / sizeof(struct dcache_entry)) {
+		munmap(dcache.map, dcache.mapsz);
+		dcache.map = NULL;
+		goto ignore;
+	}
+
+	dcache.ents = (const struct dcache_entry *) (hdr + 1);
+	dcache.nents = hdr->nents;
+	close(fd);
+
+	jlog(INFO, printf(_("Digest cache %s: %zu entries"),
+			  opts.digest_cache, dcache.nents));
+	return;
+ignore:
+	jlog(INFO, printf(_("Digest cache %s ignored"), opts.digest_cache));
+	close(fd);
+}
+
+/**
+ * dcache_get - Get cached intro or digest
+ * @eq: The content comparer
+ * @f: The file
+ * @what: DCACHE_HAS_INTRO or DCACHE_HAS_DIGEST
+ *
+ * Reads the file if the data are not in the cache.
+ *
+ * Returns: 0 on success, <0 on error.
+ */
+static int dcache_get(struct ul_fileeq *eq, struct file *f, unsigned int what)
+{
+	struct dcache_file *dc = f->dc;
+
+	if (!dc) {
+		const struct dcache_entry *e = NULL;
+		struct dcache_entry key;
+
+		dcache_set_key(&key, &f->st);
+		if (dcache.nents)
+			e = bsearch(&key, dcache.ents, dcache.nents,
+				    sizeof(struct dcache_entry), dcache_cmp_entries);
+
+		dc = f->dc = xcalloc(1, sizeof(*dc));
+		dc->ent = e && dcache_key_match(e, &f->st) ? *e : key;
+	}
+
+	if (dc->ent.flags & what)
+		return 0;
+
+	if (what == DCACHE_HAS_INTRO) {
+		unsigned char *intro;
+
+		if (ul_fileeq_get_intro(eq, &f->data, &intro) != UL_FILEEQ_INTROSIZ)
+			return -1;
+		memcpy(dc->ent.intro, intro, UL_FILEEQ_INTROSIZ);
+	} else if (ul_fileeq_get_digest(eq, &f->data, dc->ent.digest)
+					!= (ssize_t) dcache.digsiz)
+		return -1;
+
+	dc->ent.flags |= what;
+	return 0;
+}
+
+/**
+ * dcache_compare - Compare files by cached intros and digests
+ * @eq: The content comparer
+ * @a: The first file
+ * @b: The second file
+ *
+ * The digest is trusted the same way as the block digests used by
+ * ul_fileeq() (xxh3 matches are confirmed by ul_fileeq_confirm()), but
+ * short digests (crc32) are used only to detect mismatch.
+ *
+ * Returns: 1 if the files are equal, 0 if not, <0 if unknown (use ul_fileeq()).
+ */
+static int dcache_compare(struct ul_fileeq *eq, struct file *a, struct file *b)
+{
+	if (dcache_get(eq, a, DCACHE_HAS_INTRO) != 0
+	    || dcache_get(eq, b, DCACHE_HAS_INTRO) != 0)
+		return -1;
+	if (memcmp(a->dc->ent.intro, b->dc->ent.intro, UL_FILEEQ_INTROSIZ) != 0)
+		return 0;
+
+	if (dcache_get(eq, a, DCACHE_HAS_DIGEST) != 0
+	    || dcache_get(eq, b, DCACHE_HAS_DIGEST) != 0)
+		return -1;
+	if (memcmp(a->dc->ent.digest, b->dc->ent.digest, dcache.digsiz) != 0)
+		return 0;
+
+	if (dcache.digsiz < 16)
+		return -1;
+	return ul_fileeq_confirm(eq, &a->data, &b->data);
+}
+
+/**
+ * dcache_collector - Callback for twalk(), collects entries for the new cache
+ */
+static void dcache_collector(const void *nodep, const VISIT which, const int depth)
+{
+	struct file *f;
+
+	(void)depth;
+
+	if (which != leaf && which != endorder)
+		return;
+
+	for (f = *((struct file *const *)nodep); f != NULL; f = f->next) {
+		struct dcache_entry *e;
+
+		/* nothing to store or removed (linked to another file); in
+		 * dry-run the links are moved to the master, but the files
+		 * are untouched */
+		if (!f->dc || !f->dc->ent.flags || (!f->links && !opts.dry_run))
+			continue;
+
+		e = &f->dc->ent;
+		if (f->dc->linked) {
+			struct stat st;
+
+			/* accept the new ctime only for the unmodified file */
+			if (lstat(f->links->path, &st) != 0
+			    || !S_ISREG(st.st_mode)
+			    || st.st_dev != f->st.st_dev
+			    || st.st_ino != f->st.st_ino
+			    || st.st_size != f->st.st_size
+			    || st.st_mtim.tv_sec != f->st.st_mtim.tv_sec
+			    || st.st_mtim.tv_nsec != f->st.st_mtim.tv_nsec)
+				continue;
+			e->ctime_sec = st.st_ctim.tv_sec;
+			e->ctime_nsec = st.st_ctim.tv_nsec;
+		}
+
+		if (dcache.nout == dcache.nalloc) {
+			dcache.nalloc = dcache.nalloc ? dcache.nalloc * 2 : 1024;
+			dcache.out = xreallocarray(dcache.out, dcache.nalloc,
+						   sizeof(struct dcache_entry));
+		}
+		dcache.out[dcache.nout++] = *e;
+	}
+}
+
+/**
+ * dcache_save - Replace the cache file by the entries from this run
+ */
+static void dcache_save(void)
+{
+	struct dcache_header hdr = { .entsz = sizeof(struct dcache_entry) };
+	char *tmpname;
+	size_t i, n = 0;
+	int fd;
+
+	if (dcache.map) {
+		munmap(dcache.map, dcache.mapsz);
+		dcache.map = NULL;
+		dcache.ents = NULL;
+		dcache.nents = 0;
+	}
+
+	twalk(files, dcache_collector);
+
+	/* the same inode may be in more lists (--respect-name) */
+	if (dcache.nout)
+		qsort(dcache.out, dcache.nout, sizeof(struct dcache_entry),
+		      dcache_cmp_entries);
+	for (i = 0; i < dcache.nout; i++) {
+		if (n && dcache_cmp_entries(&dcache.out[n - 1], &dcache.out[i]) == 0) {
+			if (dcache.out[i].flags > dcache.out[n - 1].flags)
+				dcache.out[n - 1] = dcache.out[i];
+			continue;
+		}
+		dcache.out[n++] = dcache.out[i];
+	}
+
+	memcpy(hdr.magic, DCACHE_MAGIC, sizeof(hdr.magic));
+	hdr.digsiz = dcache.digsiz;
+	xstrncpy(hdr.method, opts.method, sizeof(hdr.method));
+	hdr.nents = n;
+
+	xasprintf(&tmpname, "%s.XXXXXX", opts.digest_cache);
+	fd = mkostemp(tmpname, O_CLOEXEC);
+	if (fd < 0) {
+		warn(_("cannot create %s"), tmpname);
+		goto done;
+	}
+	if (ul_write_all(fd, &hdr, sizeof(hdr)) != 0
+	    || (n && ul_write_all(fd, dcache.out, n * sizeof(struct dcache_entry)) != 0)
+	    || close(fd) != 0) {
+		warn(_("cannot write %s"), tmpname);
+		unlink(tmpname);
+		goto done;
+	}
+	if (rename(tmpname, opts.digest_cache) != 0) {
+		warn(_("cannot rename %s to %s"), tmpname, opts.digest_cache);
+		unlink(tmpname);
+	} else
+		jlog(INFO, printf(_("Digest cache %s: %zu entries saved"),
+				  opts.digest_cache, n));
+done:
+	free(tmpname);
+	free(dcache.out);
+	dcache.out = NULL;
+	dcache.nout = dcache.nalloc = 0;
+}
+
+/**
+ * dedupe_group - Share extents of the file a with all its duplicates
+ * @a: The master file
+ * @dups: The duplicates of @a
+ * @n: The number of the duplicates
+ */
+static void dedupe_group(struct file *a, struct file **dups, size_t n)
+{
+	int *res;
+	size_t i;
+
+	if (!n)
+		return;
+
+	res = xcalloc(n, sizeof(int));
+	do_dedupe(a, dups, n, res);
+
+	for (i = 0; i < n; i++) {
+		handle_interrupt();
+		file_link(a, dups[i], 1, res[i]);
+	}
+	free(res);
+}
+
 static inline size_t count_nodes(struct file *x)
 {
 	size_t ct = 0;
@@ -1087,28 +1705,22 @@ static inline size_t count_nodes(struct file *x)
 }
 
 /**
- * visitor - Callback for twalk()
- * @nodep: Pointer to a pointer to a #struct file
- * @which: At which point this visit is (preorder, postorder, endorder)
- * @depth: The depth of the node in the tree
+ * link_group - Link equal files of the same size
+ * @eq: The content comparer
+ * @begin: The first #struct file in the list of files with the same size
  *
- * Visit the nodes in the binary tree. For each node, call hardlinker()
- * on each #struct file in the linked list of #struct file instances located
- * at that node.
+ * Compare the files in the list and replace the duplicates with links. The
+ * lists are independent, so they may be processed by more threads (each
+ * with own @eq).
  */
-static void visitor(const void *nodep, const VISIT which, const int depth)
+static void link_group(struct ul_fileeq *eq, struct file *begin)
 {
-	struct file *master = *(struct file **)nodep;
-	struct file *begin = master;
+	struct file *master = begin;
 	struct file *other;
 
-	(void)depth;
-
-	if (which != leaf && which != endorder)
-		return;
-
 	for (; master != NULL; master = master->next) {
-		size_t nnodes, memsiz;
+		size_t nnodes, memsiz, ndups = 0;
+		struct file **dups = NULL;
 		int may_reflink = 0;
 
 		handle_interrupt();
@@ -1120,12 +1732,13 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 		if (!nnodes)
 			continue;
 
-		/* per-file cache size */
-		memsiz = opts.cache_size / nnodes;
-		/*                               st_size,            readsiz,      memsiz */
-		if (!ul_fileeq_set_size(&fileeq, master->st.st_size, opts.io_size, memsiz)) {
+		/* per-file cache size; the cache is shared by the threads */
+		memsiz = opts.cache_size / opts.jobs / nnodes;
+		/*                          st_size,            readsiz,      memsiz */
+		if (!ul_fileeq_set_size(eq, master->st.st_size, opts.io_size, memsiz)) {
 			jlog(VERBOSE2,
-			     printf(_("Skipped (memory constraints) %s"), master->links->path));
+			     fprintf(out_stream(), _("Skipped (memory constraints) %s"),
+				     master->links->path));
 			continue;
 		}
 
@@ -1136,9 +1749,12 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 				is_reflink_compatible(master->st.st_dev,
 							    master->links->path);
 		}
+		/* all duplicates of the master are deduped by one request */
+		if (may_reflink && !opts.dry_run)
+			dups = xcalloc(nnodes, sizeof(struct file *));
 #endif
 		for (other = master->next; other != NULL; other = other->next) {
-			int eq;
+			int res;
 
 			handle_interrupt();
 
@@ -1151,14 +1767,16 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 			/* check file attributes, etc. */
 			if (!file_may_link_to(master, other)) {
 				jlog(VERBOSE2,
-				     printf(_("Skipped (attributes mismatch) %s"), other->links->path));
+				     fprintf(out_stream(), _("Skipped (attributes mismatch) %s"),
+					     other->links->path));
 				continue;
 			}
 #ifdef USE_REFLINK
 			if (may_reflink && reflinks_skip && is_reflink(master, other)) {
 				jlog(VERBOSE2,
-				     printf(_("Skipped (already reflink) %s"), other->links->path));
-				stats.ignored_reflinks++;
+				     fprintf(out_stream(), _("Skipped (already reflink) %s"),
+					     other->links->path));
+				stats_update(stats.ignored_reflinks++);
 				continue;
 			}
 #endif
@@ -1169,26 +1787,52 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 				ul_fileeq_data_set_file(&other->data, other->links->path);
 
 			/* compare files */
-			eq = ul_fileeq(&fileeq, &master->data, &other->data);
+			res = -1;
+#ifdef USE_REFLINK
+			if (compare_extents
+			    && is_reflink_compatible(master->st.st_dev, master->links->path)
+			    && is_reflink(master, other)) {
+				jlog(VERBOSE2,
+				     fprintf(out_stream(), _("Equal (shared extents) %s"),
+					     other->links->path));
+				res = 1;
+			}
+#endif
+			if (res < 0 && opts.digest_cache)
+				res = dcache_compare(eq, master, other);
+			if (res < 0)
+				res = ul_fileeq(eq, &master->data, &other->data);
 
 			/* reduce number of open files, keep only master open */
 			ul_fileeq_data_close_file(&other->data);
 
-			stats.comparisons++;
+			stats_update(stats.comparisons++);
 
-			if (!eq) {
+			if (!res) {
 				jlog(VERBOSE2,
-				     printf(_("Skipped (content mismatch) %s"), other->links->path));
+				     fprintf(out_stream(), _("Skipped (content mismatch) %s"),
+					     other->links->path));
+				continue;
+			}
+
+			/* the reflinks are created together after the loop */
+			if (dups) {
+				dups[ndups++] = other;
 				continue;
 			}
 
 			/* link files */
-			if (!file_link(master, other, may_reflink) && errno == EMLINK) {
+			if (!file_link(master, other, may_reflink, 0) && errno == EMLINK) {
 				ul_fileeq_data_deinit(&master->data);
 				master = other;
 			}
 		}
 
+		if (dups) {
+			dedupe_group(master, dups, ndups);
+			free(dups);
+		}
+
 		/* don't keep master data in memory */
 		ul_fileeq_data_deinit(&master->data);
 	}
@@ -1197,13 +1841,372 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 	for (other = begin; other != NULL; other = other->next) {
 		if (opts.list_duplicates && other->st.st_nlink > 1)
 			for (struct link *l = other->links; l; l = l->next)
-				printf("%016zu\t%s%c", (size_t)other, l->path, opts.line_delim);
+				fprintf(out_stream(), "%016zu\t%s%c",
+					(size_t)other, l->path, opts.line_delim);
 
 		if (ul_fileeq_data_associated(&other->data))
 			ul_fileeq_data_deinit(&other->data);
 	}
 }
 
+/**
+ * visitor - Callback for twalk()
+ * @nodep: Pointer to a pointer to a #struct file
+ * @which: At which point this visit is (preorder, postorder, endorder)
+ * @depth: The depth of the node in the tree
+ *
+ * Visit the nodes in the binary tree. For each node, call link_group()
+ * on the linked list of #struct file instances located at that node.
+ */
+static void visitor(const void *nodep, const VISIT which, const int depth)
+{
+	(void)depth;
+
+	if (which != leaf && which != endorder)
+		return;
+
+	link_group(&fileeq, *(struct file **)nodep);
+}
+
+#ifdef USE_JOBS
+/*
+ * Parallel directory walk
+ *
+ * The directories are read by the worker threads, every directory to a list
+ * of its entries. The lists are linked to a tree which is passed to
+ * inserter() by the main thread in the same order as nftw() calls it, so the
+ * result does not depend on the number of threads.
+ */
+struct walk_entry {
+	struct walk_entry *next;	/* next entry in the same directory */
+	struct walk_entry *subdir;	/* entries of the directory */
+	struct stat st;
+	int typeflag;			/* FTW_F, FTW_D, FTW_DNR or FTW_NS */
+	int base;			/* offset of the basename in path */
+	int level;
+	char path[];
+};
+
+struct walker {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	struct walk_entry **queue;	/* directories to read */
+	size_t nqueue;
+	size_t nalloc;
+	size_t busy;			/* directories being read */
+
+	dev_t dev;			/* device of the top-level directory */
+};
+
+static struct walk_entry *new_walk_entry(const char *dir, const char *name, int level)
+{
+	size_t dirsz = strlen(dir), namesz = strlen(name);
+	int slash = dirsz && dir[dirsz - 1] != '/';
+	struct walk_entry *e;
+
+	e = xcalloc(1, sizeof(*e) + dirsz + slash + namesz + 1);
+	memcpy(e->path, dir, dirsz);
+	if (slash)
+		e->path[dirsz] = '/';
+	memcpy(e->path + dirsz + slash, name, namesz + 1);
+	e->base = dirsz + slash;
+	e->level = level;
+	return e;
+}
+
+static inline int walk_skip_subtree(struct walk_entry *e)
+{
+#ifdef USE_SKIP_SUBTREE
+	return opts.exclude_subtree && match_any_regex(opts.exclude_subtree, e->path);
+#else
+	(void)e;
+	return 0;
+#endif
+}
+
+static void walk_push(struct walker *wk, struct walk_entry *dir)
+{
+	pthread_mutex_lock(&wk->lock);
+	if (wk->nqueue == wk->nalloc) {
+		wk->nalloc = wk->nalloc ? wk->nalloc * 2 : 64;
+		wk->queue = xreallocarray(wk->queue, wk->nalloc, sizeof(*wk->queue));
+	}
+	wk->queue[wk->nqueue++] = dir;
+	pthread_cond_signal(&wk->cond);
+	pthread_mutex_unlock(&wk->lock);
+}
+
+/* reads entries of @dir, the subdirectories are added to the queue */
+static void walk_dir(struct walker *wk, struct walk_entry *dir)
+{
+	struct walk_entry **tail = &dir->subdir;
+	struct dirent *d;
+	DIR *dp = NULL;
+	int fd;
+
+	fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd >= 0)
+		dp = fdopendir(fd);
+	if (!dp) {
+		if (fd >= 0)
+			close(fd);
+		dir->typeflag = FTW_DNR;
+		return;
+	}
+
+	while ((d = readdir(dp))) {
+		struct walk_entry *e;
+
+		handle_interrupt();
+		if (is_dotdir_dirent(d))
+			continue;
+
+		e = new_walk_entry(dir->path, d->d_name, dir->level + 1);
+
+		if (fstatat(dirfd(dp), d->d_name, &e->st, AT_SYMLINK_NOFOLLOW) != 0)
+			e->typeflag = FTW_NS;
+		else if (opts.within_mount && e->st.st_dev != wk->dev) {
+			/* as nftw(FTW_MOUNT), also for (bind mounted) files */
+			free(e);
+			continue;
+		} else if (S_ISREG(e->st.st_mode))
+			e->typeflag = FTW_F;
+		else if (S_ISDIR(e->st.st_mode)) {
+			e->typeflag = FTW_D;
+			if (!walk_skip_subtree(e))
+				walk_push(wk, e);
+		} else {
+			/* ignored by inserter() */
+			free(e);
+			continue;
+		}
+
+		*tail = e;
+		tail = &e->next;
+	}
+	closedir(dp);
+}
+
+static void *walk_worker(void *data)
+{
+	struct walker *wk = data;
+
+	hdl_worker = 1;
+
+	pthread_mutex_lock(&wk->lock);
+	for (;;) {
+		struct walk_entry *dir;
+
+		while (!wk->nqueue && wk->busy)
+			pthread_cond_wait(&wk->cond, &wk->lock);
+		if (!wk->nqueue)
+			break;
+
+		dir = wk->queue[--wk->nqueue];
+		wk->busy++;
+		pthread_mutex_unlock(&wk->lock);
+
+		walk_dir(wk, dir);
+
+		pthread_mutex_lock(&wk->lock);
+		wk->busy--;
+		if (!wk->busy && !wk->nqueue)
+			pthread_cond_broadcast(&wk->cond);
+	}
+	pthread_mutex_unlock(&wk->lock);
+	return NULL;
+}
+
+/* calls inserter() for @e, its subdirectories and next entries */
+static void walk_insert(struct walk_entry *e)
+{
+	while (e) {
+		struct walk_entry *next = e->next;
+		struct FTW ftw = { .base = e->base, .level = e->level };
+
+		inserter(e->path, &e->st, e->typeflag, &ftw);
+		walk_insert(e->subdir);
+		free(e);
+		e = next;
+	}
+}
+
+/*
+ * Reads the directory tree @path by opts.jobs threads. Returns -1 if @path is
+ * not a directory.
+ */
+static int walk_tree(const char *path)
+{
+	struct walker wk = { .nqueue = 0 };
+	struct walk_entry *root;
+	const char *base = strrchr(path, '/');
+	size_t sz = strlen(path) + 1, i, nworkers = 0;
+	pthread_t *workers;
+
+	root = xcalloc(1, sizeof(*root) + sz);
+	memcpy(root->path, path, sz);
+	root->base = base ? base - path + 1 : 0;
+
+	if (lstat(path, &root->st) != 0 || !S_ISDIR(root->st.st_mode)) {
+		free(root);
+		return -1;
+	}
+	root->typeflag = FTW_D;
+	wk.dev = root->st.st_dev;
+
+	pthread_mutex_init(&wk.lock, NULL);
+	pthread_cond_init(&wk.cond, NULL);
+
+	if (!walk_skip_subtree(root))
+		walk_push(&wk, root);
+
+	workers = xcalloc(opts.jobs, sizeof(pthread_t));
+	for (i = 0; i < opts.jobs; i++) {
+		if (pthread_create(&workers[i], NULL, walk_worker, &wk) != 0) {
+			if (i == 0)
+				err(EXIT_FAILURE, _("failed to create thread"));
+			break;
+		}
+		nworkers++;
+	}
+	for (i = 0; i < nworkers; i++)
+		pthread_join(workers[i], NULL);
+
+	pthread_cond_destroy(&wk.cond);
+	pthread_mutex_destroy(&wk.lock);
+	free(workers);
+	free(wk.queue);
+
+	walk_insert(root);
+	return 0;
+}
+
+/*
+ * Parallel content comparison
+ *
+ * The lists of files with the same size are independent. The workers take
+ * the lists in the twalk() order and the main thread prints the buffered
+ * output of the lists in the same order.
+ */
+struct link_job {
+	struct file *begin;
+	char *out;
+	size_t outsz;
+	bool done;
+};
+
+static struct linker {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	struct link_job *jobs;
+	size_t njobs;
+	size_t nalloc;
+	size_t next;			/* the next job to process */
+} linker = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+static void collector(const void *nodep, const VISIT which, const int depth)
+{
+	(void)depth;
+
+	if (which != leaf && which != endorder)
+		return;
+
+	if (linker.njobs == linker.nalloc) {
+		linker.nalloc = linker.nalloc ? linker.nalloc * 2 : 1024;
+		linker.jobs = xreallocarray(linker.jobs, linker.nalloc,
+					    sizeof(struct link_job));
+	}
+	linker.jobs[linker.njobs++] = (struct link_job) {
+		.begin = *(struct file **)nodep
+	};
+}
+
+static void *link_worker(void *data __attribute__((__unused__)))
+{
+	struct ul_fileeq eq;
+	int need_out = is_log_enabled(INFO) || opts.list_duplicates;
+
+	hdl_worker = 1;
+
+	if (ul_fileeq_init(&eq, opts.method) != 0)
+		err(EXIT_FAILURE, _("failed to initialize files comparer"));
+
+	for (;;) {
+		struct link_job *job;
+
+		pthread_mutex_lock(&linker.lock);
+		job = linker.next < linker.njobs ? &linker.jobs[linker.next++] : NULL;
+		pthread_mutex_unlock(&linker.lock);
+		if (!job)
+			break;
+
+		if (need_out) {
+			hdl_out = open_memstream(&job->out, &job->outsz);
+			if (!hdl_out)
+				err(EXIT_FAILURE, _("cannot open memory stream"));
+		}
+
+		link_group(&eq, job->begin);
+
+		if (hdl_out) {
+			fclose(hdl_out);
+			hdl_out = NULL;
+		}
+
+		pthread_mutex_lock(&linker.lock);
+		job->done = 1;
+		pthread_cond_broadcast(&linker.cond);
+		pthread_mutex_unlock(&linker.lock);
+	}
+
+	ul_fileeq_deinit(&eq);
+	return NULL;
+}
+
+static void link_groups_by_workers(void)
+{
+	pthread_t *workers;
+	size_t i, nworkers = 0;
+
+	twalk(files, collector);
+
+	workers = xcalloc(opts.jobs, sizeof(pthread_t));
+	for (i = 0; i < opts.jobs && i < linker.njobs; i++) {
+		if (pthread_create(&workers[i], NULL, link_worker, NULL) != 0) {
+			if (i == 0)
+				err(EXIT_FAILURE, _("failed to create thread"));
+			break;
+		}
+		nworkers++;
+	}
+
+	for (i = 0; i < linker.njobs; i++) {
+		struct link_job *job = &linker.jobs[i];
+
+		pthread_mutex_lock(&linker.lock);
+		while (!job->done)
+			pthread_cond_wait(&linker.cond, &linker.lock);
+		pthread_mutex_unlock(&linker.lock);
+
+		if (job->outsz)
+			fwrite(job->out, 1, job->outsz, stdout);
+		free(job->out);
+		handle_interrupt();
+	}
+
+	for (i = 0; i < nworkers; i++)
+		pthread_join(workers[i], NULL);
+
+	free(workers);
+	free(linker.jobs);
+}
+#endif /* USE_JOBS */
+
 /**
  * usage - Print the program help and exit
  */
@@ -1223,11 +2226,17 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -b, --io-size <size>       I/O buffer size for file reading\n"
 		"                              (speedup, using more RAM)\n"), out);
 	fputs(_(" -d, --respect-dir          directory names have to be identical\n"), out);
+	fputs(_("     --digest-cache <file>  store digests of the compared files to <file>\n"
+		"                              and reuse them in the next run\n"), out);
 	fputs(_(" -f, --respect-name         filenames have to be identical\n"), out);
 	fputs(_(" -F, --prioritize-trees     files found in the earliest specified top-level\n"
 		"                              directory have higher priority (but this has\n"
 		"                              lower precedence than --maximize/--minimize)\n"), out);
 	fputs(_(" -i, --include <regex>      regular expression to include files/dirs\n"), out);
+#ifdef USE_JOBS
+	fputs(_(" -j, --jobs <num>           read and compare files by <num> threads\n"
+		"                              (0: one per CPU)\n"), out);
+#endif
 	fputs(_(" -l, --list-duplicates      just list paths of duplicates, don't link them\n"), out);
 	fputs(_(" -m, --maximize             keep the file with the most links\n"), out);
 	fputs(_(" -M, --minimize             keep the file with the fewest links\n"), out);
@@ -1242,6 +2251,7 @@ static void __attribute__((__noreturn__)) usage(void)
 #ifdef USE_REFLINK
 	fputs(_("     --reflink[=<when>]     create clone/CoW copies (auto, always, never)\n"), out);
 	fputs(_("     --skip-reflinks        skip already cloned files (enabled on --reflink)\n"), out);
+	fputs(_("     --compare-extents      files sharing all extents are equal, don't read them\n"), out);
 #endif
 	fputs(_(" -s, --minimum-size <size>  minimum size for files\n"), out);
 	fputs(_(" -S, --maximum-size <size>  maximum size for files\n"), out);
@@ -1275,9 +2285,11 @@ static int parse_options(int argc, char *argv[])
 		OPT_REFLINK = CHAR_MAX + 1,
 		OPT_SKIP_RELINKS,
 		OPT_EXCLUDE_SUBTREE,
-		OPT_MOUNT
+		OPT_MOUNT,
+		OPT_DIGEST_CACHE,
+		OPT_COMPARE_EXTENTS
 	};
-	static const char optstr[] = "VhvndfpotXcmMFOlzx:y:i:r:S:s:b:q";
+	static const char optstr[] = "VhvndfpotXcmMFOlzx:y:i:j:r:S:s:b:q";
 	static const struct option long_options[] = {
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
@@ -1295,16 +2307,19 @@ static int parse_options(int argc, char *argv[])
 		{"keep-oldest", no_argument, NULL, 'O'},
 		{"exclude", required_argument, NULL, 'x'},
 		{"include", required_argument, NULL, 'i'},
+		{"jobs", required_argument, NULL, 'j'},
 #ifdef USE_SKIP_SUBTREE
 		{"exclude-subtree", required_argument, NULL, OPT_EXCLUDE_SUBTREE},
 #endif
 		{"mount", no_argument, NULL, OPT_MOUNT},
+		{"digest-cache", required_argument, NULL, OPT_DIGEST_CACHE},
 		{"method", required_argument, NULL, 'y' },
 		{"minimum-size", required_argument, NULL, 's'},
 		{"maximum-size", required_argument, NULL, 'S'},
 #ifdef USE_REFLINK
 		{"reflink", optional_argument, NULL, OPT_REFLINK },
 		{"skip-reflinks", no_argument, NULL, OPT_SKIP_RELINKS },
+		{"compare-extents", no_argument, NULL, OPT_COMPARE_EXTENTS },
 #endif
 		{"io-size", required_argument, NULL, 'b'},
 		{"content", no_argument, NULL, 'c'},
@@ -1382,6 +2397,16 @@ static int parse_options(int argc, char *argv[])
 		case 'i':
 			register_regex(&opts.include, optarg);
 			break;
+		case 'j':
+			opts.jobs = strtou32_or_err(optarg, _("invalid jobs argument"));
+			if (opts.jobs == 0) {
+				long n = sysconf(_SC_NPROCESSORS_ONLN);
+				opts.jobs = n > 0 ? (size_t) n : 1;
+			}
+#ifndef USE_JOBS
+			opts.jobs = 1;
+#endif
+			break;
 		case 's':
 			opts.min_size = strtosize_or_err(optarg, _("failed to parse minimum size"));
 			break;
@@ -1421,10 +2446,16 @@ static int parse_options(int argc, char *argv[])
 		case OPT_SKIP_RELINKS:
 			reflinks_skip = 1;
 			break;
+		case OPT_COMPARE_EXTENTS:
+			compare_extents = 1;
+			break;
 #endif
 		case OPT_MOUNT:
 			opts.within_mount = 1;
 			break;
+		case OPT_DIGEST_CACHE:
+			opts.digest_cache = optarg;
+			break;
 		case 'h':
 			usage();
 		case 'V':
@@ -1438,6 +2469,9 @@ static int parse_options(int argc, char *argv[])
 #endif
 #ifdef USE_SKIP_SUBTREE
 				"ftw_skip_subtree",
+#endif
+#ifdef USE_JOBS
+				"jobs",
 #endif
 				NULL
 			};
@@ -1523,6 +2557,9 @@ int main(int argc, char *argv[])
 			opts.io_size = 1024*1024;
 	}
 
+	if (opts.digest_cache)
+		dcache_open();
+
 	stats.started = TRUE;
 
 	ftw_flags = FTW_PHYS;
@@ -1547,7 +2584,12 @@ int main(int argc, char *argv[])
 		if (opts.prio_trees)
 			++curr_tree;
 
-		if (nftw(path, inserter, 20, ftw_flags) == -1) {
+		rc = -1;
+#ifdef USE_JOBS
+		if (opts.jobs > 1)
+			rc = walk_tree(path);
+#endif
+		if (rc != 0 && nftw(path, inserter, 20, ftw_flags) == -1) {
 			if (errno != ENOTDIR || insert_file(path) != 0)
 				warn(_("cannot process %s"), path);
 		}
@@ -1556,7 +2598,15 @@ int main(int argc, char *argv[])
 		rootbasesz = 0;
 	}
 
-	twalk(files, visitor);
+#ifdef USE_JOBS
+	if (opts.jobs > 1)
+		link_groups_by_workers();
+	else
+#endif
+		twalk(files, visitor);
+
+	if (opts.digest_cache)
+		dcache_save();
 
 	ul_fileeq_deinit(&fileeq);
 	return 0;
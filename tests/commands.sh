@@ -39,6 +39,7 @@ TS_HELPER_LIBMOUNT_FUZZ="${ts_helpersdir}test_mount_fuzz"
 TS_HELPER_LIBSMARTCOLS_CONTINUOUS_JSON="${ts_helpersdir}sample-scols-continuous-json"
 TS_HELPER_LIBSMARTCOLS_FROMFILE="${ts_helpersdir}sample-scols-fromfile"
 TS_HELPER_LIBSMARTCOLS_TITLE="${ts_helpersdir}sample-scols-title"
+TS_HELPER_LIBSMARTCOLS_STREAM="${ts_helpersdir}sample-scols-stream"
 TS_HELPER_PYLIBMOUNT_CONTEXT="$top_srcdir/libmount/python/test_mount_context.py"
 TS_HELPER_PYLIBMOUNT_TAB="$top_srcdir/libmount/python/test_mount_tab.py"
 TS_HELPER_PYLIBMOUNT_UPDATE="$top_srcdir/libmount/python/test_mount_tab_update.py"
@@ -70,6 +71,7 @@ TS_HELPER_PROCFS="${ts_helpersdir}test_procfs"
 TS_HELPER_TIMEUTILS="${ts_helpersdir}test_timeutils"
 TS_HELPER_KILL_PIDFDINO="${ts_helpersdir}test_kill_pidfdino"
 TS_HELPER_SCOLS_TERMREDUCE="${ts_helpersdir}test_scols_termreduce"
+TS_HELPER_SCOLS_WIDTHCACHE="${ts_helpersdir}test_scols_widthcache"
 TS_HELPER_OPEN_TWICE="${ts_helpersdir}test_open_twice"
 TS_HELPER_PARSEPID="${ts_helpersdir}test_parsepid"
 
@@ -0,0 +1,84 @@
+/*
+ * test_scols_widthcache.c
+ *
+ * Regression test helper for libsmartcols.
+ *
+ * The cell widths are cached between prints of the same table. Verify that
+ * the cached width is not used after the cell data are changed or after the
+ * encoding mode of the table is changed; the columns have to be aligned to
+ * the current data in all prints.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libsmartcols/src/libsmartcols.h"
+
+#define TEST_TERMWIDTH 80
+
+static void print_table(struct libscols_table *tb, const char *title)
+{
+	printf("--- %s\n", title);
+	scols_print_table(tb);
+}
+
+int main(void)
+{
+	struct libscols_table *tb;
+	struct libscols_line *ln, *ln2;
+
+	tb = scols_new_table();
+	if (!tb)
+		return EXIT_FAILURE;
+
+	/* Make output deterministic */
+	scols_table_set_termwidth(tb, TEST_TERMWIDTH);
+	scols_table_set_termforce(tb, SCOLS_TERMFORCE_ALWAYS);
+
+	if (!scols_table_new_column(tb, "NAME", 0, 0) ||
+	    !scols_table_new_column(tb, "NEXT", 0, 0))
+		goto err;
+
+	ln = scols_table_new_line(tb, NULL);
+	ln2 = scols_table_new_line(tb, NULL);
+	if (!ln || !ln2)
+		goto err;
+
+	if (scols_line_set_data(ln, 0, "short") != 0 ||
+	    scols_line_set_data(ln, 1, "a") != 0 ||
+	    scols_line_set_data(ln2, 0, "x") != 0 ||
+	    scols_line_set_data(ln2, 1, "b") != 0)
+		goto err;
+
+	print_table(tb, "initial");
+	print_table(tb, "unchanged");
+
+	/* new data, the cached width is invalid */
+	if (scols_line_set_data(ln, 0, "much-longer-name") != 0)
+		goto err;
+	print_table(tb, "longer data");
+
+	if (scols_line_refer_data(ln, 0, strdup("tiny")) != 0)
+		goto err;
+	print_table(tb, "shorter data");
+
+	/* the width of the non-printable char depends on the encoding */
+	if (scols_line_set_data(ln2, 0, "x\x7fy") != 0)
+		goto err;
+	print_table(tb, "encoded");
+
+	scols_table_enable_noencoding(tb, 1);
+	print_table(tb, "noencoding");
+
+	scols_table_enable_noencoding(tb, 0);
+	print_table(tb, "encoded again");
+
+	scols_unref_table(tb);
+	return EXIT_SUCCESS;
+
+err:
+	scols_unref_table(tb);
+	return EXIT_FAILURE;
+}